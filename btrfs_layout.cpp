@@ -0,0 +1,273 @@
+#include "btrfs_layout.h"
+#include "util.h"
+
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <linux/btrfs.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <unistd.h>
+
+namespace {
+
+const char* COMMON_BTRFS_OPTIONS = "defaults,noatime";
+
+std::string targetPath(const std::string& targetRoot, const std::string& mountpoint) {
+    return mountpoint == "/" ? targetRoot : targetRoot + mountpoint;
+}
+
+// Indeksen til nærmeste montering som inneholder denne, eller -1 for rotmonteringen
+int parentMount(const std::vector<LayoutEntry>& layout, size_t index) {
+    int parent = -1;
+    size_t parentLength = 0;
+    const std::string& mountpoint = layout[index].mountpoint;
+    for (size_t i = 0; i < layout.size(); ++i) {
+        const std::string& candidate = layout[i].mountpoint;
+        if (i == index || candidate.empty() || candidate.size() >= mountpoint.size()) {
+            continue;
+        }
+        bool contains = candidate == "/" || (mountpoint.compare(0, candidate.size(), candidate) == 0 && mountpoint[candidate.size()] == '/');
+        if (contains && candidate.size() >= parentLength) {
+            parent = static_cast<int>(i);
+            parentLength = candidate.size();
+        }
+    }
+    return parent;
+}
+
+bool mountEntry(const LayoutEntry& entry, const std::string& device, const std::string& targetRoot, const LayoutLog& log) {
+    std::string target = targetPath(targetRoot, entry.mountpoint);
+    std::error_code ec;
+    std::filesystem::create_directories(target, ec);
+    if (ec) {
+        log("mkdir " + target + " failed: " + ec.message());
+        return false;
+    }
+    std::string options = entry.options;
+    if (!entry.subvolume.empty()) {
+        options = "subvol=" + entry.subvolume + "," + options;
+    }
+    ParsedOptions parsed = parseMountOptions(options);
+    if (mount(device.c_str(), target.c_str(), entry.fsType.c_str(), parsed.flags, parsed.data.c_str()) != 0) {
+        log("mount " + device + " on " + target + " failed: " + strerror(errno));
+        return false;
+    }
+    log("Mounted " + (entry.subvolume.empty() ? device : entry.subvolume) + " on " + target);
+    return true;
+}
+
+bool createSubvolumes(const std::vector<LayoutEntry>& layout, const std::string& rootDevice, const LayoutLog& log) {
+    char scratch[] = "/run/nixum-btrfs-XXXXXX";
+    if (mkdtemp(scratch) == nullptr) {
+        log(std::string("mkdtemp failed: ") + strerror(errno));
+        return false;
+    }
+    if (mount(rootDevice.c_str(), scratch, "btrfs", 0, nullptr) != 0) {
+        log("mount " + rootDevice + " failed: " + strerror(errno));
+        rmdir(scratch);
+        return false;
+    }
+
+    bool ok = true;
+    int dirFd = open(scratch, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) {
+        log(std::string("open top-level subvolume failed: ") + strerror(errno));
+        ok = false;
+    }
+    for (const auto& entry : layout) {
+        if (!ok || entry.subvolume.empty()) {
+            continue;
+        }
+        btrfs_ioctl_vol_args args = {};
+        strncpy(args.name, entry.subvolume.c_str(), BTRFS_PATH_NAME_MAX);
+        if (ioctl(dirFd, BTRFS_IOC_SUBVOL_CREATE, &args) != 0 && errno != EEXIST) {
+            log("Create subvolume " + entry.subvolume + " failed: " + strerror(errno));
+            ok = false;
+        } else {
+            log("Created subvolume " + entry.subvolume);
+        }
+    }
+    if (dirFd >= 0) {
+        close(dirFd);
+    }
+    umount2(scratch, MNT_DETACH);
+    rmdir(scratch);
+    return ok;
+}
+
+} // namespace
+
+ParsedOptions parseMountOptions(const std::string& options) {
+    static const struct {
+        const char* name;
+        unsigned long set;
+        unsigned long clear;
+    } knownFlags[] = {
+        { "defaults", 0, 0 }, { "rw", 0, MS_RDONLY }, { "ro", MS_RDONLY, 0 },
+        { "noatime", MS_NOATIME, 0 }, { "relatime", MS_RELATIME, 0 }, { "nodiratime", MS_NODIRATIME, 0 },
+        { "nodev", MS_NODEV, 0 }, { "nosuid", MS_NOSUID, 0 }, { "noexec", MS_NOEXEC, 0 },
+    };
+    ParsedOptions parsed = { 0, "" };
+    std::stringstream stream(options);
+    std::string option;
+    while (std::getline(stream, option, ',')) {
+        if (option.empty()) {
+            continue;
+        }
+        bool isFlag = false;
+        for (const auto& flag : knownFlags) {
+            if (option == flag.name) {
+                parsed.flags = (parsed.flags | flag.set) & ~flag.clear;
+                isFlag = true;
+                break;
+            }
+        }
+        if (!isFlag) {
+            parsed.data += (parsed.data.empty() ? "" : ",") + option;
+        }
+    }
+    return parsed;
+}
+
+std::vector<std::vector<size_t>> mountWaves(const std::vector<LayoutEntry>& layout) {
+    std::vector<int> depth(layout.size(), -1);
+    std::vector<std::vector<size_t>> waves;
+    for (size_t i = 0; i < layout.size(); ++i) {
+        if (layout[i].mountpoint.empty()) {
+            continue;
+        }
+        int d = 0;
+        for (int parent = parentMount(layout, i); parent >= 0; parent = parentMount(layout, parent)) {
+            ++d;
+        }
+        if (static_cast<size_t>(d) >= waves.size()) {
+            waves.resize(d + 1);
+        }
+        waves[d].push_back(i);
+    }
+    return waves;
+}
+
+std::vector<LayoutEntry> nixumFilesystemLayout(const std::string& btrfsOptions) {
+    std::string options = std::string(COMMON_BTRFS_OPTIONS) + (btrfsOptions.empty() ? "" : "," + btrfsOptions);
+    return {
+        { MountSource::Root, "btrfs", "@", "", "" },
+        { MountSource::Root, "btrfs", "@root", "/", options },
+        { MountSource::Root, "btrfs", "@home", "/home", options },
+        { MountSource::Root, "btrfs", "@nix", "/nix", options },
+        { MountSource::Root, "btrfs", "@log", "/var/log", options },
+        { MountSource::Boot, "vfat", "", "/boot", "defaults,noatime,rw,fmask=0137,dmask=0027" },
+    };
+}
+
+bool applyFilesystemLayout(const std::vector<LayoutEntry>& layout, const std::string& rootDevice,
+                           const std::string& bootDevice, const std::string& targetRoot, const LayoutLog& log) {
+    if (!createSubvolumes(layout, rootDevice, log)) {
+        return false;
+    }
+
+    std::mutex logMutex;
+    LayoutLog lockedLog = [&](const std::string& line) {
+        std::lock_guard<std::mutex> lock(logMutex);
+        log(line);
+    };
+    for (const auto& wave : mountWaves(layout)) {
+        std::vector<std::thread> threads;
+        std::vector<char> results(wave.size(), 0);
+        for (size_t i = 0; i < wave.size(); ++i) {
+            const LayoutEntry& entry = layout[wave[i]];
+            const std::string& device = entry.source == MountSource::Root ? rootDevice : bootDevice;
+            threads.emplace_back([&, i, device]() { results[i] = mountEntry(entry, device, targetRoot, lockedLog); });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (char ok : results) {
+            if (!ok) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool unmountFilesystemLayout(const std::vector<LayoutEntry>& layout, const std::string& targetRoot, const LayoutLog& log) {
+    bool ok = true;
+    auto waves = mountWaves(layout);
+    for (auto wave = waves.rbegin(); wave != waves.rend(); ++wave) {
+        for (size_t index : *wave) {
+            std::string target = targetPath(targetRoot, layout[index].mountpoint);
+            if (umount2(target.c_str(), 0) != 0 && errno != EINVAL) {
+                log("umount " + target + " failed: " + strerror(errno));
+                ok = false;
+            }
+        }
+    }
+    return ok;
+}
+
+int benchmarkFilesystemLayout(const std::string& device) {
+    // Kun btrfs-delen; ESP-en trenger en egen enhet
+    std::vector<LayoutEntry> layout;
+    for (const auto& entry : nixumFilesystemLayout()) {
+        if (entry.source == MountSource::Root) {
+            layout.push_back(entry);
+        }
+    }
+    LayoutLog quiet = [](const std::string&) {};
+    LayoutLog verbose = [](const std::string& line) { std::cerr << line << std::endl; };
+    std::string target = "/run/nixum-bench-target";
+    std::string mkfs = "mkfs.btrfs -f \"" + device + "\" >/dev/null";
+    std::string shellPath =
+        "set -e\n"
+        "NIXROOT=\"" + device + "\"\n"
+        "mkdir -p " + target + "\n"
+        "mount \"$NIXROOT\" " + target + "\n"
+        "for subvol in \"\" root home nix log; do btrfs su cr " + target + "/@\"$subvol\" >/dev/null; done\n"
+        "umount -l " + target + "\n"
+        "mount -t btrfs -o subvol=@root,defaults,noatime,compress=zstd,discard=async,ssd \"$NIXROOT\" " + target + "\n"
+        "mkdir -p " + target + "/{home,nix,var/log}\n"
+        "mount -t btrfs -o subvol=@home,defaults,noatime,compress=zstd,discard=async,ssd \"$NIXROOT\" " + target + "/home\n"
+        "mount -t btrfs -o subvol=@nix,defaults,noatime,compress=zstd,discard=async,ssd \"$NIXROOT\" " + target + "/nix\n"
+        "mount -t btrfs -o subvol=@log,defaults,noatime,compress=zstd,discard=async,ssd \"$NIXROOT\" " + target + "/var/log\n";
+
+    if (system(mkfs.c_str()) != 0) {
+        std::cerr << "mkfs.btrfs failed on " << device << std::endl;
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    int status = system(("bash -c '" + shellPath + "'").c_str());
+    double shellSeconds = secondsSince(start);
+    unmountFilesystemLayout(layout, target, quiet);
+    if (status != 0) {
+        std::cerr << "Shell layout failed (btrfs-progs installed? running as root?)" << std::endl;
+        return 1;
+    }
+
+    if (system(mkfs.c_str()) != 0) {
+        return 1;
+    }
+    start = std::chrono::steady_clock::now();
+    bool ok = applyFilesystemLayout(layout, device, "", target, verbose);
+    double nativeSeconds = secondsSince(start);
+    unmountFilesystemLayout(layout, target, verbose);
+    if (!ok) {
+        return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "shell:      " << shellSeconds * 1000.0 << " ms" << std::endl;
+    std::cout << "in-process: " << nativeSeconds * 1000.0 << " ms" << std::endl;
+    std::cout << "saved:      " << (shellSeconds - nativeSeconds) * 1000.0 << " ms" << std::endl;
+    return 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Filsystemoppsettet etter mkfs, beskrevet som data: hvilke btrfs-subvolumer som finnes
+// og hvor de og ESP-en monteres. Subvolumene lages med BTRFS_IOC_SUBVOL_CREATE og alt
+// monteres med mount(2); uavhengige monteringer på samme nivå gjøres samtidig.
+
+enum class MountSource {
+    Root, // NIXROOT (btrfs)
+    Boot  // NIXBOOT (vfat)
+};
+
+struct LayoutEntry {
+    MountSource source;
+    std::string fsType;
+    std::string subvolume;  // Tom for ikke-btrfs
+    std::string mountpoint; // Relativ til målroten; tom betyr kun opprett subvolumet
+    std::string options;    // Som i fstab, f.eks. "defaults,noatime,compress=zstd"
+};
+
+struct ParsedOptions {
+    unsigned long flags; // MS_*-flaggene mount(8) oversetter selv
+    std::string data;    // Resten, som går til filsystemet
+};
+
+using LayoutLog = std::function<void(const std::string&)>;
+
+// Standardoppsettet: @, @root (/), @home, @nix, @log (/var/log) og ESP på /boot.
+// btrfsOptions legges til alle btrfs-monteringene.
+std::vector<LayoutEntry> nixumFilesystemLayout(const std::string& btrfsOptions = "compress=zstd,discard=async,ssd");
+
+ParsedOptions parseMountOptions(const std::string& options);
+
+// Indeksene til monteringene gruppert i bølger; alle i samme bølge har foreldrene sine montert
+// allerede og kan monteres samtidig. Oppføringer uten monteringspunkt er ikke med.
+std::vector<std::vector<size_t>> mountWaves(const std::vector<LayoutEntry>& layout);
+
+// Lager subvolumene og monterer alt under targetRoot
+bool applyFilesystemLayout(const std::vector<LayoutEntry>& layout, const std::string& rootDevice,
+                           const std::string& bootDevice, const std::string& targetRoot, const LayoutLog& log);
+
+// Avmonterer alt oppsettet monterte, innerst først
+bool unmountFilesystemLayout(const std::vector<LayoutEntry>& layout, const std::string& targetRoot, const LayoutLog& log);
+
+// Formaterer enheten (f.eks. en loop-enhet) på nytt før hver kjøring og sammenligner
+// den gamle skallsekvensen med oppsettet i prosessen. Krever root og mkfs.btrfs.
+int benchmarkFilesystemLayout(const std::string& device);
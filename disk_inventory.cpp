@@ -0,0 +1,257 @@
+#include "disk_inventory.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+const int UEVENT_SETTLE_MS = 200;
+const int FALLBACK_RESCAN_MS = 5000;
+
+std::mutex inventoryMutex;
+std::vector<BlockDevice> inventory;
+std::thread watcherThread;
+int stopPipe[2] = { -1, -1 };
+
+// Virtuelle enheter og eMMC-boot/rpmb-områder er ikke installasjonsmål
+bool isCandidateDisk(const std::string& name, const std::filesystem::path& blockDir) {
+    static const char* virtualPrefixes[] = { "loop", "ram", "zram", "dm-", "md", "sr", "fd", "nbd" };
+    for (const char* prefix : virtualPrefixes) {
+        if (name.rfind(prefix, 0) == 0) {
+            return false;
+        }
+    }
+    if (name.rfind("mmcblk", 0) == 0 && (name.find("boot") != std::string::npos || name.find("rpmb") != std::string::npos)) {
+        return false;
+    }
+    std::error_code ec;
+    return std::filesystem::exists(blockDir / "device", ec);
+}
+
+// Tømmer en fd og returnerer true hvis noen av meldingene gjelder blokkenheter
+bool drainWatchFd(int fd, bool isNetlink) {
+    bool relevant = !isNetlink;
+    char buffer[8192];
+    ssize_t count;
+    while ((count = read(fd, buffer, sizeof(buffer))) > 0) {
+        if (isNetlink && memmem(buffer, count, "SUBSYSTEM=block", strlen("SUBSYSTEM=block")) != nullptr) {
+            relevant = true;
+        }
+    }
+    // Overfylt netlink-kø betyr tapte hendelser, da må vi skanne uansett
+    if (count < 0 && errno == ENOBUFS) {
+        relevant = true;
+    }
+    return relevant;
+}
+
+int openUeventSocket() {
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+    if (fd < 0) {
+        return -1;
+    }
+    sockaddr_nl address = {};
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = 1; // Kjernens uevent-gruppe
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int openInotifyWatch(const std::string& blockDir) {
+    int fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (fd < 0) {
+        return -1;
+    }
+    if (inotify_add_watch(fd, blockDir.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool rescan(const std::string& sysRoot) {
+    std::vector<BlockDevice> devices = scanBlockDevices(sysRoot);
+    std::lock_guard<std::mutex> lock(inventoryMutex);
+    if (devices == inventory) {
+        return false;
+    }
+    inventory = std::move(devices);
+    return true;
+}
+
+void watchBlockDevices(std::string sysRoot, std::function<void()> onChange, int stopFd) {
+    if (rescan(sysRoot)) {
+        onChange();
+    }
+
+    bool isNetlink = false;
+    int watchFd = -1;
+    if (sysRoot == "/sys") {
+        watchFd = openUeventSocket();
+        isNetlink = watchFd >= 0;
+    }
+    if (watchFd < 0) {
+        watchFd = openInotifyWatch(sysRoot + "/block");
+    }
+    if (watchFd < 0) {
+        std::cerr << "Disk inventory: no hotplug notifications, rescanning every " << FALLBACK_RESCAN_MS << " ms" << std::endl;
+    }
+
+    pollfd fds[2] = { { stopFd, POLLIN, 0 }, { watchFd, POLLIN, 0 } };
+    int fdCount = watchFd >= 0 ? 2 : 1;
+    while (true) {
+        int ready = poll(fds, fdCount, watchFd >= 0 ? -1 : FALLBACK_RESCAN_MS);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready < 0 || (fds[0].revents & POLLIN)) {
+            break;
+        }
+        if (watchFd >= 0 && !drainWatchFd(watchFd, isNetlink)) {
+            continue;
+        }
+        // Hotplug kommer i støt (disk, så partisjoner); vent til det roer seg før ny skanning
+        while (watchFd >= 0 && poll(&fds[1], 1, UEVENT_SETTLE_MS) > 0) {
+            drainWatchFd(watchFd, isNetlink);
+        }
+        if (rescan(sysRoot)) {
+            onChange();
+        }
+    }
+
+    if (watchFd >= 0) {
+        close(watchFd);
+    }
+}
+
+} // namespace
+
+std::string readSysfsAttribute(const std::filesystem::path& path) {
+    std::ifstream file(path);
+    std::string value;
+    std::getline(file, value);
+    value.erase(value.find_last_not_of(" \t\r\n") + 1);
+    value.erase(0, value.find_first_not_of(" \t"));
+    return value;
+}
+
+uint64_t readSysfsNumber(const std::filesystem::path& path, uint64_t fallback) {
+    std::string value = readSysfsAttribute(path);
+    if (value.empty() || !std::all_of(value.begin(), value.end(), ::isdigit)) {
+        return fallback;
+    }
+    return std::stoull(value);
+}
+
+bool BlockDevice::operator==(const BlockDevice& other) const {
+    return name == other.name && model == other.model && sizeBytes == other.sizeBytes &&
+           rotational == other.rotational && removable == other.removable &&
+           logicalSectorSize == other.logicalSectorSize && physicalSectorSize == other.physicalSectorSize;
+}
+
+std::vector<BlockDevice> scanBlockDevices(const std::string& sysRoot) {
+    std::vector<BlockDevice> devices;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(sysRoot + "/block", ec)) {
+        std::string name = entry.path().filename();
+        if (!isCandidateDisk(name, entry.path())) {
+            continue;
+        }
+
+        BlockDevice device;
+        device.name = name;
+        device.path = "/dev/" + name;
+        // sysfs oppgir alltid størrelse i 512-byte sektorer
+        device.sizeBytes = readSysfsNumber(entry.path() / "size", 0) * 512;
+        if (device.sizeBytes == 0 || readSysfsNumber(entry.path() / "ro", 0) != 0) {
+            continue;
+        }
+        device.model = readSysfsAttribute(entry.path() / "device" / "model");
+        if (device.model.empty()) {
+            device.model = readSysfsAttribute(entry.path() / "device" / "name"); // eMMC/SD
+        }
+        device.rotational = readSysfsNumber(entry.path() / "queue" / "rotational", 0) != 0;
+        device.removable = readSysfsNumber(entry.path() / "removable", 0) != 0;
+        device.logicalSectorSize = static_cast<int>(readSysfsNumber(entry.path() / "queue" / "logical_block_size", 512));
+        device.physicalSectorSize = static_cast<int>(readSysfsNumber(entry.path() / "queue" / "physical_block_size", device.logicalSectorSize));
+        devices.push_back(device);
+    }
+    std::sort(devices.begin(), devices.end(), [](const BlockDevice& a, const BlockDevice& b) { return a.name < b.name; });
+    return devices;
+}
+
+std::string formatDiskSize(uint64_t bytes) {
+    static const char units[] = { 'B', 'K', 'M', 'G', 'T', 'P' };
+    double value = static_cast<double>(bytes);
+    int unit = 0;
+    while (value >= 1024.0 && unit < 5) {
+        value /= 1024.0;
+        ++unit;
+    }
+    char buffer[32];
+    if (value == static_cast<double>(static_cast<uint64_t>(value))) {
+        snprintf(buffer, sizeof(buffer), "%llu%c", static_cast<unsigned long long>(value), units[unit]);
+    } else {
+        snprintf(buffer, sizeof(buffer), "%.1f%c", value, units[unit]);
+    }
+    return buffer;
+}
+
+std::string describeBlockDevice(const BlockDevice& device) {
+    std::string description = device.path + " - Size: " + formatDiskSize(device.sizeBytes);
+    if (!device.model.empty()) {
+        description += " - " + device.model;
+    }
+    description += device.rotational ? " (HDD)" : " (SSD)";
+    if (device.removable) {
+        description += " [removable]";
+    }
+    return description;
+}
+
+bool startDiskInventory(const std::string& sysRoot, std::function<void()> onChange) {
+    if (watcherThread.joinable()) {
+        return true;
+    }
+    if (pipe2(stopPipe, O_CLOEXEC) != 0) {
+        std::cerr << "Disk inventory: pipe2 failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    watcherThread = std::thread(watchBlockDevices, sysRoot, std::move(onChange), stopPipe[0]);
+    return true;
+}
+
+void stopDiskInventory() {
+    if (!watcherThread.joinable()) {
+        return;
+    }
+    char stop = 1;
+    if (write(stopPipe[1], &stop, 1) != 1) {
+        std::cerr << "Disk inventory: failed to signal watcher thread" << std::endl;
+    }
+    watcherThread.join();
+    close(stopPipe[0]);
+    close(stopPipe[1]);
+    stopPipe[0] = stopPipe[1] = -1;
+}
+
+std::vector<BlockDevice> getDiskInventory() {
+    std::lock_guard<std::mutex> lock(inventoryMutex);
+    return inventory;
+}
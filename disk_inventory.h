@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Blokkenheter lest direkte fra sysfs (/sys/block/*) uten underprosesser.
+// sysRoot kan peke på et falskt sysfs-tre for testing.
+
+struct BlockDevice {
+    std::string name;   // f.eks. "nvme0n1"
+    std::string path;   // f.eks. "/dev/nvme0n1"
+    std::string model;
+    uint64_t sizeBytes;
+    bool rotational;
+    bool removable;
+    int logicalSectorSize;
+    int physicalSectorSize;
+
+    bool operator==(const BlockDevice& other) const;
+};
+
+// Første linje av et sysfs-attributt uten omkringliggende blanktegn; tom hvis filen mangler
+std::string readSysfsAttribute(const std::filesystem::path& path);
+// Desimaltall fra sysfs, eller fallback hvis attributtet mangler eller ikke er et tall
+uint64_t readSysfsNumber(const std::filesystem::path& path, uint64_t fallback);
+
+// Leser alle installerbare disker under sysRoot/block, sortert på navn
+std::vector<BlockDevice> scanBlockDevices(const std::string& sysRoot = "/sys");
+
+// Størrelse i lsblk-format, f.eks. "465.8G"
+std::string formatDiskSize(uint64_t bytes);
+
+// Linjen som vises på "Select Drive", f.eks. "/dev/sda - Size: 465.8G - Samsung SSD (SSD)"
+std::string describeBlockDevice(const BlockDevice& device);
+
+// Skanner i en bakgrunnstråd og følger med på hotplug (netlink-uevents for /sys,
+// inotify på sysRoot/block ellers). onChange kalles fra bakgrunnstråden når listen endres.
+bool startDiskInventory(const std::string& sysRoot, std::function<void()> onChange);
+void stopDiskInventory();
+
+// Siste skannede liste, trygg å kalle fra UI-tråden
+std::vector<BlockDevice> getDiskInventory();
@@ -0,0 +1,212 @@
+#include "disk_wipe.h"
+#include "disk_inventory.h"
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace {
+
+// Grove anslag: TRIM av en hel SSD tar typisk sekunder, avlastet nulling litt mer. Uten
+// avlastning skriver kjernen nullene selv, i omtrent diskens sekvensielle hastighet.
+const double ESTIMATED_DISCARD_BYTES_PER_SECOND = 100e9;
+const double ESTIMATED_OFFLOADED_ZERO_BYTES_PER_SECOND = 20e9;
+const double DEFAULT_HDD_BYTES_PER_SECOND = 150e6;
+const double DEFAULT_SSD_BYTES_PER_SECOND = 500e6;
+const uint64_t ZERO_RANGE_BYTES = 256ull * 1024 * 1024;
+// Fremdriften meldes høyst så ofte, så ringbufferen ikke fylles av én disk
+const double PROGRESS_INTERVAL_SECONDS = 0.1;
+
+const char* methodName(WipeMethod method) {
+    switch (method) {
+        case WipeMethod::Discard: return "TRIM";
+        case WipeMethod::ZeroOut: return "zeroing";
+        case WipeMethod::PunchHole: return "hole punching";
+        case WipeMethod::Skip: return "skipped";
+    }
+    return "";
+}
+
+uint64_t roundDown(uint64_t value, uint64_t multiple) {
+    return std::max(multiple, value / multiple * multiple);
+}
+
+bool wipeRange(int fd, WipeMethod method, uint64_t offset, uint64_t length) {
+    uint64_t range[2] = { offset, length };
+    switch (method) {
+        case WipeMethod::Discard: return ioctl(fd, BLKDISCARD, range) == 0;
+        case WipeMethod::ZeroOut: return ioctl(fd, BLKZEROOUT, range) == 0;
+        case WipeMethod::PunchHole: return fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, length) == 0;
+        case WipeMethod::Skip: return true;
+    }
+    return false;
+}
+
+// Kjører planen; errorCode settes fra første feil
+bool runWipePlan(int fd, const WipePlan& plan, const WipeProgress& progress, int& errorCode) {
+    uint64_t rangeCount = (plan.sizeBytes + plan.rangeBytes - 1) / plan.rangeBytes;
+    std::atomic<uint64_t> nextRange{ 0 };
+    std::atomic<uint64_t> done{ 0 };
+    std::atomic<int> firstError{ 0 };
+    std::mutex progressMutex;
+    auto lastReport = std::chrono::steady_clock::now();
+
+    auto worker = [&]() {
+        while (firstError.load() == 0) {
+            uint64_t index = nextRange.fetch_add(1);
+            if (index >= rangeCount) {
+                return;
+            }
+            uint64_t offset = index * plan.rangeBytes;
+            uint64_t length = std::min(plan.rangeBytes, plan.sizeBytes - offset);
+            if (!wipeRange(fd, plan.method, offset, length)) {
+                int expected = 0;
+                firstError.compare_exchange_strong(expected, errno);
+                return;
+            }
+            uint64_t total = done += length;
+            std::lock_guard<std::mutex> lock(progressMutex);
+            if (secondsSince(lastReport) >= PROGRESS_INTERVAL_SECONDS) {
+                lastReport = std::chrono::steady_clock::now();
+                progress(total, plan.sizeBytes);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < std::max<uint64_t>(1, std::min<uint64_t>(plan.threads, rangeCount)); i++) {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    errorCode = firstError.load();
+    if (errorCode == 0) {
+        progress(plan.sizeBytes, plan.sizeBytes);
+    }
+    return errorCode == 0;
+}
+
+// Den bufrede undersøkelsen eller sysfs, med hastigheten UI-prosessen målte når den finnes
+StorageProbe probeForWipe(const std::string& path, double measuredMBps) {
+    StorageProbe probe;
+    if (!getStorageProbe(path, probe)) {
+        probe = readStorageAttributes(path);
+    }
+    if (measuredMBps > 0) {
+        probe.benchmarked = true;
+        probe.sequentialMBps = measuredMBps;
+    }
+    return probe;
+}
+
+} // namespace
+
+WipePlan planDiskWipe(const StorageProbe& probe, uint64_t sizeBytes, bool isBlockDevice) {
+    WipePlan plan = {};
+    plan.sizeBytes = sizeBytes;
+    plan.threads = WIPE_THREADS;
+    plan.alignBytes = std::max<uint64_t>(4096, std::max<uint64_t>(probe.logicalSectorSize, probe.discardGranularity));
+    if (!isBlockDevice) {
+        plan.method = WipeMethod::PunchHole;
+        plan.rangeBytes = WIPE_MAX_RANGE_BYTES;
+        plan.estimatedSeconds = 0.0;
+        return plan;
+    }
+    if (probe.supportsDiscard) {
+        plan.method = WipeMethod::Discard;
+        plan.rangeBytes = roundDown(std::min(probe.discardMaxBytes, WIPE_MAX_RANGE_BYTES), plan.alignBytes);
+        plan.estimatedSeconds = sizeBytes / ESTIMATED_DISCARD_BYTES_PER_SECOND;
+        return plan;
+    }
+    plan.method = WipeMethod::ZeroOut;
+    plan.rangeBytes = roundDown(ZERO_RANGE_BYTES, plan.alignBytes);
+    double bytesPerSecond = probe.benchmarked ? probe.sequentialMBps * 1e6
+                            : probe.rotational ? DEFAULT_HDD_BYTES_PER_SECOND : DEFAULT_SSD_BYTES_PER_SECOND;
+    if (probe.writeZeroesMaxBytes > 0 && !probe.rotational) {
+        bytesPerSecond = ESTIMATED_OFFLOADED_ZERO_BYTES_PER_SECOND;
+    }
+    plan.estimatedSeconds = sizeBytes / std::max(bytesPerSecond, 1.0);
+    // Én tråd er nok når kjernen skriver nullene selv; flere gir bare søking på en HDD
+    if (probe.rotational) {
+        plan.threads = 1;
+    }
+    if (plan.estimatedSeconds > WIPE_MAX_ZERO_SECONDS) {
+        plan.method = WipeMethod::Skip;
+    }
+    return plan;
+}
+
+WipePlan plannedDiskWipe(const std::string& disk, double measuredMBps) {
+    std::string name = disk.substr(disk.rfind('/') + 1);
+    uint64_t sizeBytes = readSysfsNumber(std::filesystem::path("/sys/class/block") / name / "size", 0) * 512;
+    return planDiskWipe(probeForWipe(disk, measuredMBps), sizeBytes, true);
+}
+
+std::string describeWipePlan(const WipePlan& plan) {
+    char text[128];
+    if (plan.method == WipeMethod::Skip) {
+        snprintf(text, sizeof(text), "wipe: skipped (zeroing would take about %.0f min)", plan.estimatedSeconds / 60.0);
+    } else {
+        snprintf(text, sizeof(text), "wipe: %s in %llu MiB ranges, about %.0f s", methodName(plan.method),
+                 static_cast<unsigned long long>(plan.rangeBytes / (1024 * 1024)), std::max(1.0, plan.estimatedSeconds));
+    }
+    return text;
+}
+
+bool wipeDisk(const std::string& path, double measuredMBps, const WipeLog& log, const WipeProgress& progress) {
+    auto start = std::chrono::steady_clock::now();
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        log("Cannot open " + path + ": " + strerror(errno));
+        return false;
+    }
+    bool isBlockDevice = false;
+    uint64_t sizeBytes = 0;
+    if (!deviceSize(fd, isBlockDevice, sizeBytes)) {
+        log("Cannot read size of " + path + ": " + strerror(errno));
+        close(fd);
+        return false;
+    }
+    StorageProbe probe = isBlockDevice ? probeForWipe(path, measuredMBps) : readStorageAttributes(path);
+    WipePlan plan = planDiskWipe(probe, sizeBytes, isBlockDevice);
+    log("Wiping " + gibibytes(sizeBytes) + " of " + path + ", " + describeWipePlan(plan));
+    if (plan.method == WipeMethod::Skip) {
+        close(fd);
+        return true;
+    }
+
+    int errorCode = 0;
+    bool ok = runWipePlan(fd, plan, progress, errorCode);
+    // Enkelte disker melder discard-støtte men avviser forespørslene
+    if (!ok && plan.method == WipeMethod::Discard && (errorCode == EOPNOTSUPP || errorCode == EINVAL || errorCode == EIO)) {
+        log(std::string("BLKDISCARD failed (") + strerror(errorCode) + "), zeroing instead");
+        probe.supportsDiscard = false;
+        plan = planDiskWipe(probe, sizeBytes, isBlockDevice);
+        log(describeWipePlan(plan));
+        ok = plan.method == WipeMethod::Skip || runWipePlan(fd, plan, progress, errorCode);
+    }
+    close(fd);
+    if (!ok) {
+        log(std::string("Wiping ") + path + " failed: " + strerror(errorCode));
+        return false;
+    }
+    double seconds = secondsSince(start);
+    char summary[160];
+    snprintf(summary, sizeof(summary), "Wiped %s with %s in %.1f s (%.1f GiB/s)", gibibytes(sizeBytes).c_str(), methodName(plan.method),
+             seconds, sizeBytes / (1024.0 * 1024.0 * 1024.0) / std::max(seconds, 1e-3));
+    log(summary);
+    return true;
+}
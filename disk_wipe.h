@@ -0,0 +1,52 @@
+#pragma once
+
+#include "storage_probe.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Tømmer hele disken før partisjonering, slik at en gjenbrukt SSD starter helt TRIM-et i stedet
+// for å bare miste signaturene. Diskens område deles i justerte biter som flere tråder sender
+// samtidig: BLKDISCARD når disken støtter det, ellers BLKZEROOUT, og hull (fallocate
+// PUNCH_HOLE) i image-filer. Bitstørrelsen følger discard_granularity og discard_max_bytes.
+
+enum class WipeMethod {
+    Discard,   // BLKDISCARD
+    ZeroOut,   // BLKZEROOUT; avlastet til disken når write_zeroes_max_bytes > 0
+    PunchHole, // Vanlige filer
+    Skip       // Nulling ville tatt for lang tid; partisjoneringen og mkfs overskriver det som betyr noe
+};
+
+const unsigned WIPE_THREADS = 4;
+const uint64_t WIPE_MAX_RANGE_BYTES = 1024ull * 1024 * 1024;
+// Full nulling uten avlastning hoppes over hvis den er beregnet til å ta lengre tid enn dette
+const double WIPE_MAX_ZERO_SECONDS = 300.0;
+
+struct WipePlan {
+    WipeMethod method;
+    uint64_t sizeBytes;
+    uint64_t rangeBytes;  // Størrelsen på hver forespørsel, et multiplum av alignBytes
+    uint64_t alignBytes;
+    unsigned threads;
+    double estimatedSeconds;
+};
+
+// Planen ut fra diskundersøkelsen, uten I/O. Estimatet er grovt for TRIM (disker varierer mye),
+// og bygger på den målte lesehastigheten for nulling.
+WipePlan planDiskWipe(const StorageProbe& probe, uint64_t sizeBytes, bool isBlockDevice);
+
+// Planen wipeDisk kommer til å følge for disken med samme measuredMBps, uten å åpne enheten
+// (størrelsen leses fra sysfs). Avspilling av et image bruker den til å vite om disken blir nullet.
+WipePlan plannedDiskWipe(const std::string& disk, double measuredMBps);
+
+// Kort beskrivelse for UI-et, f.eks. "wipe: TRIM in 1024 MiB ranges, about 4 s"
+std::string describeWipePlan(const WipePlan& plan);
+
+using WipeLog = std::function<void(const std::string&)>;
+using WipeProgress = std::function<void(uint64_t done, uint64_t total)>;
+
+// Tømmer en blokkenhet eller image-fil. Faller tilbake til BLKZEROOUT hvis BLKDISCARD avvises.
+// measuredMBps er lesehastigheten fra UI-prosessens diskundersøkelse (0 hvis disken ikke er målt);
+// hjelpekommandoen under sudo har ingen bufret undersøkelse og ville ellers brukt standardverdiene.
+bool wipeDisk(const std::string& path, double measuredMBps, const WipeLog& log, const WipeProgress& progress);
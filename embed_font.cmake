@@ -0,0 +1,14 @@
+# Turns a font file into a C++ array so it can be opened from memory with TTF_OpenFontRW.
+# Usage: cmake -DINPUT=<font> -DOUTPUT=<cpp> -P embed_font.cmake
+file(READ "${INPUT}" fontHex HEX)
+string(LENGTH "${fontHex}" fontHexLength)
+math(EXPR fontSize "${fontHexLength} / 2")
+# 16 bytes per line keeps the generated file readable in a debugger
+string(REGEX REPLACE "([0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f])" "\\1\n" fontHex "${fontHex}")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," fontBytes "${fontHex}")
+file(WRITE "${OUTPUT}.tmp"
+    "// Generated from ${INPUT} by embed_font.cmake, do not edit\n"
+    "#include \"embedded_font.h\"\n\n"
+    "const unsigned char embeddedFontData[] = {\n${fontBytes}\n};\n"
+    "const size_t embeddedFontSize = ${fontSize};\n")
+file(RENAME "${OUTPUT}.tmp" "${OUTPUT}")
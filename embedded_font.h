@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstddef>
+
+// test.ttf lagt inn i binærfilen ved bygging (embed_font.cmake), slik at fonten ikke må
+// finnes og leses fra disk ved oppstart
+extern const unsigned char embeddedFontData[];
+extern const size_t embeddedFontSize;
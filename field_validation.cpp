@@ -0,0 +1,601 @@
+#include "field_validation.h"
+#include "util.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+
+namespace {
+
+enum CharClass : uint8_t {
+    CharLower = 1,
+    CharUpper = 2,
+    CharDigit = 4,
+    CharHyphen = 8,
+    CharUnderscore = 16,
+    CharBase64Symbol = 32, // '+' og '/'
+    CharEmailSymbol = 64   // Tegnene RFC 5322 tillater i lokaldelen utenom bokstaver, tall og '.'
+};
+
+constexpr std::array<uint8_t, 256> makeCharClasses() {
+    std::array<uint8_t, 256> classes = {};
+    for (int c = 'a'; c <= 'z'; c++) {
+        classes[c] |= CharLower;
+    }
+    for (int c = 'A'; c <= 'Z'; c++) {
+        classes[c] |= CharUpper;
+    }
+    for (int c = '0'; c <= '9'; c++) {
+        classes[c] |= CharDigit;
+    }
+    classes['-'] |= CharHyphen | CharEmailSymbol;
+    classes['_'] |= CharUnderscore | CharEmailSymbol;
+    classes['+'] |= CharBase64Symbol | CharEmailSymbol;
+    classes['/'] |= CharBase64Symbol | CharEmailSymbol;
+    for (char c : "!#$%&'*=?^`{|}~") {
+        if (c != '\0') {
+            classes[static_cast<unsigned char>(c)] |= CharEmailSymbol;
+        }
+    }
+    return classes;
+}
+
+constexpr std::array<uint8_t, 256> CHAR_CLASSES = makeCharClasses();
+constexpr uint8_t CharAlnum = CharLower | CharUpper | CharDigit;
+
+bool is(unsigned char c, uint8_t classes) {
+    return (CHAR_CLASSES[c] & classes) != 0;
+}
+
+enum ValidationError : uint8_t {
+    NoError,
+    HostnameChar,
+    HostnameEmptyLabel,
+    HostnameLabelHyphen,
+    HostnameLabelEndHyphen,
+    HostnameLabelTooLong,
+    HostnameTooLong,
+    UsernameStart,
+    UsernameChar,
+    UsernameDollar,
+    UsernameTooLong,
+    GithubChar,
+    GithubHyphen,
+    GithubTooLong,
+    EmailChar,
+    EmailDot,
+    EmailAt,
+    EmailLocalTooLong,
+    EmailDomain,
+    EmailTooLong,
+    SshKeyType,
+    SshKeyChar,
+    SshKeyMismatch,
+    SshKeyPadding,
+    SshKeyLength,
+    SshCommentChar
+};
+
+const char* ERROR_MESSAGES[] = {
+    "",
+    "Use a-z, 0-9, '-' and '.'",
+    "Empty label ('..' or leading '.')",
+    "Labels cannot start with '-'",
+    "Labels cannot end with '-'",
+    "Labels are at most 63 characters",
+    "At most 253 characters",
+    "Start with a-z or '_'",
+    "Use a-z, 0-9, '_' and '-'",
+    "'$' is only allowed last",
+    "At most 32 characters",
+    "Use letters, digits and '-'",
+    "No leading or double '-'",
+    "At most 39 characters",
+    "Invalid character in address",
+    "Misplaced '.'",
+    "Exactly one '@' is needed",
+    "Local part is at most 64 characters",
+    "Invalid domain",
+    "At most 254 characters",
+    "Unknown key type",
+    "Key data must be base64",
+    "Key data does not match its type",
+    "Invalid base64 padding",
+    "Key data has the wrong length",
+    "Comment cannot contain control characters"
+};
+
+enum HostnamePhase : uint8_t { HostLabelStart, HostLabel, HostHyphen };
+enum UsernamePhase : uint8_t { UserStart, UserBody, UserDollar };
+enum GithubPhase : uint8_t { GithubStart, GithubAlnum, GithubAfterHyphen };
+enum EmailPhase : uint8_t { EmailLocalStart, EmailLocal, EmailLocalDot, EmailDomainStart, EmailDomainLabel, EmailDomainHyphen };
+enum SshPhase : uint8_t { SshType, SshSpace, SshData, SshPad, SshComment };
+
+const uint16_t HOSTNAME_MAX_LENGTH = 253;
+const uint16_t LABEL_MAX_LENGTH = 63;
+const uint16_t USERNAME_MAX_LENGTH = 32;
+const uint16_t GITHUB_MAX_LENGTH = 39;
+const uint16_t EMAIL_LOCAL_MAX_LENGTH = 64;
+const uint16_t EMAIL_MAX_LENGTH = 254;
+
+// Nøkkeltypene OpenSSH godtar i authorized_keys (ssh-dss er tatt ut av nyere versjoner), med
+// lengden på de dekodede nøkkeldataene. RSA og sikkerhetsnøklene (med applikasjonsstrengen, minst
+// "ssh:") har bare en nedre grense; for RSA er den en nøkkel på 1024 bit med e = 3.
+struct SshKeyTypeSpec {
+    const char* name;
+    uint16_t minBytes;
+    uint16_t maxBytes; // 0 når lengden varierer
+};
+
+const SshKeyTypeSpec SSH_KEY_TYPES[] = {
+    { "ssh-ed25519", 51, 51 },
+    { "ssh-rsa", 149, 0 },
+    { "ecdsa-sha2-nistp256", 104, 104 },
+    { "ecdsa-sha2-nistp384", 136, 136 },
+    { "ecdsa-sha2-nistp521", 172, 172 },
+    { "sk-ssh-ed25519@openssh.com", 74, 0 },
+    { "sk-ecdsa-sha2-nistp256@openssh.com", 127, 0 }
+};
+const int SSH_KEY_TYPE_COUNT = sizeof(SSH_KEY_TYPES) / sizeof(SSH_KEY_TYPES[0]);
+
+// Nøkkeldataene starter med typenavnet, lengdeprefikset som en SSH-streng. Base64-tegnene som
+// bare avhenger av disse bytene er kjent på forhånd og sjekkes mens de skrives.
+struct SshKeyFormat {
+    std::string name;
+    std::string dataPrefix;
+    uint16_t minBytes;
+    uint16_t maxBytes;
+};
+
+const std::vector<SshKeyFormat>& sshKeyTypes() {
+    static const std::vector<SshKeyFormat> types = [] {
+        const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::vector<SshKeyFormat> result;
+        for (const auto& spec : SSH_KEY_TYPES) {
+            const char* name = spec.name;
+            std::string bytes = { 0, 0, 0, static_cast<char>(strlen(name)) };
+            bytes += name;
+            std::string prefix;
+            for (size_t i = 0; i + 3 <= bytes.size(); i += 3) {
+                uint32_t group = static_cast<unsigned char>(bytes[i]) << 16 | static_cast<unsigned char>(bytes[i + 1]) << 8 |
+                                 static_cast<unsigned char>(bytes[i + 2]);
+                for (int shift = 18; shift >= 0; shift -= 6) {
+                    prefix += alphabet[(group >> shift) & 63];
+                }
+            }
+            result.push_back({ name, prefix, spec.minBytes, spec.maxBytes });
+        }
+        return result;
+    }();
+    return types;
+}
+
+ValidationState fail(ValidationState state, ValidationError error) {
+    state.error = error;
+    return state;
+}
+
+ValidationState stepHostname(ValidationState s, unsigned char c) {
+    if (s.length > HOSTNAME_MAX_LENGTH) {
+        return fail(s, HostnameTooLong);
+    }
+    // Bare små bokstaver, som meldingen sier; NixOS bruker networking.hostName som den er
+    if (is(c, CharLower | CharDigit)) {
+        s.phase = HostLabel;
+    } else if (c == '-') {
+        if (s.phase == HostLabelStart) {
+            return fail(s, HostnameLabelHyphen);
+        }
+        s.phase = HostHyphen;
+    } else if (c == '.') {
+        if (s.phase == HostLabelStart) {
+            return fail(s, HostnameEmptyLabel);
+        }
+        if (s.phase == HostHyphen) {
+            return fail(s, HostnameLabelEndHyphen);
+        }
+        s.phase = HostLabelStart;
+        s.run = 0;
+        s.index++;
+        return s;
+    } else {
+        return fail(s, HostnameChar);
+    }
+    if (++s.run > LABEL_MAX_LENGTH) {
+        return fail(s, HostnameLabelTooLong);
+    }
+    return s;
+}
+
+ValidationState stepUsername(ValidationState s, unsigned char c) {
+    if (s.length > USERNAME_MAX_LENGTH) {
+        return fail(s, UsernameTooLong);
+    }
+    switch (s.phase) {
+        case UserStart:
+            if (!is(c, CharLower | CharUnderscore)) {
+                return fail(s, UsernameStart);
+            }
+            s.phase = UserBody;
+            return s;
+        case UserBody:
+            if (c == '$') {
+                s.phase = UserDollar;
+            } else if (!is(c, CharLower | CharDigit | CharUnderscore | CharHyphen)) {
+                return fail(s, UsernameChar);
+            }
+            return s;
+        default:
+            return fail(s, UsernameDollar);
+    }
+}
+
+ValidationState stepGithubUsername(ValidationState s, unsigned char c) {
+    if (s.length > GITHUB_MAX_LENGTH) {
+        return fail(s, GithubTooLong);
+    }
+    if (is(c, CharAlnum)) {
+        s.phase = GithubAlnum;
+    } else if (c == '-') {
+        if (s.phase != GithubAlnum) {
+            return fail(s, GithubHyphen);
+        }
+        s.phase = GithubAfterHyphen;
+    } else {
+        return fail(s, GithubChar);
+    }
+    return s;
+}
+
+ValidationState stepEmail(ValidationState s, unsigned char c) {
+    if (s.length > EMAIL_MAX_LENGTH) {
+        return fail(s, EmailTooLong);
+    }
+    switch (s.phase) {
+        case EmailLocalStart:
+        case EmailLocal:
+        case EmailLocalDot:
+            if (is(c, CharAlnum | CharEmailSymbol)) {
+                s.phase = EmailLocal;
+                if (++s.run > EMAIL_LOCAL_MAX_LENGTH) {
+                    return fail(s, EmailLocalTooLong);
+                }
+            } else if (c == '.') {
+                if (s.phase != EmailLocal) {
+                    return fail(s, EmailDot);
+                }
+                s.phase = EmailLocalDot;
+                s.run++;
+            } else if (c == '@') {
+                if (s.phase == EmailLocalStart) {
+                    return fail(s, EmailAt);
+                }
+                if (s.phase == EmailLocalDot) {
+                    return fail(s, EmailDot);
+                }
+                s.phase = EmailDomainStart;
+                s.run = 0;
+            } else {
+                return fail(s, EmailChar);
+            }
+            return s;
+        default:
+            // Domenet følger samme regler som et vertsnavn
+            if (is(c, CharAlnum)) {
+                s.phase = EmailDomainLabel;
+            } else if (c == '-') {
+                if (s.phase == EmailDomainStart) {
+                    return fail(s, EmailDomain);
+                }
+                s.phase = EmailDomainHyphen;
+            } else if (c == '.') {
+                if (s.phase != EmailDomainLabel) {
+                    return fail(s, s.phase == EmailDomainStart ? EmailDot : EmailDomain);
+                }
+                s.phase = EmailDomainStart;
+                s.run = 0;
+                s.index++;
+                return s;
+            } else if (c == '@') {
+                return fail(s, EmailAt);
+            } else {
+                return fail(s, EmailChar);
+            }
+            if (++s.run > LABEL_MAX_LENGTH) {
+                return fail(s, EmailDomain);
+            }
+            return s;
+    }
+}
+
+// Hele base64-blokker og riktig dekodet lengde for typen; run teller tegnene foran '='
+bool sshKeyDataComplete(const ValidationState& s) {
+    const SshKeyFormat& format = sshKeyTypes()[s.index];
+    if ((s.run + s.padding) % 4 != 0 || s.run <= format.dataPrefix.size()) {
+        return false;
+    }
+    uint32_t bytes = (s.run + s.padding) / 4 * 3 - s.padding;
+    return bytes >= format.minBytes && (format.maxBytes == 0 || bytes <= format.maxBytes);
+}
+
+ValidationState stepSshKey(ValidationState s, unsigned char c) {
+    const std::vector<SshKeyFormat>& types = sshKeyTypes();
+    switch (s.phase) {
+        case SshType: {
+            if (c == ' ') {
+                // Typen er valgt når navnet er skrevet helt ut
+                for (int i = 0; i < SSH_KEY_TYPE_COUNT; i++) {
+                    if ((s.candidates & (1u << i)) && types[i].name.size() == s.run) {
+                        s.phase = SshSpace;
+                        s.index = static_cast<uint16_t>(i);
+                        s.run = 0;
+                        return s;
+                    }
+                }
+                return fail(s, SshKeyType);
+            }
+            uint32_t remaining = 0;
+            for (int i = 0; i < SSH_KEY_TYPE_COUNT; i++) {
+                if ((s.candidates & (1u << i)) && s.run < types[i].name.size() && types[i].name[s.run] == c) {
+                    remaining |= 1u << i;
+                }
+            }
+            if (remaining == 0) {
+                return fail(s, SshKeyType);
+            }
+            s.candidates = remaining;
+            s.run++;
+            return s;
+        }
+        case SshSpace:
+            if (c == ' ') {
+                return s;
+            }
+            s.phase = SshData;
+            [[fallthrough]];
+        case SshData: {
+            if (c == '=') {
+                s.phase = SshPad;
+                s.padding = 1;
+                return s;
+            }
+            if (c == ' ') {
+                if (!sshKeyDataComplete(s)) {
+                    return fail(s, SshKeyLength);
+                }
+                s.phase = SshComment;
+                return s;
+            }
+            if (!is(c, CharAlnum | CharBase64Symbol)) {
+                return fail(s, SshKeyChar);
+            }
+            const std::string& prefix = types[s.index].dataPrefix;
+            if (s.run < prefix.size() && prefix[s.run] != static_cast<char>(c)) {
+                return fail(s, SshKeyMismatch);
+            }
+            // Flere tegn enn den faste lengden kan ha (4 tegn per 3 byte, uten '=')
+            uint16_t maxBytes = types[s.index].maxBytes;
+            if (maxBytes > 0 && s.run >= (maxBytes * 4 + 2) / 3) {
+                return fail(s, SshKeyLength);
+            }
+            s.run++;
+            return s;
+        }
+        case SshPad:
+            if (c == '=' && s.padding < 2) {
+                s.padding++;
+                return s;
+            }
+            if (c == ' ' && sshKeyDataComplete(s)) {
+                s.phase = SshComment;
+                return s;
+            }
+            return fail(s, c == ' ' ? SshKeyLength : SshKeyPadding);
+        default:
+            // Kommentaren er fri tekst (også UTF-8), men ingen kontrolltegn eller linjeskift
+            if (c < 0x20 || c == 0x7f) {
+                return fail(s, SshCommentChar);
+            }
+            return s;
+    }
+}
+
+ValidationState step(FieldKind kind, ValidationState state, unsigned char c) {
+    if (state.error != NoError) {
+        state.length++;
+        return state;
+    }
+    state.length++;
+    switch (kind) {
+        case FieldKind::Hostname: return stepHostname(state, c);
+        case FieldKind::Username: return stepUsername(state, c);
+        case FieldKind::GithubUsername: return stepGithubUsername(state, c);
+        case FieldKind::Email: return stepEmail(state, c);
+        case FieldKind::SshPublicKey: return stepSshKey(state, c);
+        case FieldKind::None: return state;
+    }
+    return state;
+}
+
+ValidationState initialState(FieldKind kind) {
+    ValidationState state;
+    if (kind == FieldKind::SshPublicKey) {
+        state.candidates = (1u << SSH_KEY_TYPE_COUNT) - 1;
+    }
+    return state;
+}
+
+// Sluttilstandene: er det som står der nå gyldig, eller bare en gyldig begynnelse?
+ValidationResult finish(FieldKind kind, const ValidationState& s) {
+    if (s.length == 0) {
+        return { Validity::Empty, "" };
+    }
+    if (s.error != NoError) {
+        return { Validity::Invalid, ERROR_MESSAGES[s.error] };
+    }
+    switch (kind) {
+        case FieldKind::Hostname:
+            if (s.phase == HostHyphen) {
+                return { Validity::Incomplete, "Cannot end with '-'" };
+            }
+            if (s.phase == HostLabelStart) {
+                return { Validity::Incomplete, "Cannot end with '.'" };
+            }
+            break;
+        case FieldKind::GithubUsername:
+            if (s.phase == GithubAfterHyphen) {
+                return { Validity::Incomplete, "Cannot end with '-'" };
+            }
+            break;
+        case FieldKind::Email:
+            if (s.phase <= EmailLocalDot) {
+                return { Validity::Incomplete, "Missing '@'" };
+            }
+            if (s.phase == EmailDomainStart) {
+                return { Validity::Incomplete, s.index == 0 ? "Missing domain" : "Cannot end with '.'" };
+            }
+            if (s.phase == EmailDomainHyphen) {
+                return { Validity::Incomplete, "Cannot end with '-'" };
+            }
+            if (s.index == 0) {
+                return { Validity::Incomplete, "Domain needs a '.'" };
+            }
+            break;
+        case FieldKind::SshPublicKey:
+            if (s.phase == SshType) {
+                return { Validity::Incomplete, "Incomplete key type" };
+            }
+            if (s.phase == SshSpace) {
+                return { Validity::Incomplete, "Missing key data" };
+            }
+            if ((s.phase == SshData || s.phase == SshPad) && !sshKeyDataComplete(s)) {
+                // Etter '=' kan ikke flere tegn gjøre en for kort nøkkel riktig
+                if (s.phase == SshPad && (s.run + s.padding) % 4 == 0) {
+                    return { Validity::Invalid, ERROR_MESSAGES[SshKeyLength] };
+                }
+                return { Validity::Incomplete, "Key data is incomplete" };
+            }
+            break;
+        case FieldKind::Username:
+        case FieldKind::None:
+            break;
+    }
+    return { Validity::Valid, "" };
+}
+
+} // namespace
+
+FieldKind fieldKindForLabel(const std::string& label) {
+    if (label == "Hostname") {
+        return FieldKind::Hostname;
+    }
+    if (label == "Username") {
+        return FieldKind::Username;
+    }
+    if (label == "Github Username") {
+        return FieldKind::GithubUsername;
+    }
+    if (label == "Github E-mail") {
+        return FieldKind::Email;
+    }
+    if (label == "SSH Github Key") {
+        return FieldKind::SshPublicKey;
+    }
+    return FieldKind::None;
+}
+
+void resetValidator(FieldValidator& validator, FieldKind kind, const std::string& value) {
+    validator.kind = kind;
+    validator.history.clear();
+    validator.history.push_back(initialState(kind));
+    validatorAppend(validator, value);
+}
+
+void validatorAppend(FieldValidator& validator, const std::string& text) {
+    if (validator.history.empty()) {
+        validator.history.push_back(initialState(validator.kind));
+    }
+    for (unsigned char c : text) {
+        validator.history.push_back(step(validator.kind, validator.history.back(), c));
+    }
+}
+
+void validatorBackspace(FieldValidator& validator) {
+    if (validator.history.size() > 1) {
+        validator.history.pop_back();
+    }
+}
+
+ValidationResult validatorResult(const FieldValidator& validator) {
+    return finish(validator.kind, validator.history.empty() ? initialState(validator.kind) : validator.history.back());
+}
+
+ValidationResult validateField(FieldKind kind, const std::string& value) {
+    ValidationState state = initialState(kind);
+    for (unsigned char c : value) {
+        state = step(kind, state, c);
+    }
+    return finish(kind, state);
+}
+
+int benchmarkFieldValidation(int iterations) {
+    const std::vector<std::string> emails = {
+        "ola.nordmann@example.com", "kari_nordmann@mail.example.no", "first.last+tag@sub.domain.example.org",
+        "not-an-address", "trailing.dot.@example.com", "a@b", "someone@localhost", "x@y.z"
+    };
+    // Uttrykket installer_ui brukte før
+    const char* pattern = "(\\w+)(\\.|_)?(\\w*)@(\\w+)(\\.(\\w+))+";
+    size_t keystrokes = 0;
+    for (const auto& email : emails) {
+        keystrokes += email.size();
+    }
+    keystrokes *= iterations;
+
+    // Hvert tastetrykk validerer hele verdien på nytt, med en ny regex hver gang
+    size_t accepted = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        for (const auto& email : emails) {
+            for (size_t length = 1; length <= email.size(); length++) {
+                accepted += std::regex_match(email.substr(0, length), std::regex(pattern));
+            }
+        }
+    }
+    double rebuiltSeconds = secondsSince(start);
+
+    const std::regex compiled(pattern);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        for (const auto& email : emails) {
+            for (size_t length = 1; length <= email.size(); length++) {
+                accepted += std::regex_match(email.substr(0, length), compiled);
+            }
+        }
+    }
+    double compiledSeconds = secondsSince(start);
+
+    FieldValidator validator;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        for (const auto& email : emails) {
+            resetValidator(validator, FieldKind::Email, "");
+            for (char c : email) {
+                validatorAppend(validator, std::string(1, c));
+                accepted += validatorResult(validator).validity == Validity::Valid;
+            }
+        }
+    }
+    double automatonSeconds = secondsSince(start);
+
+    auto perKeystroke = [keystrokes](double seconds) { return seconds * 1e9 / std::max<size_t>(1, keystrokes); };
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "keystrokes:             " << keystrokes << " (" << accepted << " accepted)" << std::endl;
+    std::cout << "regex, built per call:  " << perKeystroke(rebuiltSeconds) << " ns/keystroke" << std::endl;
+    std::cout << "regex, precompiled:     " << perKeystroke(compiledSeconds) << " ns/keystroke" << std::endl;
+    std::cout << "incremental automaton:  " << perKeystroke(automatonSeconds) << " ns/keystroke" << std::endl;
+    return 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Validering av feltene på "Your info" mens brukeren skriver. Hver felttype er en håndskrevet
+// automat over bytes med en constexpr-tabell for tegnklassene. Tilstanden etter hver byte lagres,
+// så et nytt tegn er ett steg i automaten og backspace bare fjerner siste tilstand, uansett
+// hvor lang verdien er.
+
+enum class FieldKind {
+    None,           // Ingen regler, f.eks. passord
+    Hostname,       // RFC 1123: etiketter av a-z, 0-9 og '-', skilt med '.'
+    Username,       // POSIX/shadow: [a-z_][a-z0-9_-]*[$]?, høyst 32 tegn
+    GithubUsername, // Bokstaver, tall og enkle '-' inni, høyst 39 tegn
+    Email,
+    SshPublicKey    // "<type> <base64> [kommentar]" som i authorized_keys
+};
+
+enum class Validity {
+    Empty,
+    Valid,
+    Incomplete, // Kan bli gyldig hvis brukeren skriver videre
+    Invalid     // Blir ikke gyldig før tegnet som feilet er slettet
+};
+
+struct ValidationResult {
+    Validity validity;
+    const char* message; // Kort tekst til visning ved feltet, tom når verdien er gyldig
+};
+
+// Tilstanden til automaten etter en gitt byte
+struct ValidationState {
+    uint8_t phase = 0;
+    uint8_t error = 0;        // Første feil; når den er satt, står automaten stille
+    uint8_t padding = 0;      // Antall '=' i SSH-nøkkeldataene
+    uint16_t run = 0;         // Lengden på gjeldende etikett, lokaldel eller base64-blokk
+    uint16_t length = 0;
+    uint16_t index = 0;       // Antall etiketter i domenet, eller valgt SSH-nøkkeltype
+    uint32_t candidates = 0;  // SSH-nøkkeltyper som fortsatt passer med det som er skrevet
+};
+
+struct FieldValidator {
+    FieldKind kind = FieldKind::None;
+    std::vector<ValidationState> history; // history[0] er starttilstanden, deretter én per byte
+};
+
+FieldKind fieldKindForLabel(const std::string& label);
+
+void resetValidator(FieldValidator& validator, FieldKind kind, const std::string& value);
+void validatorAppend(FieldValidator& validator, const std::string& text);
+// Fjerner siste byte, som std::string::pop_back på feltverdien
+void validatorBackspace(FieldValidator& validator);
+ValidationResult validatorResult(const FieldValidator& validator);
+
+// Hele verdien på én gang, f.eks. fra en svarfil
+ValidationResult validateField(FieldKind kind, const std::string& value);
+
+// Sammenligner automaten med std::regex (ny regex per kall, som før, og forhåndskompilert) når
+// e-postadresser skrives tegn for tegn og hele verdien valideres ved hvert tastetrykk
+int benchmarkFieldValidation(int iterations);
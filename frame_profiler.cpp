@@ -0,0 +1,108 @@
+#include "frame_profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+// Nok til noen sekunders kontinuerlig tegning per steg, og et par minutter med trace
+const size_t SAMPLES_PER_STAGE = 1024;
+const size_t MAX_TRACE_EVENTS = 200000;
+
+const char* STAGE_NAMES[] = { "Frame", "Events", "Layout", "Chrome", "Menu", "Page", "Text flush", "Overlay", "Present" };
+static_assert(sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]) == static_cast<size_t>(FrameStage::Count), "one name per stage");
+
+struct StageSamples {
+    std::array<uint32_t, SAMPLES_PER_STAGE> durationsNs{};
+    size_t next = 0;
+    size_t count = 0;
+};
+
+struct TraceEvent {
+    FrameStage stage;
+    uint64_t startNs;
+    uint64_t durationNs;
+};
+
+std::array<StageSamples, static_cast<size_t>(FrameStage::Count)> stageSamples;
+// Ringbuffer: når den er full overskrives de eldste hendelsene
+std::vector<TraceEvent> traceEvents;
+size_t traceNext = 0;
+uint64_t traceOriginNs = 0;
+
+} // namespace
+
+bool frameProfilingEnabled = false;
+
+uint64_t profileClockNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void profileEnd(FrameStage stage, uint64_t start) {
+    // start er 0 hvis målingen ble slått på midt i et område
+    if (!frameProfilingEnabled || start == 0) {
+        return;
+    }
+    uint64_t duration = profileClockNs() - start;
+    StageSamples& samples = stageSamples[static_cast<size_t>(stage)];
+    samples.durationsNs[samples.next] = static_cast<uint32_t>(std::min<uint64_t>(duration, UINT32_MAX));
+    samples.next = (samples.next + 1) % SAMPLES_PER_STAGE;
+    samples.count = std::min(samples.count + 1, SAMPLES_PER_STAGE);
+
+    TraceEvent event = { stage, start, duration };
+    if (traceEvents.size() < MAX_TRACE_EVENTS) {
+        traceEvents.push_back(event);
+    } else {
+        traceEvents[traceNext] = event;
+        traceNext = (traceNext + 1) % MAX_TRACE_EVENTS;
+    }
+}
+
+void setFrameProfilingEnabled(bool enabled) {
+    if (enabled && !frameProfilingEnabled && traceOriginNs == 0) {
+        traceOriginNs = profileClockNs();
+        traceEvents.reserve(4096);
+    }
+    frameProfilingEnabled = enabled;
+}
+
+std::vector<StageSummary> summarizeFrameStages() {
+    std::vector<StageSummary> summaries;
+    std::vector<uint32_t> sorted;
+    for (size_t stage = 0; stage < stageSamples.size(); stage++) {
+        const StageSamples& samples = stageSamples[stage];
+        StageSummary summary = { STAGE_NAMES[stage], samples.count, 0.0, 0.0, 0.0 };
+        if (samples.count > 0) {
+            sorted.assign(samples.durationsNs.begin(), samples.durationsNs.begin() + samples.count);
+            std::sort(sorted.begin(), sorted.end());
+            summary.p50Ms = sorted[(sorted.size() - 1) / 2] / 1e6;
+            summary.p99Ms = sorted[(sorted.size() - 1) * 99 / 100] / 1e6;
+            summary.maxMs = sorted.back() / 1e6;
+        }
+        summaries.push_back(summary);
+    }
+    return summaries;
+}
+
+bool writeChromeTrace(const std::string& path) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Cannot write trace to " << path << std::endl;
+        return false;
+    }
+    // Eldste hendelse først; rekkefølgen spiller ingen rolle for visningen, men gjør filen lesbar
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (size_t i = 0; i < traceEvents.size(); i++) {
+        const TraceEvent& event = traceEvents[(traceNext + i) % traceEvents.size()];
+        uint64_t startNs = event.startNs > traceOriginNs ? event.startNs - traceOriginNs : 0;
+        file << (i == 0 ? "" : ",\n") << "{\"name\":\"" << STAGE_NAMES[static_cast<size_t>(event.stage)]
+             << "\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << startNs / 1000.0
+             << ",\"dur\":" << event.durationNs / 1000.0 << "}";
+    }
+    file << "\n]}\n";
+    std::cerr << "Wrote " << traceEvents.size() << " trace events to " << path << std::endl;
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Tidsmåling av stegene i hovedløkken. Av som standard: da koster en måling én lest bool
+// og ingen klokkeavlesning. Slås på med F12 (overlay), NIXUM_PROFILE=1 eller NIXUM_TRACE=<fil>,
+// som i tillegg skriver en Chrome trace-fil (chrome://tracing, Perfetto) ved avslutning.
+
+enum class FrameStage {
+    Frame,
+    Events,
+    Layout,
+    Chrome,
+    Menu,
+    Page,
+    TextFlush,
+    Overlay,
+    Present,
+    Count
+};
+
+extern bool frameProfilingEnabled;
+
+uint64_t profileClockNs();
+
+// For områder som ikke passer i et skop, f.eks. hendelsesløkken
+inline uint64_t profileStart() {
+    return frameProfilingEnabled ? profileClockNs() : 0;
+}
+void profileEnd(FrameStage stage, uint64_t start);
+
+class ProfileScope {
+public:
+    explicit ProfileScope(FrameStage stage) : stage(stage), start(profileStart()) {}
+    ~ProfileScope() { profileEnd(stage, start); }
+
+private:
+    FrameStage stage;
+    uint64_t start;
+};
+
+struct StageSummary {
+    const char* name;
+    size_t samples;
+    double p50Ms;
+    double p99Ms;
+    double maxMs;
+};
+
+void setFrameProfilingEnabled(bool enabled);
+
+// Persentiler over de siste målingene per steg
+std::vector<StageSummary> summarizeFrameStages();
+
+// Skriver de siste hendelsene som Chrome trace-event JSON
+bool writeChromeTrace(const std::string& path);
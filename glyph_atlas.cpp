@@ -0,0 +1,204 @@
+#include "glyph_atlas.h"
+#include "redraw_scheduler.h"
+#include "text_layout.h"
+
+#include <algorithm>
+#include <climits>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+const int GLYPH_COUNT = ATLAS_LAST_CODEPOINT - ATLAS_FIRST_CODEPOINT + 1;
+const int GLYPH_PADDING = 1;
+
+struct AtlasGlyph {
+    SDL_Rect src;
+    int advance; // -1 når fonten mangler glyfen
+};
+
+struct GlyphAtlas {
+    SDL_Texture* texture = nullptr;
+    TTF_Font* font = nullptr;
+    int width = 0, height = 0;
+    int viewportHeight = INT_MAX; // Linjer helt utenfor hoppes over
+    AtlasGlyph glyphs[2][GLYPH_COUNT];
+};
+
+GlyphAtlas atlas;
+std::vector<SDL_Vertex> batchVertices;
+std::vector<int> batchIndices;
+
+const AtlasGlyph* findGlyph(Uint32 cp, bool bold) {
+    if (cp < ATLAS_FIRST_CODEPOINT || cp > ATLAS_LAST_CODEPOINT) {
+        return nullptr;
+    }
+    const AtlasGlyph* glyph = &atlas.glyphs[bold ? 1 : 0][cp - ATLAS_FIRST_CODEPOINT];
+    return glyph->advance < 0 ? nullptr : glyph;
+}
+
+} // namespace
+
+bool initGlyphAtlas(SDL_Renderer* renderer, TTF_Font* font) {
+    destroyGlyphAtlas();
+
+    const SDL_Color white = { 255, 255, 255, 255 };
+    std::vector<SDL_Surface*> surfaces(2 * GLYPH_COUNT, nullptr);
+
+    // Første pass: rasteriser og pakk glyfene i rader
+    int penX = 0, penY = 0, rowHeight = 0;
+    for (int style = 0; style < 2; ++style) {
+        TTF_SetFontStyle(font, style == 1 ? TTF_STYLE_BOLD : TTF_STYLE_NORMAL);
+        for (int i = 0; i < GLYPH_COUNT; ++i) {
+            Uint16 cp = static_cast<Uint16>(ATLAS_FIRST_CODEPOINT + i);
+            AtlasGlyph& glyph = atlas.glyphs[style][i];
+            glyph.advance = -1;
+            int minx, maxx, miny, maxy, advance;
+            if (!TTF_GlyphIsProvided(font, cp) || TTF_GlyphMetrics(font, cp, &minx, &maxx, &miny, &maxy, &advance) != 0) {
+                continue;
+            }
+            SDL_Surface* surface = TTF_RenderGlyph_Blended(font, cp, white);
+            if (surface == nullptr) {
+                continue;
+            }
+            if (penX + surface->w > ATLAS_WIDTH) {
+                penX = 0;
+                penY += rowHeight + GLYPH_PADDING;
+                rowHeight = 0;
+            }
+            glyph.src = { penX, penY, surface->w, surface->h };
+            glyph.advance = advance;
+            penX += surface->w + GLYPH_PADDING;
+            rowHeight = std::max(rowHeight, surface->h);
+            surfaces[style * GLYPH_COUNT + i] = surface;
+        }
+    }
+    TTF_SetFontStyle(font, TTF_STYLE_NORMAL);
+
+    // Andre pass: kopier glyfene inn i én atlasflate og last den opp
+    int atlasHeight = penY + rowHeight;
+    SDL_Surface* atlasSurface = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_WIDTH, atlasHeight > 0 ? atlasHeight : 1, 32, SDL_PIXELFORMAT_RGBA32);
+    if (atlasSurface == nullptr) {
+        std::cerr << "SDL_CreateRGBSurfaceWithFormat Error: " << SDL_GetError() << std::endl;
+        for (SDL_Surface* surface : surfaces) {
+            SDL_FreeSurface(surface);
+        }
+        return false;
+    }
+    SDL_FillRect(atlasSurface, nullptr, 0);
+    for (int i = 0; i < 2 * GLYPH_COUNT; ++i) {
+        SDL_Surface* surface = surfaces[i];
+        if (surface == nullptr) {
+            continue;
+        }
+        SDL_Rect dest = atlas.glyphs[i / GLYPH_COUNT][i % GLYPH_COUNT].src;
+        SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+        SDL_BlitSurface(surface, nullptr, atlasSurface, &dest);
+        SDL_FreeSurface(surface);
+    }
+
+    atlas.texture = SDL_CreateTextureFromSurface(renderer, atlasSurface);
+    atlas.width = atlasSurface->w;
+    atlas.height = atlasSurface->h;
+    SDL_FreeSurface(atlasSurface);
+    if (atlas.texture == nullptr) {
+        std::cerr << "SDL_CreateTextureFromSurface Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    SDL_SetTextureBlendMode(atlas.texture, SDL_BLENDMODE_BLEND);
+    atlas.font = font;
+    if (SDL_GetRendererOutputSize(renderer, nullptr, &atlas.viewportHeight) != 0) {
+        atlas.viewportHeight = INT_MAX;
+    }
+
+    batchVertices.reserve(4096);
+    batchIndices.reserve(6144);
+    std::cerr << "Glyph atlas: " << ATLAS_WIDTH << "x" << atlas.height << " texture" << std::endl;
+    return true;
+}
+
+void destroyGlyphAtlas() {
+    if (atlas.texture != nullptr) {
+        SDL_DestroyTexture(atlas.texture);
+    }
+    atlas.texture = nullptr;
+    atlas.font = nullptr;
+    batchVertices.clear();
+    batchIndices.clear();
+}
+
+bool glyphAtlasCovers(const std::string& text, bool bold) {
+    if (atlas.texture == nullptr) {
+        return false;
+    }
+    size_t pos = 0;
+    while (pos < text.size()) {
+        Uint32 cp = nextUtf8Codepoint(text, pos);
+        if (cp != '\n' && findGlyph(cp, bold) == nullptr) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Bruker den bufrede layouten, så uendret tekst bare blir quads; linjer utenfor skjermen
+// (f.eks. lang tekst som er rullet) hopper vi over uten å se på tegnene deres
+void queueAtlasText(const std::string& text, int x, int y, SDL_Color color, bool bold, int wrapLength) {
+    float invWidth = 1.0f / static_cast<float>(atlas.width);
+    float invHeight = 1.0f / static_cast<float>(atlas.height);
+    const TextLayout& layout = getTextLayout(atlas.font, text, bold, wrapLength);
+    size_t firstLine, endLine;
+    visibleLines(layout, -y, atlas.viewportHeight == INT_MAX ? INT_MAX : atlas.viewportHeight - y, &firstLine, &endLine);
+    for (size_t line = firstLine; line < endLine; line++) {
+        const LaidOutLine& laidOut = layout.lines[line];
+        for (size_t i = laidOut.firstChar; i < laidOut.endChar; i++) {
+            const LaidOutChar& c = layout.chars[i];
+            const AtlasGlyph* glyph = c.drawn ? findGlyph(c.codepoint, bold) : nullptr;
+            if (glyph == nullptr || glyph->src.w == 0) {
+                continue;
+            }
+            float left = static_cast<float>(x + c.x);
+            float top = static_cast<float>(y + laidOut.y);
+            float right = left + glyph->src.w;
+            float bottom = top + glyph->src.h;
+            float u0 = glyph->src.x * invWidth;
+            float v0 = glyph->src.y * invHeight;
+            float u1 = (glyph->src.x + glyph->src.w) * invWidth;
+            float v1 = (glyph->src.y + glyph->src.h) * invHeight;
+
+            int base = static_cast<int>(batchVertices.size());
+            batchVertices.push_back({ { left, top }, color, { u0, v0 } });
+            batchVertices.push_back({ { right, top }, color, { u1, v0 } });
+            batchVertices.push_back({ { right, bottom }, color, { u1, v1 } });
+            batchVertices.push_back({ { left, bottom }, color, { u0, v1 } });
+            batchIndices.insert(batchIndices.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
+        }
+    }
+}
+
+bool measureAtlasText(const std::string& text, bool bold, int wrapLength, int* width, int* height) {
+    if (!glyphAtlasCovers(text, bold)) {
+        return false;
+    }
+    const TextLayout& layout = getTextLayout(atlas.font, text, bold, wrapLength);
+    if (width != nullptr) {
+        *width = layout.width;
+    }
+    if (height != nullptr) {
+        *height = layout.height;
+    }
+    return true;
+}
+
+void flushTextBatch(SDL_Renderer* renderer) {
+    if (batchIndices.empty()) {
+        return;
+    }
+    if (SDL_RenderGeometry(renderer, atlas.texture, batchVertices.data(), static_cast<int>(batchVertices.size()),
+                           batchIndices.data(), static_cast<int>(batchIndices.size())) != 0) {
+        std::cerr << "SDL_RenderGeometry Error: " << SDL_GetError() << std::endl;
+    }
+    countDrawCalls(1);
+    batchVertices.clear();
+    batchIndices.clear();
+}
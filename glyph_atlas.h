@@ -0,0 +1,27 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <string>
+
+// Glyfatlas: alle Latin-1-tegn i normal og fet stil rasterisert én gang til én texture.
+// Tekst legges ut som quads og tegnes med ett SDL_RenderGeometry-kall per sammenhengende tekstløp.
+// Kalleren flusher batchen før all annen tegning, så tegnerekkefølgen blir som uten atlaset.
+const int ATLAS_FIRST_CODEPOINT = 32;
+const int ATLAS_LAST_CODEPOINT = 255;
+const int ATLAS_WIDTH = 1024;
+
+bool initGlyphAtlas(SDL_Renderer* renderer, TTF_Font* font);
+void destroyGlyphAtlas();
+
+// Sann hvis atlaset er bygd og har glyfer for hvert tegn i teksten i stilen som tegnes
+bool glyphAtlasCovers(const std::string& text, bool bold);
+
+// Legger teksten i batchen; tegnes først ved flushTextBatch()
+void queueAtlasText(const std::string& text, int x, int y, SDL_Color color, bool bold, int wrapLength = 0);
+
+// Måler teksten uten å rasterisere. Returnerer false hvis atlaset ikke dekker teksten.
+bool measureAtlasText(const std::string& text, bool bold, int wrapLength, int* width, int* height);
+
+// Tegner all tekst som er lagt i batchen siden forrige flush. Gjør ingenting når batchen er tom.
+void flushTextBatch(SDL_Renderer* renderer);
@@ -0,0 +1,648 @@
+#include "golden_image.h"
+#include "gpt.h"
+#include "nix_build.h"
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <linux/btrfs.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <zstd.h>
+
+namespace {
+
+const char* MANIFEST_NAME = "manifest";
+const int MANIFEST_VERSION = 1;
+const unsigned MAX_IMAGE_THREADS = 16;
+
+unsigned imageThreadCount() {
+    return std::max(1u, std::min(std::thread::hardware_concurrency(), MAX_IMAGE_THREADS));
+}
+
+// FNV-1a over 64-biters ord; rask nok til at den ikke begrenser avspillingen
+uint64_t chunkChecksum(const unsigned char* data, size_t length) {
+    const uint64_t prime = 1099511628211ull;
+    uint64_t hash = 14695981039346656037ull;
+    size_t words = length / 8;
+    for (size_t i = 0; i < words; i++) {
+        uint64_t word;
+        memcpy(&word, data + i * 8, 8);
+        hash = (hash ^ word) * prime;
+    }
+    for (size_t i = words * 8; i < length; i++) {
+        hash = (hash ^ data[i]) * prime;
+    }
+    return hash;
+}
+
+bool isZero(const unsigned char* data, size_t length) {
+    uint64_t bits = 0;
+    size_t words = length / 8;
+    for (size_t i = 0; i < words; i++) {
+        uint64_t word;
+        memcpy(&word, data + i * 8, 8);
+        bits |= word;
+    }
+    for (size_t i = words * 8; i < length; i++) {
+        bits |= data[i];
+    }
+    return bits == 0;
+}
+
+bool readFully(int fd, unsigned char* buffer, size_t length, uint64_t offset) {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t count = pread(fd, buffer + done, length - done, offset + done);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        done += count;
+    }
+    return true;
+}
+
+bool writeFully(int fd, const unsigned char* buffer, size_t length, uint64_t offset) {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t count = pwrite(fd, buffer + done, length - done, offset + done);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        done += count;
+    }
+    return true;
+}
+
+// Hull i en image-fil trenger ikke leses; SEEK_DATA finner neste område med data
+bool rangeIsHole(int fd, bool isBlockDevice, uint64_t offset, uint64_t length) {
+    if (isBlockDevice) {
+        return false;
+    }
+    off_t data = lseek(fd, offset, SEEK_DATA);
+    if (data < 0) {
+        return errno == ENXIO; // Bare hull etter offset
+    }
+    return static_cast<uint64_t>(data) >= offset + length;
+}
+
+// Nuller et område uten å sende nullene gjennom page cache når enheten eller filsystemet kan det
+bool zeroRange(int fd, bool isBlockDevice, uint64_t offset, uint64_t length) {
+    if (isBlockDevice) {
+        uint64_t range[2] = { offset, length };
+        if (ioctl(fd, BLKZEROOUT, range) == 0) {
+            return true;
+        }
+    } else if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, length) == 0) {
+        return true;
+    }
+    static const std::vector<unsigned char> zeros(GOLDEN_IMAGE_CHUNK_SIZE, 0);
+    for (uint64_t done = 0; done < length;) {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(zeros.size(), length - done));
+        if (!writeFully(fd, zeros.data(), count, offset + done)) {
+            return false;
+        }
+        done += count;
+    }
+    return true;
+}
+
+// Første feil fra arbeidstrådene; de andre stopper ved neste bit
+struct SharedError {
+    std::mutex mutex;
+    std::atomic<bool> failed{ false };
+    std::string message;
+
+    void set(const std::string& text) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!failed.exchange(true)) {
+            message = text;
+        }
+    }
+};
+
+unsigned char* allocateAligned(size_t size) {
+    void* memory = nullptr;
+    if (posix_memalign(&memory, 4096, size) != 0) {
+        return nullptr;
+    }
+    return static_cast<unsigned char*>(memory);
+}
+
+bool capturePartition(const ImagePartition& partition, const std::string& imageDir, uint64_t& sizeBytes,
+                      std::vector<ImageChunk>& chunks, const ImageLog& log) {
+    auto start = std::chrono::steady_clock::now();
+    int fd = open(partition.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        log("Cannot open " + partition.path + ": " + strerror(errno));
+        return false;
+    }
+    bool isBlockDevice = false;
+    if (!deviceSize(fd, isBlockDevice, sizeBytes)) {
+        log("Cannot read size of " + partition.path + ": " + strerror(errno));
+        close(fd);
+        return false;
+    }
+    std::string dataPath = imageDir + "/" + partition.name + ".zst";
+    int dataFd = open(dataPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (dataFd < 0) {
+        log("Cannot create " + dataPath + ": " + strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    uint64_t chunkCount = (sizeBytes + GOLDEN_IMAGE_CHUNK_SIZE - 1) / GOLDEN_IMAGE_CHUNK_SIZE;
+    std::atomic<uint64_t> nextChunk{ 0 };
+    std::mutex dataMutex;
+    uint64_t dataEnd = 0;
+    SharedError error;
+
+    auto worker = [&]() {
+        unsigned char* buffer = allocateAligned(GOLDEN_IMAGE_CHUNK_SIZE);
+        std::vector<unsigned char> compressed(ZSTD_compressBound(GOLDEN_IMAGE_CHUNK_SIZE));
+        ZSTD_CCtx* context = ZSTD_createCCtx();
+        if (buffer == nullptr || context == nullptr) {
+            error.set("Out of memory");
+        }
+        std::vector<ImageChunk> local;
+        while (!error.failed.load()) {
+            uint64_t index = nextChunk.fetch_add(1);
+            if (index >= chunkCount) {
+                break;
+            }
+            uint64_t offset = index * GOLDEN_IMAGE_CHUNK_SIZE;
+            uint32_t length = static_cast<uint32_t>(std::min<uint64_t>(GOLDEN_IMAGE_CHUNK_SIZE, sizeBytes - offset));
+            if (rangeIsHole(fd, isBlockDevice, offset, length)) {
+                continue;
+            }
+            if (!readFully(fd, buffer, length, offset)) {
+                error.set("Read from " + partition.path + " failed: " + strerror(errno));
+                break;
+            }
+            if (isZero(buffer, length)) {
+                continue;
+            }
+            size_t size = ZSTD_compressCCtx(context, compressed.data(), compressed.size(), buffer, length, GOLDEN_IMAGE_ZSTD_LEVEL);
+            if (ZSTD_isError(size)) {
+                error.set(std::string("zstd: ") + ZSTD_getErrorName(size));
+                break;
+            }
+            uint64_t dataOffset;
+            {
+                std::lock_guard<std::mutex> lock(dataMutex);
+                dataOffset = dataEnd;
+                dataEnd += size;
+            }
+            if (!writeFully(dataFd, compressed.data(), size, dataOffset)) {
+                error.set("Write to " + dataPath + " failed: " + strerror(errno));
+                break;
+            }
+            local.push_back({ partition.name, offset, length, dataOffset, static_cast<uint32_t>(size), chunkChecksum(buffer, length) });
+        }
+        ZSTD_freeCCtx(context);
+        free(buffer);
+        std::lock_guard<std::mutex> lock(dataMutex);
+        chunks.insert(chunks.end(), local.begin(), local.end());
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < imageThreadCount(); i++) {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    bool ok = !error.failed.load() && fsync(dataFd) == 0;
+    close(dataFd);
+    close(fd);
+    if (!ok) {
+        log(error.message.empty() ? "fsync " + dataPath + " failed: " + strerror(errno) : error.message);
+        return false;
+    }
+
+    uint64_t stored = 0;
+    for (const auto& chunk : chunks) {
+        if (chunk.partition == partition.name) {
+            stored += chunk.length;
+        }
+    }
+    log("Captured " + partition.name + ": " + mebibytes(sizeBytes) + ", " + mebibytes(stored) + " with data, " +
+        mebibytes(dataEnd) + " compressed in " + std::to_string(static_cast<int>(secondsSince(start) + 0.5)) + " s");
+    return true;
+}
+
+bool writeImageManifest(const std::string& imageDir, const ImageManifest& manifest) {
+    std::string path = imageDir + "/" + MANIFEST_NAME;
+    std::ofstream out(path + ".tmp");
+    out << "nixum-image " << MANIFEST_VERSION << "\n"
+        << "chunk-size " << manifest.chunkSize << "\n";
+    for (const auto& [name, size] : manifest.partitions) {
+        out << "partition " << name << " " << size << "\n";
+    }
+    char checksum[17];
+    for (const auto& chunk : manifest.chunks) {
+        snprintf(checksum, sizeof(checksum), "%016" PRIx64, chunk.checksum);
+        out << "chunk " << chunk.partition << " " << chunk.offset << " " << chunk.length << " "
+            << chunk.dataOffset << " " << chunk.compressedLength << " " << checksum << "\n";
+    }
+    out.close();
+    // Manifestet skrives sist og atomisk: et image uten manifest er ufullstendig
+    return out && rename((path + ".tmp").c_str(), path.c_str()) == 0;
+}
+
+struct ReplayJob {
+    size_t target;           // Indeks i partisjonslisten
+    const ImageChunk* chunk; // nullptr for et område som skal nulles
+    uint64_t offset;
+    uint64_t length;
+};
+
+struct ReplayTarget {
+    std::string name;
+    std::string path;
+    int dataFd = -1;
+    int directFd = -1;   // O_DIRECT når mulig
+    int bufferedFd = -1; // For biter som ikke er justert, f.eks. siste bit
+    bool isBlockDevice = false;
+    std::atomic<uint64_t> written{ 0 };
+    std::atomic<uint64_t> zeroed{ 0 };
+};
+
+// Escaping for en Nix-streng i "..."
+std::string nixString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\' || c == '$') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+// 128 tilfeldige biter som 32 heksadesimale sifre, formatet i /etc/machine-id
+std::string newMachineId() {
+    unsigned char bytes[16] = {};
+    int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    bool ok = fd >= 0 && readFully(fd, bytes, sizeof(bytes), 0);
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (!ok) {
+        return "";
+    }
+    char text[33];
+    for (size_t i = 0; i < sizeof(bytes); i++) {
+        snprintf(text + i * 2, 3, "%02x", bytes[i]);
+    }
+    return text;
+}
+
+} // namespace
+
+std::vector<ImagePartition> nixumImagePartitions(const std::string& disk) {
+    return { { "NIXBOOT", partitionDevicePath(disk, 1) }, { "NIXROOT", partitionDevicePath(disk, 2) } };
+}
+
+bool captureGoldenImage(const std::vector<ImagePartition>& partitions, const std::string& imageDir, const ImageLog& log) {
+    auto start = std::chrono::steady_clock::now();
+    std::error_code ec;
+    std::filesystem::create_directories(imageDir, ec);
+    if (ec) {
+        log("Cannot create " + imageDir + ": " + ec.message());
+        return false;
+    }
+    std::filesystem::remove(imageDir + "/" + MANIFEST_NAME, ec);
+
+    ImageManifest manifest;
+    for (const auto& partition : partitions) {
+        uint64_t sizeBytes = 0;
+        std::vector<ImageChunk> chunks;
+        if (!capturePartition(partition, imageDir, sizeBytes, chunks, log)) {
+            return false;
+        }
+        std::sort(chunks.begin(), chunks.end(), [](const ImageChunk& a, const ImageChunk& b) { return a.offset < b.offset; });
+        manifest.partitions.push_back({ partition.name, sizeBytes });
+        manifest.chunks.insert(manifest.chunks.end(), chunks.begin(), chunks.end());
+    }
+    if (!writeImageManifest(imageDir, manifest)) {
+        log("Cannot write manifest in " + imageDir);
+        return false;
+    }
+    log("Image written to " + imageDir + " in " + std::to_string(static_cast<int>(secondsSince(start) + 0.5)) + " s");
+    return true;
+}
+
+bool assignNewFilesystemId(const std::string& rootPartition, const ImageLog& log) {
+    if (!captureLines("btrfstune -f -m " + shellQuote(rootPartition), log, true)) {
+        log("btrfstune -m " + rootPartition + " failed");
+        return false;
+    }
+    log("Assigned a new filesystem ID to " + rootPartition);
+    return true;
+}
+
+bool readImageManifest(const std::string& imageDir, ImageManifest& manifest, std::string& error) {
+    std::ifstream in(imageDir + "/" + MANIFEST_NAME);
+    if (!in) {
+        error = "No manifest in " + imageDir + " (incomplete or missing image)";
+        return false;
+    }
+    manifest = ImageManifest();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        std::istringstream fields(line);
+        std::string kind;
+        fields >> kind;
+        bool ok = true;
+        if (kind == "nixum-image") {
+            int version = 0;
+            ok = static_cast<bool>(fields >> version) && version == MANIFEST_VERSION;
+        } else if (kind == "chunk-size") {
+            ok = static_cast<bool>(fields >> manifest.chunkSize) && manifest.chunkSize > 0;
+        } else if (kind == "partition") {
+            std::string name;
+            uint64_t size = 0;
+            ok = static_cast<bool>(fields >> name >> size);
+            manifest.partitions.push_back({ name, size });
+        } else if (kind == "chunk") {
+            ImageChunk chunk;
+            std::string checksum;
+            ok = static_cast<bool>(fields >> chunk.partition >> chunk.offset >> chunk.length >> chunk.dataOffset >> chunk.compressedLength >> checksum);
+            chunk.checksum = ok ? strtoull(checksum.c_str(), nullptr, 16) : 0;
+            ok = ok && chunk.length <= manifest.chunkSize;
+            manifest.chunks.push_back(chunk);
+        } else if (!kind.empty()) {
+            ok = false;
+        }
+        if (!ok) {
+            error = "manifest:" + std::to_string(lineNumber) + ": cannot parse \"" + line + "\"";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool replayGoldenImage(const std::string& imageDir, const std::vector<ImagePartition>& partitions, bool targetZeroed,
+                       const ImageLog& log) {
+    auto start = std::chrono::steady_clock::now();
+    ImageManifest manifest;
+    std::string manifestError;
+    if (!readImageManifest(imageDir, manifest, manifestError)) {
+        log(manifestError);
+        return false;
+    }
+
+    std::vector<ReplayTarget> targets(manifest.partitions.size());
+    std::vector<ReplayJob> jobs;
+    bool ok = true;
+    for (size_t i = 0; i < manifest.partitions.size() && ok; i++) {
+        const auto& [name, sizeBytes] = manifest.partitions[i];
+        ReplayTarget& target = targets[i];
+        target.name = name;
+        auto found = std::find_if(partitions.begin(), partitions.end(), [&name](const ImagePartition& p) { return p.name == name; });
+        if (found == partitions.end()) {
+            log("No target for image partition " + name);
+            ok = false;
+            break;
+        }
+        target.path = found->path;
+        std::string dataPath = imageDir + "/" + name + ".zst";
+        target.dataFd = open(dataPath.c_str(), O_RDONLY | O_CLOEXEC);
+        target.bufferedFd = open(target.path.c_str(), O_WRONLY | O_CLOEXEC);
+        target.directFd = open(target.path.c_str(), O_WRONLY | O_DIRECT | O_CLOEXEC);
+        if (target.directFd < 0) {
+            target.directFd = target.bufferedFd; // tmpfs og enkelte filsystemer støtter ikke O_DIRECT
+        }
+        uint64_t targetSize = 0;
+        if (target.dataFd < 0 || target.bufferedFd < 0 || !deviceSize(target.bufferedFd, target.isBlockDevice, targetSize)) {
+            log("Cannot open " + (target.dataFd < 0 ? dataPath : target.path) + ": " + strerror(errno));
+            ok = false;
+            break;
+        }
+        if (targetSize < sizeBytes) {
+            // En image-fil kan vokse; en partisjon kan ikke
+            if (target.isBlockDevice || ftruncate(target.bufferedFd, sizeBytes) != 0) {
+                log(target.path + " is " + mebibytes(targetSize) + ", the image needs " + mebibytes(sizeBytes));
+                ok = false;
+                break;
+            }
+        }
+
+        // Bitene med data, og hullene mellom dem som nulles hvis målet ikke allerede er nullet
+        uint64_t position = 0;
+        for (const auto& chunk : manifest.chunks) {
+            if (chunk.partition != name) {
+                continue;
+            }
+            if (chunk.offset < position || chunk.offset + chunk.length > sizeBytes) {
+                log("Image chunk outside " + name + " at offset " + std::to_string(chunk.offset));
+                ok = false;
+                break;
+            }
+            if (chunk.offset > position && !targetZeroed) {
+                jobs.push_back({ i, nullptr, position, chunk.offset - position });
+            }
+            jobs.push_back({ i, &chunk, chunk.offset, chunk.length });
+            position = chunk.offset + chunk.length;
+        }
+        if (ok && position < sizeBytes && !targetZeroed) {
+            jobs.push_back({ i, nullptr, position, sizeBytes - position });
+        }
+    }
+
+    SharedError error;
+    std::atomic<size_t> nextJob{ 0 };
+    std::atomic<size_t> jobsDone{ 0 };
+    std::mutex logMutex;
+    auto worker = [&]() {
+        unsigned char* buffer = allocateAligned(manifest.chunkSize);
+        std::vector<unsigned char> compressed;
+        ZSTD_DCtx* context = ZSTD_createDCtx();
+        if (buffer == nullptr || context == nullptr) {
+            error.set("Out of memory");
+        }
+        while (!error.failed.load()) {
+            size_t index = nextJob.fetch_add(1);
+            if (index >= jobs.size()) {
+                break;
+            }
+            const ReplayJob& job = jobs[index];
+            ReplayTarget& target = targets[job.target];
+            if (job.chunk == nullptr) {
+                if (!zeroRange(target.bufferedFd, target.isBlockDevice, job.offset, job.length)) {
+                    error.set("Zeroing " + target.path + " failed: " + strerror(errno));
+                    break;
+                }
+                target.zeroed += job.length;
+            } else {
+                const ImageChunk& chunk = *job.chunk;
+                compressed.resize(chunk.compressedLength);
+                if (!readFully(target.dataFd, compressed.data(), chunk.compressedLength, chunk.dataOffset)) {
+                    error.set("Read from " + imageDir + "/" + target.name + ".zst failed");
+                    break;
+                }
+                size_t size = ZSTD_decompressDCtx(context, buffer, manifest.chunkSize, compressed.data(), chunk.compressedLength);
+                if (ZSTD_isError(size) || size != chunk.length || chunkChecksum(buffer, size) != chunk.checksum) {
+                    error.set("Corrupt image chunk in " + target.name + " at offset " + std::to_string(chunk.offset));
+                    break;
+                }
+                // Hele justerte biter går utenom page cache; en kort siste bit skrives bufret
+                bool aligned = chunk.length % 4096 == 0 && chunk.offset % 4096 == 0;
+                if (!writeFully(aligned ? target.directFd : target.bufferedFd, buffer, chunk.length, chunk.offset) &&
+                    !(aligned && errno == EINVAL && writeFully(target.bufferedFd, buffer, chunk.length, chunk.offset))) {
+                    error.set("Write to " + target.path + " failed: " + strerror(errno));
+                    break;
+                }
+                target.written += chunk.length;
+            }
+            size_t done = ++jobsDone;
+            if (done % 256 == 0) {
+                std::lock_guard<std::mutex> lock(logMutex);
+                log("Replayed " + std::to_string(done * 100 / jobs.size()) + "%");
+            }
+        }
+        ZSTD_freeDCtx(context);
+        free(buffer);
+    };
+
+    if (ok) {
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < imageThreadCount(); i++) {
+            threads.emplace_back(worker);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        ok = !error.failed.load();
+        if (!ok) {
+            log(error.message);
+        }
+    }
+
+    uint64_t totalWritten = 0;
+    for (auto& target : targets) {
+        if (ok && target.bufferedFd >= 0 && fsync(target.bufferedFd) != 0) {
+            log("fsync " + target.path + " failed: " + strerror(errno));
+            ok = false;
+        }
+        if (ok) {
+            log("Replayed " + target.name + " to " + target.path + ": " + mebibytes(target.written) + " written, " +
+                mebibytes(target.zeroed) + " zeroed");
+        }
+        totalWritten += target.written;
+        if (target.directFd >= 0 && target.directFd != target.bufferedFd) {
+            close(target.directFd);
+        }
+        for (int fd : { target.bufferedFd, target.dataFd }) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+    if (ok) {
+        double seconds = secondsSince(start);
+        char summary[96];
+        snprintf(summary, sizeof(summary), "Image replayed in %.1f s (%.0f MiB/s written)", seconds,
+                 totalWritten / (1024.0 * 1024.0) / std::max(seconds, 1e-3));
+        log(summary);
+    }
+    return ok;
+}
+
+bool personalizeReplayedSystem(const std::string& targetRoot, const MachineFields& fields, const ImageLog& log) {
+    // Målpartisjonen kan være større enn den avbildede; btrfs utvides til hele
+    int rootFd = open(targetRoot.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd < 0) {
+        log("Cannot open " + targetRoot + ": " + strerror(errno));
+        return false;
+    }
+    btrfs_ioctl_vol_args args = {};
+    strncpy(args.name, "max", BTRFS_PATH_NAME_MAX);
+    if (ioctl(rootFd, BTRFS_IOC_RESIZE, &args) != 0) {
+        log(std::string("Resizing btrfs to the partition failed: ") + strerror(errno));
+    } else {
+        log("Resized btrfs on " + targetRoot + " to fill the partition");
+    }
+    close(rootFd);
+
+    std::string configDir = targetRoot + TARGET_FLAKE_DIR;
+    if (!std::filesystem::exists(configDir + "/flake.nix")) {
+        log("No " + configDir + "/flake.nix in the image; capture it again from an install made by this version");
+        return false;
+    }
+
+    // Alle maskiner fra samme image ville ellers delt machine-id (journald, DHCP-klient-ID og dbus)
+    std::string machineId = newMachineId();
+    std::ofstream idFile(targetRoot + "/etc/machine-id");
+    idFile << machineId << "\n";
+    idFile.close();
+    if (machineId.empty() || !idFile) {
+        log("Cannot write " + targetRoot + "/etc/machine-id");
+        return false;
+    }
+
+    // UUID-ene er nye etter btrfstune, og maskinvaren kan være en annen enn den imaget ble laget på
+    if (!captureLines("nixos-generate-config --root " + shellQuote(targetRoot), log, true)) {
+        log("nixos-generate-config failed");
+        return false;
+    }
+
+    std::ofstream out(configDir + "/machine.nix");
+    out << "# Written by nixum_install when this machine was installed from a golden image\n"
+        << "{ lib, ... }:\n"
+        << "{\n"
+        << "  networking.hostName = lib.mkForce " << nixString(fields.hostname) << ";\n";
+    if (!fields.username.empty()) {
+        out << "  users.users." << nixString(fields.username) << " = {\n"
+            << "    isNormalUser = true;\n";
+        if (!fields.sshKey.empty()) {
+            out << "    openssh.authorizedKeys.keys = [ " << nixString(fields.sshKey) << " ];\n";
+        }
+        out << "  };\n";
+    }
+    out << "}\n";
+    out.close();
+    if (!out) {
+        log("Cannot write " + configDir + "/machine.nix");
+        return false;
+    }
+    log("Wrote machine settings for " + fields.hostname + " to " + configDir + "/machine.nix");
+
+    if (!checkTargetFilesystems(targetRoot, log)) {
+        return false;
+    }
+
+    // Bygger den nye generasjonen i målets store og gjør den til oppstartsvalget
+    std::string flake = targetFlakeReference(targetRoot) + "#" + TARGET_FLAKE_CONFIGURATION;
+    if (!captureLines("nixos-install --root " + shellQuote(targetRoot) + " --flake " + shellQuote(flake) +
+                      " --no-root-passwd --no-channel-copy", log, true)) {
+        log("nixos-install from " + flake + " failed");
+        return false;
+    }
+    log("Installed the personalized system for " + fields.hostname);
+    return true;
+}
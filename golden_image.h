@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Gyllent image: en ferdig installert disk tas vare på og spilles av på nye disker i stedet for å
+// partisjonere, formatere og bygge på nytt. Hver partisjon (NIXBOOT og NIXROOT) lagres blokkvis i
+// biter på GOLDEN_IMAGE_CHUNK_SIZE. Biter som bare inneholder nuller (og hull i image-filer) lagres
+// ikke; resten komprimeres hver for seg som uavhengige zstd-rammer, slik at avspillingen kan
+// pakke dem ut på alle kjerner og skrive dem med store, justerte skrivinger. Katalogen inneholder:
+//
+//   manifest       tekst, én linje per partisjon og per lagret bit (med sjekksum)
+//   NIXBOOT.zst    komprimerte biter etter hverandre, i den rekkefølgen de ble ferdige
+//   NIXROOT.zst
+//
+// Alt fungerer like godt på image-filer som på blokkenheter.
+
+const uint32_t GOLDEN_IMAGE_CHUNK_SIZE = 4 * 1024 * 1024;
+const int GOLDEN_IMAGE_ZSTD_LEVEL = 3;
+
+struct ImagePartition {
+    std::string name; // "NIXBOOT" eller "NIXROOT"
+    std::string path; // Partisjonsnoden eller en image-fil
+};
+
+struct ImageChunk {
+    std::string partition;
+    uint64_t offset;         // I partisjonen
+    uint32_t length;
+    uint64_t dataOffset;     // I <partisjon>.zst
+    uint32_t compressedLength;
+    uint64_t checksum;       // Over de ukomprimerte bytene
+};
+
+struct ImageManifest {
+    uint32_t chunkSize = GOLDEN_IMAGE_CHUNK_SIZE;
+    std::vector<std::pair<std::string, uint64_t>> partitions; // Navn og størrelse i bytes
+    std::vector<ImageChunk> chunks;
+};
+
+using ImageLog = std::function<void(const std::string&)>;
+
+// NIXBOOT og NIXROOT på disken
+std::vector<ImagePartition> nixumImagePartitions(const std::string& disk);
+
+// Leser partisjonene og skriver imaget til imageDir (som opprettes). Partisjonene bør ikke være montert.
+bool captureGoldenImage(const std::vector<ImagePartition>& partitions, const std::string& imageDir, const ImageLog& log);
+
+// Skriver imaget til partisjonene. Målet må være minst like stort som den lagrede partisjonen;
+// områdene som ikke ble lagret nulles (BLKZEROOUT på enheter, hull i filer). Med targetZeroed
+// hoppes de over, f.eks. når disken nettopp er tømt med BLKZEROOUT.
+bool replayGoldenImage(const std::string& imageDir, const std::vector<ImagePartition>& partitions, bool targetZeroed,
+                       const ImageLog& log);
+
+// Gir btrfs på en avspilt NIXROOT en egen fsid med btrfstune -m (bare superblokkene skrives om).
+// Ellers har alle disker spilt av fra samme image samme fsid, og kjernen kan ikke montere dem
+// samtidig. Partisjonen må ikke være montert.
+bool assignNewFilesystemId(const std::string& rootPartition, const ImageLog& log);
+
+bool readImageManifest(const std::string& imageDir, ImageManifest& manifest, std::string& error);
+
+// Etter avspilling og montering: utvider btrfs til hele partisjonen, gir maskinen en ny machine-id,
+// lager hardware-configuration.nix på nytt for denne disken og skriver /etc/nixos/machine.nix med
+// vertsnavn, bruker og SSH-nøkkel. Flaken buildAndInstallSystem skrev i imaget tar med machine.nix,
+// og nixos-install bygger og installerer systemet med den, uten nett, siden alt annet ligger i storen.
+struct MachineFields {
+    std::string hostname;
+    std::string username;
+    std::string sshKey;
+};
+bool personalizeReplayedSystem(const std::string& targetRoot, const MachineFields& fields, const ImageLog& log);
@@ -0,0 +1,361 @@
+#include "gpt.h"
+#include "util.h"
+
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include <fcntl.h>
+#include <linux/blkpg.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char* ESP_TYPE_GUID = "C12A7328-F81F-11D2-BA4B-00A0C93EC93B";
+const char* LINUX_FILESYSTEM_TYPE_GUID = "0FC63DAF-8483-4772-8E79-3D69E8477DE4";
+const uint64_t MIB = 1024 * 1024;
+
+uint32_t crc32(const uint8_t* data, size_t size) {
+    static uint32_t table[256];
+    static bool initialized = false;
+    if (!initialized) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        initialized = true;
+    }
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void putLe16(uint8_t* out, uint16_t value) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+void putLe32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+void putLe64(uint8_t* out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out[i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+// GUID-tekst til GPT-rekkefølge: de tre første feltene er little-endian
+void parseGuid(const char* text, uint8_t out[16]) {
+    uint8_t bytes[16];
+    int n = 0;
+    for (const char* p = text; *p != '\0' && n < 16; ++p) {
+        if (*p == '-') {
+            continue;
+        }
+        char hex[3] = { p[0], p[1], '\0' };
+        bytes[n++] = static_cast<uint8_t>(strtoul(hex, nullptr, 16));
+        ++p;
+    }
+    const int order[16] = { 3, 2, 1, 0, 5, 4, 7, 6, 8, 9, 10, 11, 12, 13, 14, 15 };
+    for (int i = 0; i < 16; ++i) {
+        out[i] = bytes[order[i]];
+    }
+}
+
+void randomGuid(uint8_t out[16]) {
+    if (getrandom(out, 16, 0) != 16) {
+        for (int i = 0; i < 16; ++i) {
+            out[i] = static_cast<uint8_t>(rand());
+        }
+    }
+    out[7] = (out[7] & 0x0F) | 0x40; // Versjon 4 (little-endian felt)
+    out[8] = (out[8] & 0x3F) | 0x80; // RFC 4122-variant
+}
+
+uint64_t entryArraySectors(uint64_t sectorSize) {
+    return (GPT_ENTRY_COUNT * GPT_ENTRY_SIZE + sectorSize - 1) / sectorSize;
+}
+
+void writeEntries(const GptLayout& layout, uint8_t* out) {
+    for (size_t i = 0; i < layout.partitions.size(); ++i) {
+        const GptPartition& partition = layout.partitions[i];
+        uint8_t* entry = out + i * GPT_ENTRY_SIZE;
+        memcpy(entry, partition.typeGuid, 16);
+        memcpy(entry + 16, partition.uniqueGuid, 16);
+        putLe64(entry + 32, partition.firstLba);
+        putLe64(entry + 40, partition.lastLba);
+        putLe64(entry + 48, partition.attributes);
+        for (size_t c = 0; c < partition.name.size() && c < 36; ++c) {
+            putLe16(entry + 56 + 2 * c, static_cast<uint8_t>(partition.name[c]));
+        }
+    }
+}
+
+void writeHeader(const GptLayout& layout, uint8_t* out, uint64_t currentLba, uint64_t backupLba, uint64_t entriesLba, uint32_t entriesCrc) {
+    uint64_t entrySectors = entryArraySectors(layout.sectorSize);
+    memcpy(out, "EFI PART", 8);
+    putLe32(out + 8, 0x00010000);
+    putLe32(out + 12, 92);
+    putLe64(out + 24, currentLba);
+    putLe64(out + 32, backupLba);
+    putLe64(out + 40, 2 + entrySectors);
+    putLe64(out + 48, layout.totalSectors - 2 - entrySectors);
+    memcpy(out + 56, layout.diskGuid, 16);
+    putLe64(out + 72, entriesLba);
+    putLe32(out + 80, GPT_ENTRY_COUNT);
+    putLe32(out + 84, GPT_ENTRY_SIZE);
+    putLe32(out + 88, entriesCrc);
+    putLe32(out + 16, crc32(out, 92));
+}
+
+void writeProtectiveMbr(const GptLayout& layout, uint8_t* out) {
+    uint8_t* entry = out + 446;
+    entry[1] = 0x00;
+    entry[2] = 0x02;
+    entry[3] = 0x00;
+    entry[4] = 0xEE;
+    entry[5] = entry[6] = entry[7] = 0xFF;
+    putLe32(entry + 8, 1);
+    uint64_t sectors = layout.totalSectors - 1;
+    putLe32(entry + 12, sectors > 0xFFFFFFFFu ? 0xFFFFFFFFu : static_cast<uint32_t>(sectors));
+    out[510] = 0x55;
+    out[511] = 0xAA;
+}
+
+bool deviceGeometry(int fd, bool isBlockDevice, uint64_t& sizeBytes, uint64_t& sectorSize) {
+    if (isBlockDevice) {
+        int logical = 0;
+        if (ioctl(fd, BLKGETSIZE64, &sizeBytes) != 0 || ioctl(fd, BLKSSZGET, &logical) != 0) {
+            return false;
+        }
+        sectorSize = static_cast<uint64_t>(logical);
+        return true;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return false;
+    }
+    sizeBytes = static_cast<uint64_t>(st.st_size);
+    sectorSize = 512;
+    return true;
+}
+
+// Kjernen leser tabellen på nytt; BLKPG per partisjon hvis BLKRRPART ikke går (f.eks. EBUSY)
+void reloadPartitions(int fd, const GptLayout& layout, const GptLog& log) {
+    if (ioctl(fd, BLKRRPART) == 0) {
+        log("Partition table reloaded (BLKRRPART)");
+        return;
+    }
+    log(std::string("BLKRRPART failed (") + strerror(errno) + "), updating partitions with BLKPG");
+    for (int number = 1; number <= GPT_ENTRY_COUNT; ++number) {
+        blkpg_partition part = {};
+        part.pno = number;
+        blkpg_ioctl_arg arg = { BLKPG_DEL_PARTITION, 0, sizeof(part), &part };
+        ioctl(fd, BLKPG, &arg);
+    }
+    for (size_t i = 0; i < layout.partitions.size(); ++i) {
+        const GptPartition& partition = layout.partitions[i];
+        blkpg_partition part = {};
+        part.pno = static_cast<int>(i + 1);
+        part.start = static_cast<long long>(partition.firstLba * layout.sectorSize);
+        part.length = static_cast<long long>((partition.lastLba - partition.firstLba + 1) * layout.sectorSize);
+        strncpy(part.volname, partition.name.c_str(), sizeof(part.volname) - 1);
+        blkpg_ioctl_arg arg = { BLKPG_ADD_PARTITION, 0, sizeof(part), &part };
+        if (ioctl(fd, BLKPG, &arg) != 0) {
+            log("BLKPG add partition " + std::to_string(i + 1) + " failed: " + strerror(errno));
+        }
+    }
+}
+
+// O_DIRECT krever justert offset og lengde, og slutten av en image-fil eller en disk med skjev
+// størrelse er ikke alltid det. Da slås O_DIRECT av på descriptoren og regionen skrives bufret;
+// fdatasync etterpå gjør den like varig.
+bool writeRegion(int fd, const uint8_t* data, uint64_t size, uint64_t offset) {
+    ssize_t written = pwrite(fd, data, size, static_cast<off_t>(offset));
+    if (written < 0 && errno == EINVAL) {
+        int flags = fcntl(fd, F_GETFL);
+        if (flags >= 0 && (flags & O_DIRECT) != 0 && fcntl(fd, F_SETFL, flags & ~O_DIRECT) == 0) {
+            written = pwrite(fd, data, size, static_cast<off_t>(offset));
+        }
+    }
+    return written == static_cast<ssize_t>(size);
+}
+
+} // namespace
+
+bool buildNixumLayout(uint64_t sizeBytes, uint64_t sectorSize, GptLayout& layout, std::string& error) {
+    if (sectorSize < 512 || (sectorSize & (sectorSize - 1)) != 0) {
+        error = "unsupported sector size " + std::to_string(sectorSize);
+        return false;
+    }
+    if (sizeBytes < 1024 * MIB) {
+        error = "disk is smaller than 1 GiB";
+        return false;
+    }
+    layout.sectorSize = sectorSize;
+    layout.totalSectors = sizeBytes / sectorSize;
+    randomGuid(layout.diskGuid);
+    layout.partitions.clear();
+
+    uint64_t lastUsable = layout.totalSectors - 2 - entryArraySectors(sectorSize);
+    GptPartition boot = {};
+    boot.name = "NIXBOOT";
+    parseGuid(ESP_TYPE_GUID, boot.typeGuid);
+    randomGuid(boot.uniqueGuid);
+    boot.firstLba = 1 * MIB / sectorSize;
+    boot.lastLba = 513 * MIB / sectorSize - 1;
+
+    GptPartition root = {};
+    root.name = "NIXROOT";
+    parseGuid(LINUX_FILESYSTEM_TYPE_GUID, root.typeGuid);
+    randomGuid(root.uniqueGuid);
+    root.firstLba = 513 * MIB / sectorSize;
+    root.lastLba = lastUsable;
+
+    layout.partitions.push_back(boot);
+    layout.partitions.push_back(root);
+    return true;
+}
+
+bool writeGptLayout(const std::string& path, const GptLayout& layout, const GptLog& log) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        log("Cannot stat " + path + ": " + strerror(errno));
+        return false;
+    }
+    bool isBlockDevice = S_ISBLK(st.st_mode);
+
+    // O_EXCL på blokkenheter feiler hvis disken er montert eller i bruk
+    int flags = O_RDWR | O_CLOEXEC | (isBlockDevice ? O_EXCL : 0);
+    int fd = open(path.c_str(), flags | O_DIRECT);
+    if (fd < 0 && errno == EINVAL) {
+        fd = open(path.c_str(), flags); // tmpfs og enkelte filsystemer støtter ikke O_DIRECT
+    }
+    if (fd < 0) {
+        log("Cannot open " + path + ": " + strerror(errno));
+        return false;
+    }
+
+    // Starten og slutten av disken skrives som hver sin justerte MiB; det fjerner også
+    // gamle tabeller og signaturer i justeringsgapet foran første partisjon
+    uint64_t sizeBytes = layout.totalSectors * layout.sectorSize;
+    uint64_t regionBytes = GPT_ALIGNMENT_BYTES;
+    void* memory = nullptr;
+    if (posix_memalign(&memory, 4096, 2 * regionBytes) != 0) {
+        log("Out of memory for GPT buffers");
+        close(fd);
+        return false;
+    }
+    uint8_t* head = static_cast<uint8_t*>(memory);
+    uint8_t* tail = head + regionBytes;
+    memset(head, 0, 2 * regionBytes);
+
+    uint64_t ss = layout.sectorSize;
+    uint64_t entrySectors = entryArraySectors(ss);
+    uint64_t lastLba = layout.totalSectors - 1;
+    uint64_t tailOffset = sizeBytes - regionBytes;
+    uint64_t backupEntriesLba = lastLba - entrySectors;
+
+    writeProtectiveMbr(layout, head);
+    writeEntries(layout, head + 2 * ss);
+    uint32_t entriesCrc = crc32(head + 2 * ss, GPT_ENTRY_COUNT * GPT_ENTRY_SIZE);
+    writeHeader(layout, head + ss, 1, lastLba, 2, entriesCrc);
+    memcpy(tail + (backupEntriesLba * ss - tailOffset), head + 2 * ss, GPT_ENTRY_COUNT * GPT_ENTRY_SIZE);
+    writeHeader(layout, tail + (lastLba * ss - tailOffset), lastLba, 1, backupEntriesLba, entriesCrc);
+
+    bool ok = writeRegion(fd, head, regionBytes, 0) && writeRegion(fd, tail, regionBytes, tailOffset) && fdatasync(fd) == 0;
+    if (!ok) {
+        log("Writing GPT to " + path + " failed: " + strerror(errno));
+    } else if (isBlockDevice) {
+        reloadPartitions(fd, layout, log);
+    }
+    free(memory);
+    close(fd);
+    return ok;
+}
+
+bool partitionNixumDisk(const std::string& path, const GptLog& log) {
+    auto start = std::chrono::steady_clock::now();
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        log("Cannot open " + path + ": " + strerror(errno));
+        return false;
+    }
+    struct stat st;
+    uint64_t sizeBytes = 0, sectorSize = 512;
+    bool ok = fstat(fd, &st) == 0 && deviceGeometry(fd, S_ISBLK(st.st_mode), sizeBytes, sectorSize);
+    close(fd);
+    if (!ok) {
+        log("Cannot read size of " + path + ": " + strerror(errno));
+        return false;
+    }
+
+    GptLayout layout;
+    std::string error;
+    if (!buildNixumLayout(sizeBytes, sectorSize, layout, error)) {
+        log("Cannot partition " + path + ": " + error);
+        return false;
+    }
+    if (!writeGptLayout(path, layout, log)) {
+        return false;
+    }
+    log("Partitioned " + path + " (" + std::to_string(sectorSize) + "-byte sectors) in " +
+        std::to_string(static_cast<int>(secondsSince(start) * 1000.0 + 0.5)) + " ms");
+    return true;
+}
+
+std::string partitionDevicePath(const std::string& disk, int number) {
+    bool endsWithDigit = !disk.empty() && isdigit(static_cast<unsigned char>(disk.back()));
+    return disk + (endsWithDigit ? "p" : "") + std::to_string(number);
+}
+
+int benchmarkPartitioning(const std::string& imagePath) {
+    std::string quoted = "\"" + imagePath + "\"";
+    std::string shellPath =
+        "wipefs -af " + quoted + " >/dev/null 2>&1 && "
+        "sgdisk -Zo " + quoted + " >/dev/null 2>&1 && "
+        "parted -s " + quoted + " mklabel gpt && "
+        "parted -s " + quoted + " mkpart NIXBOOT fat32 1MiB 513MiB && "
+        "parted -s " + quoted + " set 1 esp on && "
+        "parted -s " + quoted + " mkpart NIXROOT 513MiB 100%";
+
+    auto start = std::chrono::steady_clock::now();
+    int status = system(shellPath.c_str());
+    double shellSeconds = secondsSince(start);
+    if (status != 0) {
+        std::cerr << "Shell partitioning failed (are wipefs, sgdisk and parted installed?)" << std::endl;
+        shellSeconds = -1.0;
+    }
+
+    start = std::chrono::steady_clock::now();
+    bool ok = partitionNixumDisk(imagePath, [](const std::string& line) { std::cerr << line << std::endl; });
+    double nativeSeconds = secondsSince(start);
+    if (!ok) {
+        return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    if (shellSeconds >= 0) {
+        std::cout << "shell:      " << shellSeconds * 1000.0 << " ms" << std::endl;
+    }
+    std::cout << "in-process: " << nativeSeconds * 1000.0 << " ms" << std::endl;
+    if (shellSeconds >= 0) {
+        std::cout << "saved:      " << (shellSeconds - nativeSeconds) * 1000.0 << " ms" << std::endl;
+    }
+    return 0;
+}
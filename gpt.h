@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// GPT-partisjonering i prosessen: beskyttende MBR, primær og backup GPT-header og
+// partisjonstabellen bygges i minnet og skrives i én omgang med justert direkte I/O,
+// etterfulgt av én BLKRRPART (eller BLKPG) slik at kjernen leser tabellen på nytt.
+// Fungerer på blokkenheter, loop-enheter og vanlige image-filer.
+
+const int GPT_ENTRY_COUNT = 128;
+const int GPT_ENTRY_SIZE = 128;
+const uint64_t GPT_ALIGNMENT_BYTES = 1024 * 1024;
+
+struct GptPartition {
+    std::string name;
+    uint8_t typeGuid[16];
+    uint8_t uniqueGuid[16];
+    uint64_t firstLba;
+    uint64_t lastLba;
+    uint64_t attributes;
+};
+
+struct GptLayout {
+    uint64_t sectorSize;
+    uint64_t totalSectors;
+    uint8_t diskGuid[16];
+    std::vector<GptPartition> partitions;
+};
+
+using GptLog = std::function<void(const std::string&)>;
+
+// NIXBOOT (ESP, 1MiB-513MiB) og NIXROOT (513MiB til slutten), som parted-sekvensen laget
+bool buildNixumLayout(uint64_t sizeBytes, uint64_t sectorSize, GptLayout& layout, std::string& error);
+
+// Skriver layouten til en enhet eller fil og ber kjernen lese partisjonene på nytt
+bool writeGptLayout(const std::string& path, const GptLayout& layout, const GptLog& log);
+
+// Måler størrelse og logisk sektorstørrelse og partisjonerer med NIXBOOT/NIXROOT
+bool partitionNixumDisk(const std::string& path, const GptLog& log);
+
+// Partisjonsnoden for en disk, f.eks. /dev/sda + 1 -> /dev/sda1, /dev/nvme0n1 + 1 -> /dev/nvme0n1p1
+std::string partitionDevicePath(const std::string& disk, int number);
+
+// Kjører den gamle wipefs/sgdisk/parted-sekvensen og motoren på samme image-fil og skriver tidene
+int benchmarkPartitioning(const std::string& imagePath);
@@ -0,0 +1,259 @@
+#include "headless_install.h"
+#include "util.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+namespace {
+
+std::mutex eventMutex;
+std::condition_variable eventReady;
+bool eventPending = false;
+
+std::string trim(const std::string& text) {
+    size_t start = text.find_first_not_of(" \t\r");
+    if (start == std::string::npos) {
+        return "";
+    }
+    return text.substr(start, text.find_last_not_of(" \t\r") - start + 1);
+}
+
+std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (unsigned char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    return out + "\"";
+}
+
+std::string jsonNumber(double value) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.3f", value);
+    return text;
+}
+
+// Én hendelse per linje og flush etter hver, så en leser på seriekonsollet ser den med en gang
+void printJsonLine(const std::string& fields) {
+    std::cout << "{" << fields << "}" << std::endl;
+}
+
+// Leser en strengverdi med TOML-escapes (kun i "..."), og returnerer resten av linjen
+bool parseQuotedValue(const std::string& raw, std::string& value, std::string& rest) {
+    char quote = raw[0];
+    value.clear();
+    for (size_t i = 1; i < raw.size(); i++) {
+        char c = raw[i];
+        if (c == quote) {
+            rest = trim(raw.substr(i + 1));
+            return true;
+        }
+        if (quote == '"' && c == '\\' && i + 1 < raw.size()) {
+            char next = raw[++i];
+            switch (next) {
+                case 'n': value += '\n'; break;
+                case 't': value += '\t'; break;
+                case '"': value += '"'; break;
+                case '\\': value += '\\'; break;
+                default: return false;
+            }
+            continue;
+        }
+        value += c;
+    }
+    return false;
+}
+
+// ["a", "b"] → "a\nb"; bare strenger er tillatt som elementer
+bool parseStringArray(const std::string& raw, std::string& value, std::string& rest) {
+    value.clear();
+    std::string remaining = trim(raw.substr(1));
+    bool first = true;
+    while (true) {
+        if (!remaining.empty() && remaining[0] == ']') {
+            rest = trim(remaining.substr(1));
+            return true;
+        }
+        if (remaining.empty() || (remaining[0] != '"' && remaining[0] != '\'')) {
+            return false;
+        }
+        std::string element;
+        if (!parseQuotedValue(remaining, element, remaining)) {
+            return false;
+        }
+        value += (first ? "" : "\n") + element;
+        first = false;
+        if (!remaining.empty() && remaining[0] == ',') {
+            remaining = trim(remaining.substr(1));
+        } else if (remaining.empty() || remaining[0] != ']') {
+            return false;
+        }
+    }
+}
+
+} // namespace
+
+bool parseAnswerFile(const std::string& path, std::map<std::string, std::string>& answers, std::string& error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "Cannot open " + path;
+        return false;
+    }
+    std::string section;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::string where = path + ":" + std::to_string(lineNumber) + ": ";
+        line = trim(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (line[0] == '[') {
+            size_t end = line.find(']');
+            std::string rest = end == std::string::npos ? "" : trim(line.substr(end + 1));
+            if (end == std::string::npos || (!rest.empty() && rest[0] != '#')) {
+                error = where + "malformed section header";
+                return false;
+            }
+            section = trim(line.substr(1, end - 1));
+            continue;
+        }
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            error = where + "expected key = value";
+            return false;
+        }
+        std::string key = trim(line.substr(0, equals));
+        std::string raw = trim(line.substr(equals + 1));
+        if (key.empty() || raw.empty()) {
+            error = where + "expected key = value";
+            return false;
+        }
+        std::string value;
+        if (raw[0] == '"' || raw[0] == '\'') {
+            std::string rest;
+            if (!parseQuotedValue(raw, value, rest) || (!rest.empty() && rest[0] != '#')) {
+                error = where + "malformed string";
+                return false;
+            }
+        } else if (raw[0] == '[') {
+            std::string rest;
+            if (!parseStringArray(raw, value, rest) || (!rest.empty() && rest[0] != '#')) {
+                error = where + "malformed array";
+                return false;
+            }
+        } else {
+            value = trim(raw.substr(0, raw.find('#')));
+        }
+        std::string fullKey = section.empty() ? key : section + "." + key;
+        if (answers.count(fullKey)) {
+            error = where + "duplicate key " + fullKey;
+            return false;
+        }
+        answers[fullKey] = value;
+    }
+    return true;
+}
+
+int runHeadlessPipeline(std::vector<InstallStep> steps, int maxParallelSteps) {
+    std::vector<std::string> targets;
+    std::map<std::string, int> targetTotal;
+    std::map<std::string, int> targetCompleted;
+    std::string stepList;
+    for (const auto& step : steps) {
+        targets.push_back(step.target);
+        if (!step.target.empty()) {
+            targetTotal[step.target]++;
+        }
+        stepList += (stepList.empty() ? "" : ",") + jsonString(step.name);
+    }
+    auto diskField = [&targets](int step) -> std::string {
+        if (step < 0 || step >= static_cast<int>(targets.size()) || targets[step].empty()) {
+            return "";
+        }
+        return ",\"disk\":" + jsonString(targets[step]);
+    };
+    auto start = std::chrono::steady_clock::now();
+    bool started = startInstallPipeline(std::move(steps), []() {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        eventPending = true;
+        eventReady.notify_one();
+    }, maxParallelSteps);
+    if (!started) {
+        printHeadlessError("Invalid install step graph");
+        return 1;
+    }
+    printJsonLine("\"event\":\"pipeline_started\",\"steps\":[" + stepList + "]");
+
+    bool finished = false;
+    int exitCode = 1;
+    while (!finished) {
+        {
+            std::unique_lock<std::mutex> lock(eventMutex);
+            eventReady.wait(lock, [] { return eventPending; });
+            eventPending = false;
+        }
+        double now = secondsSince(start);
+        PipelineEvent event;
+        while (popPipelineEvent(event)) {
+            std::string step = "\"step\":" + std::to_string(event.step);
+            std::string time = "\"time\":" + jsonNumber(now);
+            switch (event.kind) {
+                case PipelineEventKind::StepStarted:
+                    printJsonLine("\"event\":\"step_started\"," + step + ",\"name\":" + jsonString(event.text) + diskField(event.step) + "," + time);
+                    break;
+                case PipelineEventKind::StepProgress:
+                    printJsonLine("\"event\":\"step_progress\"," + step + diskField(event.step) + ",\"done\":" + std::to_string(event.done) +
+                                  ",\"total\":" + std::to_string(event.total) + "," + time);
+                    break;
+                case PipelineEventKind::StepActivity:
+                    printJsonLine("\"event\":\"step_activity\"," + step + diskField(event.step) + ",\"id\":" + std::to_string(event.done) +
+                                  ",\"text\":" + jsonString(event.text) + "," + time);
+                    break;
+                case PipelineEventKind::StepOutput:
+                    printJsonLine("\"event\":\"step_output\"," + step + ",\"text\":" + jsonString(event.text));
+                    break;
+                case PipelineEventKind::StepFinished:
+                    printJsonLine("\"event\":\"step_finished\"," + step + ",\"name\":" + jsonString(event.text) + diskField(event.step) +
+                                  ",\"status\":" + std::to_string(event.status) + ",\"seconds\":" + jsonNumber(event.seconds) + "," + time);
+                    if (event.status == 0 && !diskField(event.step).empty()) {
+                        const std::string& target = targets[event.step];
+                        printJsonLine("\"event\":\"disk_progress\",\"disk\":" + jsonString(target) + ",\"completed\":" +
+                                      std::to_string(++targetCompleted[target]) + ",\"total\":" + std::to_string(targetTotal[target]) + "," + time);
+                    }
+                    break;
+                case PipelineEventKind::PipelineFinished:
+                    exitCode = event.step < 0 ? 0 : 1;
+                    printJsonLine(std::string("\"event\":\"pipeline_finished\",\"success\":") + (exitCode == 0 ? "true" : "false") +
+                                  ",\"message\":" + jsonString(event.text) + ",\"seconds\":" + jsonNumber(event.seconds));
+                    finished = true;
+                    break;
+            }
+        }
+    }
+    joinInstallPipeline();
+    printInstallStepTimings();
+    return exitCode;
+}
+
+void printHeadlessError(const std::string& message) {
+    printJsonLine("\"event\":\"error\",\"message\":" + jsonString(message));
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "install_pipeline.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Ubetjent installasjon: "nixum_install --answers install.toml --no-gui" leser svarene fra
+// en fil i stedet for fra SDL-sidene og skriver fremdriften som JSON, én linje per hendelse,
+// på stdout. All annen logging går til stderr. Eksempel:
+//
+//   disk = "/dev/nvme0n1"       # eller disks = ["/dev/sdb", "/dev/sdc"] for flere like maskiner
+//   preset = "desktop"          # desktop, htpc eller server
+//   [user]
+//   hostname = "nixum"
+//   username = "ola"
+//   password = "..."
+//   keyboard_layout = "US"
+//   country = "Norway"
+//   [encryption]
+//   enabled = true
+//   key = "..."
+//   [github]
+//   username = "ola"
+//   email = "ola@example.com"
+//   ssh_key = "ssh-ed25519 ..."
+//   [image]                     # valgfritt, se golden_image.h
+//   capture = "/srv/images/desktop"   # lagre disken som gyllent image etter installasjonen
+//   replay = "/srv/images/desktop"    # eller: installer fra imaget i stedet for å bygge
+
+// Et lite TOML-undersett: key = "streng" | 'streng' | true | false | tall | ["streng", ...] på én
+// linje, #-kommentarer og [seksjoner]. Nøkler under en seksjon lagres som "seksjon.nøkkel", og
+// elementene i en liste lagres adskilt med linjeskift.
+bool parseAnswerFile(const std::string& path, std::map<std::string, std::string>& answers, std::string& error);
+
+// Kjører stegene til de er ferdige og returnerer 0 hvis alle lyktes. Steg med target gir
+// "disk"-felt i hendelsene og en "disk_progress"-hendelse når de er ferdige.
+int runHeadlessPipeline(std::vector<InstallStep> steps, int maxParallelSteps = MAX_PARALLEL_STEPS);
+
+// {"event":"error","message":"..."} på stdout, for feil før pipelinen starter
+void printHeadlessError(const std::string& message);
@@ -0,0 +1,220 @@
+#include "input_script.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+std::ofstream recording;
+
+const std::string DEFAULT_SCRIPT = R"(# Velkomstsiden -> Select Drive, velg første disk
+click 900 830
+frames 5
+click 300 230
+# Select preset
+click 900 830
+click 300 225
+# Your info: alle tekstfeltene med kryptering av
+click 900 830
+click 300 290
+type nixum-bench
+click 300 370
+type ola
+click 300 450
+type correct horse battery staple
+click 300 590
+type ola-nordmann
+click 300 670
+type ola@example.com
+click 300 750
+type ssh-ed25519 AAAAC3NzaC1lZDI1NTE5AAAAIBench
+key Backspace
+key Backspace
+key Tab
+type x
+# Kryptering på, skriv nøkkelen (rett under avkrysningsboksen), og av igjen
+click 240 520
+click 300 590
+type encryption passphrase
+click 240 520
+# Nedtrekkslister
+click 300 830
+key Down
+key Down
+key Up
+# Rull ned og opp igjen
+wheel -1
+wheel -1
+wheel -1
+wheel -1
+wheel -1
+wheel -1
+wheel -1
+wheel -1
+wheel -1
+wheel -1
+wheel 1
+wheel 1
+wheel 1
+wheel 1
+wheel 1
+wheel 1
+wheel 1
+wheel 1
+wheel 1
+wheel 1
+frames 10
+# Via menyen: Install, Select Drive, Select preset, Your info
+click 60 380
+frames 10
+click 60 200
+click 60 260
+click 60 320
+frames 10
+)";
+
+InputStep eventStep(const SDL_Event& event) {
+    return { true, event, 0 };
+}
+
+InputStep textStep(const std::string& text) {
+    SDL_Event event = {};
+    event.type = SDL_TEXTINPUT;
+    strncpy(event.text.text, text.c_str(), sizeof(event.text.text) - 1);
+    return eventStep(event);
+}
+
+// Antall byte i UTF-8-tegnet som starter med c
+size_t utf8Length(unsigned char c) {
+    if (c >= 0xF0) return 4;
+    if (c >= 0xE0) return 3;
+    if (c >= 0xC0) return 2;
+    return 1;
+}
+
+} // namespace
+
+bool parseInputScript(const std::string& text, std::vector<InputStep>& steps, std::string& error) {
+    std::istringstream in(text);
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        std::string where = "line " + std::to_string(lineNumber) + ": ";
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        size_t space = line.find(' ');
+        std::string command = line.substr(0, space);
+        std::string argument = space == std::string::npos ? "" : line.substr(space + 1);
+        std::istringstream args(argument);
+        SDL_Event event = {};
+
+        if (command == "click") {
+            event.type = SDL_MOUSEBUTTONDOWN;
+            event.button.button = SDL_BUTTON_LEFT;
+            event.button.clicks = 1;
+            if (!(args >> event.button.x >> event.button.y)) {
+                error = where + "click needs x and y";
+                return false;
+            }
+            steps.push_back(eventStep(event));
+        } else if (command == "type") {
+            for (size_t i = 0; i < argument.size();) {
+                size_t length = utf8Length(argument[i]);
+                steps.push_back(textStep(argument.substr(i, length)));
+                i += length;
+            }
+        } else if (command == "text") {
+            steps.push_back(textStep(argument));
+        } else if (command == "key") {
+            event.type = SDL_KEYDOWN;
+            event.key.state = SDL_PRESSED;
+            if (argument.rfind("ctrl+", 0) == 0) {
+                event.key.keysym.mod = KMOD_LCTRL;
+                argument = argument.substr(5);
+            }
+            event.key.keysym.sym = SDL_GetKeyFromName(argument.c_str());
+            if (event.key.keysym.sym == SDLK_UNKNOWN) {
+                error = where + "unknown key " + argument;
+                return false;
+            }
+            steps.push_back(eventStep(event));
+        } else if (command == "wheel") {
+            event.type = SDL_MOUSEWHEEL;
+            if (!(args >> event.wheel.y)) {
+                error = where + "wheel needs a direction";
+                return false;
+            }
+            steps.push_back(eventStep(event));
+        } else if (command == "frames") {
+            int frames = 0;
+            if (!(args >> frames) || frames < 0) {
+                error = where + "frames needs a count";
+                return false;
+            }
+            steps.push_back({ false, event, frames });
+        } else {
+            error = where + "unknown command " + command;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool loadInputScript(const std::string& path, std::vector<InputStep>& steps, std::string& error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "Cannot open " + path;
+        return false;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return parseInputScript(contents.str(), steps, error);
+}
+
+const std::string& defaultInputScript() {
+    return DEFAULT_SCRIPT;
+}
+
+bool startInputRecording(const std::string& path) {
+    recording.open(path);
+    if (!recording) {
+        std::cerr << "Cannot record input to " << path << std::endl;
+        return false;
+    }
+    recording << "# Recorded by nixum_install, replay with nixum_bench " << path << "\n";
+    return true;
+}
+
+void recordInputEvent(const SDL_Event& event) {
+    if (!recording.is_open()) {
+        return;
+    }
+    switch (event.type) {
+        case SDL_MOUSEBUTTONDOWN:
+            if (event.button.button == SDL_BUTTON_LEFT) {
+                recording << "click " << event.button.x << " " << event.button.y << "\n";
+            }
+            break;
+        case SDL_TEXTINPUT:
+            recording << "text " << event.text.text << "\n";
+            break;
+        case SDL_KEYDOWN:
+            recording << "key " << ((event.key.keysym.mod & KMOD_CTRL) ? "ctrl+" : "") << SDL_GetKeyName(event.key.keysym.sym) << "\n";
+            break;
+        case SDL_MOUSEWHEEL:
+            recording << "wheel " << event.wheel.y << "\n";
+            break;
+        default:
+            break;
+    }
+}
+
+void stopInputRecording() {
+    if (recording.is_open()) {
+        recording.close();
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+
+#include <string>
+#include <vector>
+
+// Innspilt input som tekst, én handling per linje. Spilles av i nixum_bench og tas opp fra
+// nixum_install med NIXUM_RECORD_INPUT=<fil>. Koordinatene er vinduskoordinater.
+//
+//   click 300 290       venstreklikk
+//   type hello          én SDL_TEXTINPUT per tegn
+//   text h              én SDL_TEXTINPUT med hele resten av linjen (slik opptaket skriver det)
+//   key Backspace       SDL_KEYDOWN, navn som i SDL_GetKeyName; "key ctrl+F12" med Ctrl
+//   wheel -1            rulling, negativ er ned
+//   frames 30           tegn 30 frames uten input
+//   # kommentar
+
+struct InputStep {
+    bool hasEvent;
+    SDL_Event event;
+    int idleFrames;
+};
+
+bool parseInputScript(const std::string& text, std::vector<InputStep>& steps, std::string& error);
+bool loadInputScript(const std::string& path, std::vector<InputStep>& steps, std::string& error);
+
+// Skriptet nixum_bench bruker uten argument: klikker gjennom alle sidene, skriver i alle
+// tekstfeltene, slår kryptering av og på og ruller "Your info"
+const std::string& defaultInputScript();
+
+// Opptak; hendelser som ikke kan spilles av (bevegelse, vindushendelser) hoppes over
+bool startInputRecording(const std::string& path);
+void recordInputEvent(const SDL_Event& event);
+void stopInputRecording();
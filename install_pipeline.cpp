@@ -0,0 +1,422 @@
+#include "install_pipeline.h"
+#include "ring_buffer.h"
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t PIPELINE_EVENT_CAPACITY = 1024;
+const char* STEP_PROGRESS_PREFIX = "@progress ";
+const char* STEP_ACTIVITY_PREFIX = "@activity ";
+
+RingBuffer<PipelineEvent, PIPELINE_EVENT_CAPACITY> events;
+std::atomic<bool> wakePending(false);
+std::atomic<bool> consumerDetached(false);
+std::atomic<bool> running(false);
+std::function<void()> notifyConsumer;
+std::thread worker;
+
+std::mutex resultsMutex;
+std::vector<StepResult> results;
+
+void wakeConsumer() {
+    if (!wakePending.exchange(true) && notifyConsumer) {
+        notifyConsumer();
+    }
+}
+
+void pushEvent(PipelineEventKind kind, int step, int status, double seconds, const std::string& text, uint64_t done = 0, uint64_t total = 0) {
+    PipelineEvent event;
+    event.kind = kind;
+    event.step = step;
+    event.status = status;
+    event.seconds = seconds;
+    event.done = done;
+    event.total = total;
+    strncpy(event.text, text.c_str(), PIPELINE_EVENT_TEXT_SIZE - 1);
+    event.text[PIPELINE_EVENT_TEXT_SIZE - 1] = '\0';
+
+    // Full buffer: vent på at UI-et tømmer den, med mindre ingen lenger leser
+    while (!events.push(event)) {
+        if (consumerDetached.load()) {
+            return;
+        }
+        wakeConsumer();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    wakeConsumer();
+}
+
+// Deler opp utdata i linjer; git og andre verktøy bruker \r for fremdriftslinjer
+void emitLines(int step, std::string& pending, const char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] == '\n' || data[i] == '\r') {
+            if (!pending.empty()) {
+                logStepOutput(step, pending);
+                pending.clear();
+            }
+        } else {
+            pending += data[i];
+        }
+    }
+}
+
+// Kahns algoritme; tom liste betyr at grafen har en sykel
+std::vector<int> topologicalOrder(const std::vector<std::vector<int>>& dependencies) {
+    size_t count = dependencies.size();
+    std::vector<int> remaining(count);
+    std::vector<std::vector<int>> dependents(count);
+    for (size_t i = 0; i < count; ++i) {
+        remaining[i] = static_cast<int>(dependencies[i].size());
+        for (int dependency : dependencies[i]) {
+            dependents[dependency].push_back(static_cast<int>(i));
+        }
+    }
+    std::vector<int> order;
+    for (size_t i = 0; i < count; ++i) {
+        if (remaining[i] == 0) {
+            order.push_back(static_cast<int>(i));
+        }
+    }
+    for (size_t next = 0; next < order.size(); ++next) {
+        for (int dependent : dependents[order[next]]) {
+            if (--remaining[dependent] == 0) {
+                order.push_back(dependent);
+            }
+        }
+    }
+    return order.size() == count ? order : std::vector<int>();
+}
+
+void runPipeline(std::vector<InstallStep> steps, std::vector<std::vector<int>> dependencies, int maxParallelSteps) {
+    auto pipelineStart = std::chrono::steady_clock::now();
+    size_t count = steps.size();
+    std::vector<int> remaining(count);
+    std::vector<std::vector<int>> dependents(count);
+    std::deque<int> ready;
+    for (size_t i = 0; i < count; ++i) {
+        remaining[i] = static_cast<int>(dependencies[i].size());
+        for (int dependency : dependencies[i]) {
+            dependents[dependency].push_back(static_cast<int>(i));
+        }
+        if (remaining[i] == 0) {
+            ready.push_back(static_cast<int>(i));
+        }
+    }
+
+    std::mutex schedulerMutex;
+    std::condition_variable stepDone;
+    std::vector<std::thread> stepThreads;
+    int runningSteps = 0;
+    int failedStep = -1;
+    int failedStatus = 0;
+
+    auto runStep = [&](int step) {
+        pushEvent(PipelineEventKind::StepStarted, step, 0, 0.0, steps[step].name);
+        auto start = std::chrono::steady_clock::now();
+        int status = steps[step].run(step);
+        auto end = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+
+        {
+            std::lock_guard<std::mutex> lock(resultsMutex);
+            results[step].exitStatus = status;
+            results[step].startSeconds = std::chrono::duration<double>(start - pipelineStart).count();
+            results[step].seconds = seconds;
+            results[step].ran = true;
+        }
+        pushEvent(PipelineEventKind::StepFinished, step, status, seconds, steps[step].name);
+
+        std::lock_guard<std::mutex> lock(schedulerMutex);
+        --runningSteps;
+        if (status != 0 && failedStep < 0) {
+            failedStep = step;
+            failedStatus = status;
+        }
+        if (status == 0) {
+            for (int dependent : dependents[step]) {
+                if (--remaining[dependent] == 0) {
+                    ready.push_back(dependent);
+                }
+            }
+        }
+        stepDone.notify_one();
+    };
+
+    {
+        std::unique_lock<std::mutex> lock(schedulerMutex);
+        while (true) {
+            while (!ready.empty() && failedStep < 0 && runningSteps < maxParallelSteps) {
+                int step = ready.front();
+                ready.pop_front();
+                ++runningSteps;
+                stepThreads.emplace_back(runStep, step);
+            }
+            if (runningSteps == 0 && (ready.empty() || failedStep >= 0)) {
+                break;
+            }
+            stepDone.wait(lock);
+        }
+    }
+    for (auto& thread : stepThreads) {
+        thread.join();
+    }
+
+    pushEvent(PipelineEventKind::PipelineFinished, failedStep, failedStatus, secondsSince(pipelineStart),
+              failedStep < 0 ? "Install finished" : "Install failed at " + steps[failedStep].name);
+    running.store(false);
+}
+
+} // namespace
+
+bool startInstallPipeline(std::vector<InstallStep> steps, std::function<void()> onEvent, int maxParallelSteps) {
+    if (running.load()) {
+        std::cerr << "Install pipeline is already running" << std::endl;
+        return false;
+    }
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    std::vector<std::vector<int>> dependencies(steps.size());
+    for (size_t i = 0; i < steps.size(); ++i) {
+        for (const auto& name : steps[i].dependsOn) {
+            auto found = std::find_if(steps.begin(), steps.end(), [&name](const InstallStep& step) { return step.name == name; });
+            if (found == steps.end()) {
+                std::cerr << "Install step \"" << steps[i].name << "\" depends on unknown step \"" << name << "\"" << std::endl;
+                return false;
+            }
+            dependencies[i].push_back(static_cast<int>(found - steps.begin()));
+        }
+    }
+    if (topologicalOrder(dependencies).size() != steps.size()) {
+        std::cerr << "Install steps contain a dependency cycle" << std::endl;
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(resultsMutex);
+        results.clear();
+        for (size_t i = 0; i < steps.size(); ++i) {
+            results.push_back({ steps[i].name, dependencies[i], 0, 0.0, 0.0, false, steps[i].target });
+        }
+    }
+    notifyConsumer = std::move(onEvent);
+    consumerDetached.store(false);
+    running.store(true);
+    worker = std::thread(runPipeline, std::move(steps), std::move(dependencies), std::max(1, maxParallelSteps));
+    return true;
+}
+
+bool installPipelineRunning() {
+    return running.load();
+}
+
+void joinInstallPipeline() {
+    consumerDetached.store(true);
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+bool popPipelineEvent(PipelineEvent& event) {
+    wakePending.store(false);
+    return events.pop(event);
+}
+
+int runStepCommand(int step, const std::string& command) {
+    int outPipe[2], errPipe[2];
+    if (pipe2(outPipe, O_CLOEXEC) != 0) {
+        logStepOutput(step, std::string("pipe2 failed: ") + strerror(errno));
+        return -1;
+    }
+    if (pipe2(errPipe, O_CLOEXEC) != 0) {
+        logStepOutput(step, std::string("pipe2 failed: ") + strerror(errno));
+        close(outPipe[0]);
+        close(outPipe[1]);
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(outPipe[1], STDOUT_FILENO);
+        dup2(errPipe[1], STDERR_FILENO);
+        // bash fra PATH; NixOS har ingen /bin/bash
+        execlp("bash", "bash", "-c", command.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    close(outPipe[1]);
+    close(errPipe[1]);
+    if (pid < 0) {
+        logStepOutput(step, std::string("fork failed: ") + strerror(errno));
+        close(outPipe[0]);
+        close(errPipe[0]);
+        return -1;
+    }
+
+    fcntl(outPipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(errPipe[0], F_SETFL, O_NONBLOCK);
+    pollfd fds[2] = { { outPipe[0], POLLIN, 0 }, { errPipe[0], POLLIN, 0 } };
+    std::string pending[2];
+    char buffer[4096];
+    int open = 2;
+    while (open > 0) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for (int i = 0; i < 2; ++i) {
+            if (fds[i].fd < 0 || fds[i].revents == 0) {
+                continue;
+            }
+            ssize_t count = read(fds[i].fd, buffer, sizeof(buffer));
+            if (count > 0) {
+                emitLines(step, pending[i], buffer, count);
+            } else if (count == 0 || (errno != EAGAIN && errno != EINTR)) {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+                --open;
+            }
+        }
+    }
+    for (int i = 0; i < 2; ++i) {
+        if (fds[i].fd >= 0) {
+            close(fds[i].fd);
+        }
+        if (!pending[i].empty()) {
+            logStepOutput(step, pending[i]);
+        }
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    }
+    return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : -1;
+}
+
+void logStepOutput(int step, const std::string& line) {
+    unsigned long long done = 0, total = 0;
+    if (line.compare(0, strlen(STEP_PROGRESS_PREFIX), STEP_PROGRESS_PREFIX) == 0 &&
+        sscanf(line.c_str() + strlen(STEP_PROGRESS_PREFIX), "%llu %llu", &done, &total) == 2) {
+        pushEvent(PipelineEventKind::StepProgress, step, 0, 0.0, "", done, total);
+        return;
+    }
+    unsigned long long id = 0;
+    int textStart = 0;
+    if (line.compare(0, strlen(STEP_ACTIVITY_PREFIX), STEP_ACTIVITY_PREFIX) == 0 &&
+        sscanf(line.c_str() + strlen(STEP_ACTIVITY_PREFIX), "%llu%n", &id, &textStart) == 1) {
+        size_t text = strlen(STEP_ACTIVITY_PREFIX) + textStart;
+        pushEvent(PipelineEventKind::StepActivity, step, 0, 0.0, text < line.size() ? line.substr(text + 1) : "", id);
+        return;
+    }
+    pushEvent(PipelineEventKind::StepOutput, step, 0, 0.0, line);
+}
+
+std::string formatStepProgress(uint64_t done, uint64_t total) {
+    return STEP_PROGRESS_PREFIX + std::to_string(done) + " " + std::to_string(total);
+}
+
+std::string formatStepActivity(uint64_t id, const std::string& text) {
+    return STEP_ACTIVITY_PREFIX + std::to_string(id) + (text.empty() ? "" : " " + text);
+}
+
+std::vector<StepResult> getInstallStepResults() {
+    std::lock_guard<std::mutex> lock(resultsMutex);
+    return results;
+}
+
+int getInstallStepCount() {
+    std::lock_guard<std::mutex> lock(resultsMutex);
+    return static_cast<int>(results.size());
+}
+
+void printInstallStepTimings() {
+    std::vector<StepResult> snapshot = getInstallStepResults();
+    std::vector<std::vector<int>> dependencies;
+    for (const auto& result : snapshot) {
+        dependencies.push_back(result.dependencies);
+    }
+
+    double wallClock = 0.0;
+    double serialTotal = 0.0;
+    std::cerr << "Install step timings:" << std::endl;
+    std::cerr << std::fixed << std::setprecision(2);
+    for (const auto& result : snapshot) {
+        if (!result.ran) {
+            std::cerr << "  " << std::left << std::setw(24) << result.name << " skipped" << std::right << std::endl;
+            continue;
+        }
+        serialTotal += result.seconds;
+        wallClock = std::max(wallClock, result.startSeconds + result.seconds);
+        std::cerr << "  " << std::left << std::setw(24) << result.name << std::right
+                  << " start " << std::setw(7) << result.startSeconds << " s"
+                  << "  took " << std::setw(7) << result.seconds << " s  exit " << result.exitStatus << std::endl;
+    }
+
+    // Kritisk sti: lengste sum av stegtider gjennom avhengighetene
+    std::vector<double> finish(snapshot.size(), 0.0);
+    std::vector<int> previous(snapshot.size(), -1);
+    int last = -1;
+    for (int step : topologicalOrder(dependencies)) {
+        double start = 0.0;
+        for (int dependency : dependencies[step]) {
+            if (finish[dependency] > start) {
+                start = finish[dependency];
+                previous[step] = dependency;
+            }
+        }
+        finish[step] = start + (snapshot[step].ran ? snapshot[step].seconds : 0.0);
+        if (last < 0 || finish[step] > finish[last]) {
+            last = step;
+        }
+    }
+    std::vector<std::string> path;
+    for (int step = last; step >= 0; step = previous[step]) {
+        path.insert(path.begin(), snapshot[step].name);
+    }
+
+    std::cerr << "  wall clock " << wallClock << " s, sum of steps " << serialTotal << " s" << std::endl;
+
+    // Ved flere disker: når den siste av stegene for hver disk var ferdig
+    std::map<std::string, double> targetFinished;
+    for (const auto& result : snapshot) {
+        if (!result.target.empty() && result.ran) {
+            targetFinished[result.target] = std::max(targetFinished[result.target], result.startSeconds + result.seconds);
+        }
+    }
+    if (targetFinished.size() > 1) {
+        for (const auto& [target, finished] : targetFinished) {
+            std::cerr << "  " << std::left << std::setw(24) << target << std::right << " done at " << std::setw(7) << finished << " s" << std::endl;
+        }
+    }
+    if (last >= 0) {
+        std::cerr << "  critical path (" << finish[last] << " s): ";
+        for (size_t i = 0; i < path.size(); ++i) {
+            std::cerr << (i > 0 ? " -> " : "") << path[i];
+        }
+        std::cerr << std::endl;
+    }
+    std::cerr << std::defaultfloat << std::setprecision(6);
+}
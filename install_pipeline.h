@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Installasjonen er en graf av steg med avhengigheter. En liten planlegger i en egen
+// arbeidstråd kjører uavhengige steg samtidig. Utdata fra barneprosesser strømmes gjennom
+// ikke-blokkerende pipes til en låsefri ringbuffer som UI-et tømmer.
+
+const int PIPELINE_EVENT_TEXT_SIZE = 160;
+const int MAX_PARALLEL_STEPS = 4;
+// Øvre grense når flere disker installeres samtidig (se buildMultiDiskInstallSteps)
+const int MAX_MULTI_DISK_PARALLEL_STEPS = 16;
+
+struct InstallStep {
+    std::string name;
+    std::function<int(int step)> run; // Returnerer exit-status, 0 betyr suksess
+    std::vector<std::string> dependsOn; // Navn på steg som må være ferdige først
+    std::string target; // Disken steget jobber mot, tom for felles steg
+};
+
+enum class PipelineEventKind {
+    StepStarted,
+    StepOutput,
+    StepProgress, // done av total, fra formatStepProgress-linjer
+    StepActivity, // Statuslinje done (aktivitets-id) i steget, fra formatStepActivity; tom tekst når den er ferdig
+    StepFinished,
+    PipelineFinished
+};
+
+struct PipelineEvent {
+    PipelineEventKind kind;
+    int step;
+    int status;
+    double seconds;
+    uint64_t done;
+    uint64_t total;
+    char text[PIPELINE_EVENT_TEXT_SIZE];
+};
+
+struct StepResult {
+    std::string name;
+    std::vector<int> dependencies;
+    int exitStatus;
+    double startSeconds; // Relativt til start av pipelinen
+    double seconds;
+    bool ran;
+    std::string target;
+};
+
+// Starter stegene på en arbeidstråd. Et steg starter når alle avhengighetene er ferdige, med
+// høyst maxParallelSteps samtidig; etter første feil startes ingen nye steg. Returnerer false ved
+// ukjente avhengigheter eller sykler. onEvent kalles fra arbeidstråden når nye hendelser ligger
+// klare (én gang til de er hentet).
+bool startInstallPipeline(std::vector<InstallStep> steps, std::function<void()> onEvent, int maxParallelSteps = MAX_PARALLEL_STEPS);
+bool installPipelineRunning();
+void joinInstallPipeline();
+
+// Henter neste hendelse fra ringbufferen. Trygt å kalle fra UI-tråden mens stegene kjører.
+bool popPipelineEvent(PipelineEvent& event);
+
+// Kjører en bash-kommando som barneprosess og strømmer stdout/stderr linje for linje
+int runStepCommand(int step, const std::string& command);
+
+// Skriver en logglinje for steget, for steg som kjører i prosessen. Linjer fra formatStepProgress og
+// formatStepActivity blir StepProgress- og StepActivity-hendelser, også når de kommer fra en
+// hjelpeprosess på stdout.
+void logStepOutput(int step, const std::string& line);
+std::string formatStepProgress(uint64_t done, uint64_t total);
+// Statuslinje for én av flere samtidige aktiviteter i et steg, f.eks. ett bygg; tom tekst fjerner den
+std::string formatStepActivity(uint64_t id, const std::string& text);
+
+std::vector<StepResult> getInstallStepResults();
+int getInstallStepCount();
+// Skriver tid per steg, når hver disk ble ferdig og den kritiske stien (lengste kjede av avhengigheter)
+void printInstallStepTimings();
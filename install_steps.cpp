@@ -0,0 +1,305 @@
+#include "install_steps.h"
+#include "btrfs_layout.h"
+#include "disk_wipe.h"
+#include "golden_image.h"
+#include "gpt.h"
+#include "nix_build.h"
+#include "preset_fetch.h"
+#include "storage_probe.h"
+#include "store_seed.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#include <limits.h>
+#include <unistd.h>
+
+namespace {
+
+// Felles innledning for stegene som jobber mot disken. Partisjonsnodene brukes direkte
+// i stedet for /dev/disk/by-partlabel, så vi slipper å vente på udev.
+std::string diskScript(const std::string& disk, const std::string& root, const std::string& body) {
+    return "set -e\n"
+           "DISK=" + shellQuote(disk) + "\n"
+           "NIXBOOT=" + shellQuote(partitionDevicePath(disk, 1)) + "\n"
+           "NIXROOT=" + shellQuote(partitionDevicePath(disk, 2)) + "\n"
+           "ROOT=" + shellQuote(root) + "\n" + body;
+}
+
+InstallStep diskStep(const std::string& name, std::vector<std::string> dependsOn, const std::string& disk, const std::string& root,
+                     const std::string& body, const std::string& target) {
+    std::string script = diskScript(disk, root, body);
+    return { name, [script](int step) { return runStepCommand(step, script); }, std::move(dependsOn), target };
+}
+
+// Steg som trenger root kjøres i prosessen når vi allerede er root, ellers som
+// "sudo nixum_install --helper ..." slik at utdataene strømmes som for andre kommandoer
+InstallStep privilegedStep(const std::string& name, std::vector<std::string> dependsOn, std::vector<std::string> helperArgs,
+                           const std::string& target) {
+    return { name, [helperArgs](int step) {
+        if (geteuid() == 0) {
+            return runHelper(helperArgs, [step](const std::string& line) { logStepOutput(step, line); });
+        }
+        return runStepCommand(step, "sudo " + helperCommandLine(getExecutablePath(), helperArgs));
+    }, std::move(dependsOn), target };
+}
+
+// Den målte lesehastigheten følger med "wipe", siden hjelpekommandoen ikke har UI-prosessens
+// undersøkelse. Tom når disken ikke er målt. Den avrundede verdien brukes også til plannedDiskWipe
+// her, så planen UI-prosessen regner med er den samme som hjelpekommandoen følger.
+std::string measuredWipeMBps(const std::string& disk) {
+    StorageProbe probe;
+    if (!getStorageProbe(disk, probe) || !probe.benchmarked) {
+        return "";
+    }
+    char mbps[32];
+    snprintf(mbps, sizeof(mbps), "%.0f", probe.sequentialMBps);
+    return mbps;
+}
+
+std::vector<std::string> wipeHelperArgs(const std::string& disk) {
+    std::vector<std::string> args = { "wipe", disk };
+    std::string mbps = measuredWipeMBps(disk);
+    if (!mbps.empty()) {
+        args.push_back(mbps);
+    }
+    return args;
+}
+
+InstallStep fetchPresetStep(const std::string& preset) {
+    PresetFetchOptions fetchOptions = defaultPresetFetchOptions(preset);
+    return { "Fetch preset", [fetchOptions](int step) { return fetchPreset(step, fetchOptions); }, {}, "" };
+}
+
+// Partisjonering, formatering og montering av én disk under root. Med flere disker får
+// stegnavnene disknavnet som suffiks, f.eks. "Format NIXROOT [sdb]", siden navnene må være unike.
+void appendDiskSteps(std::vector<InstallStep>& steps, const std::string& disk, const std::string& root, const std::string& suffix) {
+    std::string target = suffix.empty() ? "" : disk;
+    // Hele disken TRIM-es først, så en gjenbrukt SSD ikke bærer med seg gamle blokker
+    steps.push_back(privilegedStep("Wipe disk" + suffix, {}, wipeHelperArgs(disk), target));
+    steps.push_back(privilegedStep("Partition disk" + suffix, { "Wipe disk" + suffix }, { "partition", disk }, target));
+    steps.push_back(diskStep("Format NIXBOOT" + suffix, { "Partition disk" + suffix }, disk, root,
+        "sudo mkfs.fat -F 32 \"$NIXBOOT\"\n", target));
+    steps.push_back(diskStep("Format NIXROOT" + suffix, { "Partition disk" + suffix }, disk, root,
+        "sudo mkfs.btrfs -f \"$NIXROOT\"\n", target));
+    // Monteringsvalg og zstd-nivå ut fra diskundersøkelsen (ingen "ssd" på roterende disker)
+    std::string btrfsOptions = tunedBtrfsOptionsFor(disk);
+    steps.push_back(privilegedStep("Mount filesystems" + suffix, { "Format NIXROOT" + suffix, "Format NIXBOOT" + suffix },
+                                   { "mount-layout", disk, root, btrfsOptions }, target));
+}
+
+std::string diskSuffix(const std::string& disk) {
+    return " [" + disk.substr(disk.rfind('/') + 1) + "]";
+}
+
+// Fyller målets store fra live-systemet og binærcachen så snart flaken er hentet og disken montert.
+// Cachekatalogen sendes med som argument siden sudo fjerner miljøvariablene.
+InstallStep seedStoreStep(const std::string& preset, const std::string& root, const std::string& suffix, const std::string& target) {
+    std::vector<std::string> args = { "seed-store", root, defaultPresetFetchOptions(preset).checkoutDir, preset };
+    std::string cacheDir = defaultStoreSeedOptions(root).binaryCacheDir;
+    if (!cacheDir.empty()) {
+        args.push_back(cacheDir);
+    }
+    return privilegedStep("Seed Nix store" + suffix, { "Fetch preset", "Mount filesystems" + suffix }, args, target);
+}
+
+// Bygger og installerer systemet når konfigurasjonen og storen er klar. Flaken bygget skriver i
+// målets /etc/nixos importerer hardware-configuration.nix fra steget som fyller katalogen, så
+// systemet får filsystemene og maskinvaren til akkurat denne disken. concurrentBuilds deler
+// CPU-ene og minnet mellom diskene som bygges samtidig.
+InstallStep buildSystemStep(const std::string& preset, const std::string& root, const std::string& configStep, const std::string& suffix,
+                            const std::string& target, size_t concurrentBuilds) {
+    std::vector<std::string> args = { "build-system", root, defaultPresetFetchOptions(preset).checkoutDir, preset,
+                                      std::to_string(concurrentBuilds) };
+    std::string cacheDir = defaultStoreSeedOptions(root).binaryCacheDir;
+    if (!cacheDir.empty()) {
+        args.push_back(cacheDir);
+    }
+    return privilegedStep("Build system" + suffix, { configStep, "Seed Nix store" + suffix }, args, target);
+}
+
+} // namespace
+
+std::string getExecutablePath() {
+    char result[PATH_MAX];
+    ssize_t count = readlink("/proc/self/exe", result, PATH_MAX);
+    if (count != -1) {
+        return std::string(result, count);
+    }
+    return "";
+}
+
+std::string helperCommandLine(const std::string& executable, const std::vector<std::string>& args) {
+    std::string command = shellQuote(executable) + " --helper";
+    for (const auto& arg : args) {
+        command += " " + shellQuote(arg);
+    }
+    return command;
+}
+
+int runHelper(const std::vector<std::string>& args, const std::function<void(const std::string&)>& log) {
+    if ((args.size() == 2 || args.size() == 3) && args[0] == "wipe") {
+        double measuredMBps = args.size() == 3 ? atof(args[2].c_str()) : 0.0;
+        return wipeDisk(args[1], measuredMBps, log, [&log](uint64_t done, uint64_t total) { log(formatStepProgress(done, total)); }) ? 0 : 1;
+    }
+    if (args.size() == 2 && args[0] == "partition") {
+        return partitionNixumDisk(args[1], log) ? 0 : 1;
+    }
+    if ((args.size() == 3 || args.size() == 4) && args[0] == "mount-layout") {
+        auto layout = args.size() == 4 ? nixumFilesystemLayout(args[3]) : nixumFilesystemLayout();
+        return applyFilesystemLayout(layout, partitionDevicePath(args[1], 2),
+                                     partitionDevicePath(args[1], 1), args[2], log) ? 0 : 1;
+    }
+    if (args.size() == 3 && args[0] == "unmount-layout") {
+        return unmountFilesystemLayout(nixumFilesystemLayout(), args[2], log) ? 0 : 1;
+    }
+    // Partisjonene gis eksplisitt slik at imaget kan lages og spilles av på vanlige filer
+    if (args.size() == 4 && args[0] == "capture-image") {
+        return captureGoldenImage({ { "NIXBOOT", args[2] }, { "NIXROOT", args[3] } }, args[1], log) ? 0 : 1;
+    }
+    if ((args.size() == 4 || args.size() == 5) && args[0] == "replay-image") {
+        bool targetZeroed = args.size() == 5 && args[4] == "zeroed";
+        return replayGoldenImage(args[1], { { "NIXBOOT", args[2] }, { "NIXROOT", args[3] } }, targetZeroed, log) &&
+               assignNewFilesystemId(args[3], log) ? 0 : 1;
+    }
+    if ((args.size() == 4 || args.size() == 5) && args[0] == "personalize") {
+        return personalizeReplayedSystem(args[1], { args[2], args[3], args.size() == 5 ? args[4] : "" }, log) ? 0 : 1;
+    }
+    if ((args.size() == 4 || args.size() == 5) && args[0] == "seed-store") {
+        StoreSeedOptions options = defaultStoreSeedOptions(args[1]);
+        options.binaryCacheDir = args.size() == 5 ? args[4] : "";
+        // Det som ikke ble fylt inn hentes av bygget, så steget feiler ikke på dette
+        seedStoreForPreset(args[2], args[3], options, log);
+        return 0;
+    }
+    if ((args.size() == 5 || args.size() == 6) && args[0] == "build-system") {
+        StoreSeedOptions options = defaultStoreSeedOptions(args[1]);
+        options.binaryCacheDir = args.size() == 6 ? args[5] : "";
+        unsigned concurrentBuilds = static_cast<unsigned>(std::max(1, atoi(args[4].c_str())));
+        return buildAndInstallSystem(args[1], args[2], args[3], installSubstituters(options), concurrentBuilds, log) ? 0 : 1;
+    }
+    if (args.size() == 2 && args[0] == "probe") {
+        StorageProbe probe = readStorageAttributes(args[1]);
+        if (!benchmarkStorageReads(args[1], probe)) {
+            log("Read test failed on " + args[1]);
+            return 1;
+        }
+        std::cout << formatStorageProbe(probe) << std::flush;
+        return 0;
+    }
+    std::string joined;
+    for (const auto& arg : args) {
+        joined += " " + arg;
+    }
+    log("Unknown helper command:" + joined);
+    return 2;
+}
+
+int runHelperCommand(int argc, char* argv[]) {
+    std::vector<std::string> args(argv, argv + argc);
+    return runHelper(args, [](const std::string& line) { std::cout << line << std::endl; });
+}
+
+std::vector<InstallStep> buildInstallSteps(const std::string& disk, const std::string& preset) {
+    std::vector<InstallStep> steps;
+    // Hentingen fra nettet er uavhengig av disken og går parallelt med diskforberedelsen
+    steps.push_back(fetchPresetStep(preset));
+    appendDiskSteps(steps, disk, "/mnt", "");
+    steps.push_back(seedStoreStep(preset, "/mnt", "", ""));
+    steps.push_back(diskStep("Generate config", { "Mount filesystems" }, disk, "/mnt",
+        "sudo nixos-generate-config --root \"$ROOT\"\n", ""));
+    steps.push_back(buildSystemStep(preset, "/mnt", "Generate config", "", "", 1));
+    return steps;
+}
+
+std::string multiDiskMountRoot(const std::string& disk) {
+    return "/mnt/nixum/" + disk.substr(disk.rfind('/') + 1);
+}
+
+std::vector<InstallStep> buildMultiDiskInstallSteps(const std::vector<std::string>& disks, const std::string& preset) {
+    if (disks.size() == 1) {
+        return buildInstallSteps(disks[0], preset);
+    }
+    std::vector<InstallStep> steps;
+    if (disks.empty()) {
+        return steps;
+    }
+    steps.push_back(fetchPresetStep(preset));
+    for (const auto& disk : disks) {
+        appendDiskSteps(steps, disk, multiDiskMountRoot(disk), diskSuffix(disk));
+        steps.push_back(seedStoreStep(preset, multiDiskMountRoot(disk), diskSuffix(disk), disk));
+    }
+
+    // Konfigurasjonen genereres én gang, fra den første disken når den er montert. De andre
+    // diskene får en kopi der UUID-ene til den første diskens filsystemer er byttet ut med sine egne.
+    const std::string& first = disks[0];
+    std::string firstRoot = multiDiskMountRoot(first);
+    steps.push_back(diskStep("Generate config", { "Mount filesystems" + diskSuffix(first) }, first, firstRoot,
+        "sudo nixos-generate-config --root \"$ROOT\"\n", ""));
+    steps.push_back(buildSystemStep(preset, firstRoot, "Generate config", diskSuffix(first), first, disks.size()));
+    for (size_t i = 1; i < disks.size(); i++) {
+        const std::string& disk = disks[i];
+        steps.push_back(diskStep("Copy config" + diskSuffix(disk), { "Generate config", "Mount filesystems" + diskSuffix(disk) }, disk,
+            multiDiskMountRoot(disk),
+            "SOURCE=" + shellQuote(firstRoot + "/etc/nixos") + "\n"
+            "FIRST_BOOT_UUID=$(sudo blkid -s UUID -o value " + shellQuote(partitionDevicePath(first, 1)) + ")\n"
+            "FIRST_ROOT_UUID=$(sudo blkid -s UUID -o value " + shellQuote(partitionDevicePath(first, 2)) + ")\n"
+            "BOOT_UUID=$(sudo blkid -s UUID -o value \"$NIXBOOT\")\n"
+            "ROOT_UUID=$(sudo blkid -s UUID -o value \"$NIXROOT\")\n"
+            // Et tomt mønster ville fått sed til å bruke forrige regex om igjen
+            "if [ -z \"$FIRST_BOOT_UUID\" ] || [ -z \"$FIRST_ROOT_UUID\" ] || [ -z \"$BOOT_UUID\" ] || [ -z \"$ROOT_UUID\" ]; then\n"
+            "    echo \"Could not read filesystem UUIDs with blkid\" >&2\n"
+            "    exit 1\n"
+            "fi\n"
+            "sudo mkdir -p \"$ROOT/etc/nixos\"\n"
+            "sudo cp -a \"$SOURCE/.\" \"$ROOT/etc/nixos/\"\n"
+            "sudo sed -i -e \"s|$FIRST_BOOT_UUID|$BOOT_UUID|g\" -e \"s|$FIRST_ROOT_UUID|$ROOT_UUID|g\" \"$ROOT/etc/nixos/hardware-configuration.nix\"\n",
+            disk));
+        steps.push_back(buildSystemStep(preset, multiDiskMountRoot(disk), "Copy config" + diskSuffix(disk), diskSuffix(disk), disk, disks.size()));
+    }
+    return steps;
+}
+
+void appendCaptureSteps(std::vector<InstallStep>& steps, const std::string& disk, const std::string& imageDir) {
+    // Imaget tas når alt annet er ferdig, fra avmonterte partisjoner
+    std::vector<std::string> everything;
+    for (const auto& step : steps) {
+        everything.push_back(step.name);
+    }
+    steps.push_back(privilegedStep("Unmount filesystems", everything, { "unmount-layout", disk, "/mnt" }, ""));
+    std::vector<ImagePartition> partitions = nixumImagePartitions(disk);
+    steps.push_back(privilegedStep("Capture image", { "Unmount filesystems" },
+                                   { "capture-image", imageDir, partitions[0].path, partitions[1].path }, ""));
+}
+
+std::vector<InstallStep> buildReplayInstallSteps(const std::vector<std::string>& disks, const std::string& imageDir,
+                                                 const MachineFields& fields) {
+    std::vector<InstallStep> steps;
+    for (const auto& disk : disks) {
+        bool multiple = disks.size() > 1;
+        std::string suffix = multiple ? diskSuffix(disk) : "";
+        std::string target = multiple ? disk : "";
+        std::string root = multiple ? multiDiskMountRoot(disk) : "/mnt";
+        std::vector<ImagePartition> partitions = nixumImagePartitions(disk);
+        steps.push_back(privilegedStep("Wipe disk" + suffix, {}, wipeHelperArgs(disk), target));
+        steps.push_back(privilegedStep("Partition disk" + suffix, { "Wipe disk" + suffix }, { "partition", disk }, target));
+        // Når tømmingen nuller disken, trenger ikke områdene imaget ikke har lagret å skrives en gang til
+        std::vector<std::string> replayArgs = { "replay-image", imageDir, partitions[0].path, partitions[1].path };
+        if (plannedDiskWipe(disk, atof(measuredWipeMBps(disk).c_str())).method == WipeMethod::ZeroOut) {
+            replayArgs.push_back("zeroed");
+        }
+        steps.push_back(privilegedStep("Replay image" + suffix, { "Partition disk" + suffix }, replayArgs, target));
+        steps.push_back(privilegedStep("Mount filesystems" + suffix, { "Replay image" + suffix },
+                                       { "mount-layout", disk, root, tunedBtrfsOptionsFor(disk) }, target));
+        steps.push_back(privilegedStep("Personalize" + suffix, { "Mount filesystems" + suffix },
+                                       { "personalize", root, fields.hostname, fields.username, fields.sshKey }, target));
+    }
+    return steps;
+}
+
+int multiDiskParallelSteps(size_t diskCount) {
+    return static_cast<int>(std::min<size_t>(std::max<size_t>(1, diskCount) * MAX_PARALLEL_STEPS, MAX_MULTI_DISK_PARALLEL_STEPS));
+}
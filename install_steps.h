@@ -0,0 +1,43 @@
+#pragma once
+
+#include "golden_image.h"
+#include "install_pipeline.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+std::string getExecutablePath();
+
+// Installasjonsstegene for valgt disk og forhåndsinnstilling, med avhengigheter
+std::vector<InstallStep> buildInstallSteps(const std::string& disk, const std::string& preset);
+
+// Avbildning av flere like maskiner samtidig: én felles forhåndsinnstilling og én generert
+// konfigurasjon, deretter partisjonering, formatering, montering, kopi av konfigurasjonen og bygg
+// for hver disk parallelt. Hver disk monteres under multiDiskMountRoot(disk), f.eks. /mnt/nixum/sdb,
+// og stegene dens har InstallStep::target satt. Én disk gir de vanlige stegene under /mnt.
+std::vector<InstallStep> buildMultiDiskInstallSteps(const std::vector<std::string>& disks, const std::string& preset);
+std::string multiDiskMountRoot(const std::string& disk);
+
+// Etter de andre stegene: avmonterer /mnt og lagrer disken som gyllent image i imageDir
+void appendCaptureSteps(std::vector<InstallStep>& steps, const std::string& disk, const std::string& imageDir);
+
+// Installasjon fra et gyllent image: tømming, partisjonering, avspilling, montering og de maskinspesifikke
+// feltene. Ingen henting, formatering eller bygging. Flere disker spilles av samtidig som i
+// buildMultiDiskInstallSteps.
+std::vector<InstallStep> buildReplayInstallSteps(const std::vector<std::string>& disks, const std::string& imageDir,
+                                                 const MachineFields& fields);
+
+// Hvor mange steg som kan kjøre samtidig for diskCount disker, begrenset av MAX_MULTI_DISK_PARALLEL_STEPS
+int multiDiskParallelSteps(size_t diskCount);
+
+// Privilegerte operasjoner i prosessen ("wipe <disk> [MB/s]", "partition <disk>", "mount-layout <disk> <target> [btrfs-valg]",
+// "unmount-layout <disk> <target>", "capture-image <dir> <boot> <root>", "replay-image <dir> <boot> <root> [zeroed]",
+// "personalize <target> <vertsnavn> <bruker> [ssh-nøkkel]", "seed-store <target> <flake-katalog> <forhåndsinnstilling> [cache]",
+// "build-system <target> <flake-katalog> <forhåndsinnstilling> <samtidige bygg> [cache]", "probe <disk>"), brukt både direkte
+// når installasjonen kjører som root og av "nixum_install --helper" under sudo
+int runHelper(const std::vector<std::string>& args, const std::function<void(const std::string&)>& log);
+// "<program> --helper <argumenter>" for sh/bash, med hvert argument i egne anførselstegn, så verdier fra
+// feltene og svarfilen (', $(), linjeskift) kommer fram uendret og aldri tolkes av skallet
+std::string helperCommandLine(const std::string& executable, const std::vector<std::string>& args);
+int runHelperCommand(int argc, char* argv[]);
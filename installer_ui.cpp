@@ -0,0 +1,1400 @@
+#include "installer_ui.h"
+
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <algorithm>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
+
+#include "disk_inventory.h"
+#include "disk_wipe.h"
+#include "embedded_font.h"
+#include "field_validation.h"
+#include "frame_profiler.h"
+#include "glyph_atlas.h"
+#include "headless_install.h"
+#include "install_pipeline.h"
+#include "install_steps.h"
+#include "redraw_scheduler.h"
+#include "storage_probe.h"
+#include "text_cache.h"
+#include "text_layout.h"
+#include "widget_tree.h"
+
+// Oppsett (vindusstørrelsen står i installer_ui.h)
+const int MENU_WIDTH = 200;
+const int HEADER_HEIGHT = 150;
+const int MARGIN = 10;
+const int LINE_HEIGHT = 30;
+const int BOX_SIZE = 20;
+const int SCROLL_SPEED = 10;
+const Uint32 CURSOR_BLINK_MS = 500;
+const Uint32 ANIMATION_INTERVAL_MS = 500;
+const size_t INSTALL_LOG_CAPACITY = 1000;
+const size_t INSTALL_LOG_VISIBLE_LINES = 14;
+const size_t INSTALL_LOG_LINE_CHARS = 60;
+const size_t ACTIVITY_VISIBLE_LINES = 5;
+const SDL_Color TEXT_FIELD_COLOR = { 255, 255, 255, 255 };
+
+// Strukturer for sider
+struct Page {
+    std::string title;
+    std::string content;
+};
+
+// Strukturer for tekstfelt
+struct TextField {
+    std::string label;
+    std::string value;
+    int x, y, width, height;
+    bool active;
+};
+
+struct DropdownField {
+    std::string label;
+    std::vector<std::string> options;
+    int selectedIndex;
+    int x, y, width, height;
+    bool active;
+};
+
+// Globale variabler
+std::string selectedDisk; // Lagre valgt disk
+std::vector<std::string> imagingDisks; // Flere like disker fra svarfilen (disks = [...]), ellers tom
+std::string captureImageDir; // image.capture: lagre den ferdige disken som gyllent image
+std::string replayImageDir;  // image.replay: installer fra et gyllent image
+std::string selectedPreset; // Lagre valgt forhåndsinnstilling
+bool encryptionEnabled = false;
+std::string authStatus = "Checking auth status";
+int scrollOffset = 0;
+int animationFrame = 0;
+Uint32 lastAnimationTime = 0;
+
+// F12 viser tidsmålingene; NIXUM_PROFILE/NIXUM_TRACE holder målingen på uten overlay
+bool profilerOverlayVisible = false;
+bool profilingRequested = false;
+std::string traceExportPath;
+
+// Tilstanden til veiviseren mellom frames, satt opp av initInstallerUi
+SDL_Renderer* uiRenderer = nullptr;
+TTF_Font* uiFont = nullptr;
+InstallerUiOptions uiOptions;
+Page welcomePage;
+std::vector<Page> pages;
+std::vector<std::string> disks;
+std::vector<std::string> diskProbeLines; // Sammendraget av lesetesten under hver disk, samme rekkefølge som disks
+int currentPage = -1; // Start på velkomstsiden
+bool quitRequested = false;
+bool cursorVisible = true;
+bool lastCursorVisible = true;
+int hoveredRow = -1; // Raden under musepekeren på disk- eller forhåndsinnstillingssiden
+int hoveredRowPage = -1;
+
+// Programvaretegning: rendereren tegner rett i vinduets overflate, som beholder forrige frame.
+// Bare de skadde områdene tegnes, og bare de sendes til skjermen.
+SDL_Window* softwarePresentWindow = nullptr;
+std::vector<SDL_Rect> frameDamage;
+// Området framen faktisk tegner (det omsluttende rektangelet rundt skaden); rader og felt utenfor hoppes over
+SDL_Rect drawBounds = { 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT };
+
+// Widgettrærne for sidene med rader og felt. Rektanglene regnes ut på nytt bare når
+// disklisten endres eller krypteringsfeltet vises eller skjules.
+const std::vector<std::string> PRESETS = { "desktop", "htpc", "server" };
+WidgetTree diskTree;
+WidgetTree presetTree;
+WidgetTree infoTree;
+int encryptionCheckboxWidget = -1;
+int encryptionKeyWidget = -1;
+
+// Diskene skannes og installasjonen kjører i bakgrunnen; UI-tråden får beskjed via egne SDL-hendelser.
+// Skanningen kan starte før SDL_Init, så hendelsen er 0 til initInstallerUi har registrert den.
+std::atomic<Uint32> diskInventoryEvent{ 0 };
+Uint32 installEvent = 0;
+
+// Installasjonsfremdrift, fylt fra pipeline-hendelsene
+std::deque<std::string> installLog;
+std::string installStatus;
+int installStepsCompleted = 0;
+std::vector<std::string> diskProgressLines; // "sdb: 3/5 steps", kun når flere disker installeres
+// Pågående aktiviteter per steg og aktivitets-id, f.eks. "building hello-2.12.1 (buildPhase, 42 s)"
+std::map<std::pair<int, uint64_t>, std::string> activityLines;
+
+// Ferdigtegnet ramme (bakgrunn, linjer, knapper og header), én variant med og én uten tilbakeknapp.
+// Tegnes på nytt kun når vindusstørrelsen endres eller invalidateChrome() kalles.
+struct ChromeCache {
+    SDL_Texture* textures[2] = { nullptr, nullptr };
+    int width = 0, height = 0;
+};
+ChromeCache chromeCache;
+
+// Brukerinformasjonsfelter; x og y settes av layoutInfoPage()
+std::vector<TextField> textFields = {
+    {"Hostname", "", 0, 0, 300, 40, false},
+    {"Username", "", 0, 0, 300, 40, false},
+    {"Password", "", 0, 0, 300, 40, false},
+    {"Encryption Key", "", 0, 0, 300, 40, false},
+    {"Github Username", "", 0, 0, 300, 40, false},
+    {"Github E-mail", "", 0, 0, 300, 40, false},
+    {"SSH Github Key", "", 0, 0, 300, 40, false}
+};
+std::vector<FieldValidator> fieldValidators; // Oppdateres tegn for tegn mens brukeren skriver
+
+// Svarfilnøklene for feltene over (se headless_install.h)
+const std::vector<std::pair<std::string, std::string>> ANSWER_FIELD_KEYS = {
+    {"user.hostname", "Hostname"},
+    {"user.username", "Username"},
+    {"user.password", "Password"},
+    {"user.keyboard_layout", "Keyboard Layout"},
+    {"user.country", "Country"},
+    {"encryption.key", "Encryption Key"},
+    {"github.username", "Github Username"},
+    {"github.email", "Github E-mail"},
+    {"github.ssh_key", "SSH Github Key"}
+};
+
+std::vector<DropdownField> dropdownFields = {
+    {"Keyboard Layout", {"US", "UK", "DE"}, 0, 0, 0, 300, 40, false},
+    {"Country", {"Norway", "Sweden", "Denmark"}, 0, 0, 0, 300, 40, false}
+};
+
+// Funksjonsdeklarasjoner
+void drawText(SDL_Renderer* renderer, TTF_Font* font, const std::string& text, int x, int y, SDL_Color color, bool bold = false, int wrapLength = 0);
+void drawPage(SDL_Renderer* renderer, TTF_Font* font, Page& page);
+std::vector<std::string> getDisks();
+void refreshDiskPage(Page& page, std::vector<std::string>& disks);
+std::string describeSelectedDiskProbe();
+void notifyDiskPage();
+void onDiskInventoryChanged();
+void drawMenu(SDL_Renderer* renderer, TTF_Font* font, int currentPage);
+void drawHeader(SDL_Renderer* renderer, TTF_Font* font, const std::string& headerText);
+void drawLines(SDL_Renderer* renderer);
+void drawChromeContents(SDL_Renderer* renderer, TTF_Font* font, bool showBackButton);
+void drawChrome(SDL_Renderer* renderer, TTF_Font* font, bool showBackButton);
+void invalidateChrome();
+void drawCheckbox(SDL_Renderer* renderer, int x, int y, bool checked);
+void resetFieldValidators();
+void setTextFieldValue(size_t index, const std::string& value);
+int firstFieldNeedingInput();
+void drawFieldValidation(SDL_Renderer* renderer, TTF_Font* font, const TextField& field, const FieldValidator& validator, int yOffset);
+void startInstall();
+bool applyAnswers(const std::map<std::string, std::string>& answers, std::string& error);
+int runHeadlessInstall(const std::string& answersPath);
+void drainInstallEvents();
+void updateDiskProgress();
+std::vector<std::string> selectedInstallDisks();
+std::vector<InstallStep> buildSelectedInstallSteps();
+void drawInstallProgress(SDL_Renderer* renderer, TTF_Font* font);
+void drawProfilerOverlay(SDL_Renderer* renderer, TTF_Font* font);
+void toggleProfilerOverlay();
+void drawTextField(SDL_Renderer* renderer, TTF_Font* font, TextField& field, int yOffset, bool showCursor);
+void forgetTextFieldValue(const TextField& field);
+void drawDropdownField(SDL_Renderer* renderer, TTF_Font* font, DropdownField& field, int yOffset);
+WidgetTree* rowTreeForPage(int page);
+void buildRowTree(WidgetTree& tree, size_t rowCount, int rowHeight);
+void buildInfoTree();
+void layoutInfoPage();
+void handleScrolling(SDL_Event& e);
+int getTextHeight(TTF_Font* font, const std::string& text, int wrapLength);
+bool updateAuthStatusAnimation(Uint32 currentTime);
+bool eventChangesUi(const SDL_Event& e);
+bool eventEditsActiveTextField(const SDL_Event& e);
+SDL_Rect textFieldDamage(const TextField& field);
+SDL_Rect caretDamage();
+SDL_Rect authStatusDamage();
+void updateHoveredRow(int x, int y);
+void drawFrame(SDL_Renderer* renderer, TTF_Font* font);
+void drawRowHover(SDL_Renderer* renderer, const SDL_Rect& rect, int row);
+bool insideDrawBounds(const SDL_Rect& rect);
+SDL_Rect labeledFieldBounds(int x, int y, int height);
+void drawClippedRect(SDL_Renderer* renderer, SDL_Rect& rect);
+
+// Funksjoner
+void drawText(SDL_Renderer* renderer, TTF_Font* font, const std::string& text, int x, int y, SDL_Color color, bool bold, int wrapLength) {
+    // Vanlig tekst går gjennom glyfatlaset; tegn utenfor atlaset faller tilbake til texturcachen
+    if (glyphAtlasCovers(text, bold)) {
+        queueAtlasText(text, x, y, color, bold, wrapLength);
+        return;
+    }
+
+    int width, height;
+    SDL_Texture* texture = getTextTexture(renderer, font, text, color, bold, wrapLength, &width, &height);
+    if (texture == nullptr) {
+        return;
+    }
+    SDL_Rect dest = { x, y, width, height };
+    flushTextBatch(renderer);
+    SDL_RenderCopy(renderer, texture, NULL, &dest);
+    countDrawCalls(1);
+}
+
+// Fra den bufrede layouten; teksten rasteriseres ikke for å måles
+int getTextHeight(TTF_Font* font, const std::string& text, int wrapLength) {
+    return getTextLayout(font, text, false, wrapLength).height;
+}
+
+void drawPage(SDL_Renderer* renderer, TTF_Font* font, Page& page) {
+    SDL_Color textColor = { 255, 255, 255, 255 };
+    int y = HEADER_HEIGHT + 20 - scrollOffset;
+    drawText(renderer, font, page.title, MENU_WIDTH + MARGIN, y, textColor, true);
+    y += 50;
+    drawText(renderer, font, page.content, MENU_WIDTH + MARGIN, y, textColor, false, WINDOW_WIDTH - MENU_WIDTH - 2 * MARGIN);
+}
+
+std::vector<std::string> getDisks() {
+    std::vector<std::string> disks;
+    for (const auto& device : getDiskInventory()) {
+        disks.push_back(describeBlockDevice(device));
+    }
+    return disks;
+}
+
+void refreshDiskPage(Page& page, std::vector<std::string>& disks) {
+    disks = getDisks();
+    page.content = "Available disks:\n";
+    bool selectedStillPresent = false;
+    for (const auto& disk : disks) {
+        page.content += disk + "\n";
+        if (disk.substr(0, disk.find(" - Size:")) == selectedDisk) {
+            selectedStillPresent = true;
+        }
+    }
+    // Lesetesten for hver disk vises på en egen linje under den
+    diskProbeLines.clear();
+    for (const auto& disk : disks) {
+        std::string path = disk.substr(0, disk.find(" - Size:"));
+        StorageProbe probe;
+        if (getStorageProbe(path, probe)) {
+            diskProbeLines.push_back(summarizeStorageProbe(probe));
+        } else if (uiOptions.probeDisks) {
+            diskProbeLines.push_back("Testing...");
+        } else {
+            diskProbeLines.push_back(summarizeStorageProbe(readStorageAttributes(path, uiOptions.sysRoot)));
+        }
+    }
+    buildRowTree(diskTree, disks.size(), 2 * LINE_HEIGHT);
+    // En frakoblet disk kan ikke lenger være installasjonsmål
+    if (!selectedStillPresent && !selectedDisk.empty()) {
+        std::cerr << "Selected disk disappeared: " << selectedDisk << std::endl;
+        selectedDisk.clear();
+    }
+}
+
+// Vises under disklisten: hele lesetestresultatet for den valgte disken og monteringsvalgene og
+// slettingen installasjonen vil bruke (sammendraget for hver disk står i raden)
+std::string describeSelectedDiskProbe() {
+    if (selectedDisk.empty()) {
+        return "";
+    }
+    StorageProbe probe;
+    if (!getStorageProbe(selectedDisk, probe)) {
+        return "Testing " + selectedDisk + "...";
+    }
+    std::string wipe;
+    for (const auto& device : getDiskInventory()) {
+        if (device.path == selectedDisk) {
+            wipe = "\n" + describeWipePlan(planDiskWipe(probe, device.sizeBytes, true));
+        }
+    }
+    return describeStorageProbe(probe) + "\nbtrfs options: " + tunedBtrfsOptions(probe, std::thread::hardware_concurrency()) + wipe;
+}
+
+TTF_Font* loadEmbeddedFont(int fontSize) {
+    SDL_RWops* rw = SDL_RWFromConstMem(embeddedFontData, static_cast<int>(embeddedFontSize));
+    TTF_Font* font = rw ? TTF_OpenFontRW(rw, 1, fontSize) : nullptr;
+    if (font == nullptr) {
+        std::cerr << "TTF_OpenFontRW Error: " << TTF_GetError() << std::endl;
+    }
+    return font;
+}
+
+void drawMenu(SDL_Renderer* renderer, TTF_Font* font, int currentPage) {
+    const std::vector<std::string> menuItems = { "Select Drive", "Select preset", "Your info", "Install" };
+    int y = HEADER_HEIGHT + 40; // Start litt lavere for jevn avstand
+
+    for (int i = 0; i < menuItems.size(); ++i) {
+        SDL_Color textColor = (i == currentPage) ? SDL_Color{ 255, 165, 0, 255 } : SDL_Color{ 255, 255, 255, 255 };
+        drawText(renderer, font, menuItems[i], MARGIN, y, textColor, false, MENU_WIDTH - 2 * MARGIN);
+        y += 60; // Økt avstand mellom knappene
+    }
+}
+
+void drawHeader(SDL_Renderer* renderer, TTF_Font* font, const std::string& headerText) {
+    SDL_Color textColor = { 255, 255, 255, 255 };
+    drawText(renderer, font, headerText, MENU_WIDTH + MARGIN, 50, textColor, true);
+}
+
+void drawLines(SDL_Renderer* renderer) {
+    flushTextBatch(renderer);
+    // Draw vertical line for the menu with fading ends
+    for (int i = 0; i < WINDOW_HEIGHT; ++i) {
+        int colorValue = 255 - static_cast<int>((255.0 / WINDOW_HEIGHT) * i);
+        SDL_SetRenderDrawColor(renderer, colorValue, colorValue, colorValue, 255);
+        SDL_RenderDrawPoint(renderer, MENU_WIDTH, i);
+        countDrawCalls(1);
+    }
+
+    // Draw horizontal line for the header with fading ends
+    for (int i = 0; i < WINDOW_WIDTH; ++i) {
+        int colorValue = 255 - static_cast<int>((255.0 / WINDOW_WIDTH) * i);
+        SDL_SetRenderDrawColor(renderer, colorValue, colorValue, colorValue, 255);
+        SDL_RenderDrawPoint(renderer, i, HEADER_HEIGHT);
+        countDrawCalls(1);
+    }
+}
+
+void drawChromeContents(SDL_Renderer* renderer, TTF_Font* font, bool showBackButton) {
+    flushTextBatch(renderer);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+    countDrawCalls(1);
+
+    drawLines(renderer);
+    drawHeader(renderer, font, "NixumOS Installer");
+
+    SDL_Rect nextButton = { WINDOW_WIDTH - 150, WINDOW_HEIGHT - 100, 100, 50 };
+    flushTextBatch(renderer);
+    SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
+    SDL_RenderFillRect(renderer, &nextButton);
+    countDrawCalls(1);
+
+    if (showBackButton) {
+        SDL_Rect backButton = { 50, WINDOW_HEIGHT - 100, 100, 50 };
+        SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
+        SDL_RenderFillRect(renderer, &backButton);
+        countDrawCalls(1);
+        drawText(renderer, font, "Back", 80, WINDOW_HEIGHT - 90, { 255, 255, 255, 255 });
+    }
+
+    SDL_Rect closeButton = { WINDOW_WIDTH - 50, 0, 50, 50 };
+    flushTextBatch(renderer);
+    SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
+    SDL_RenderFillRect(renderer, &closeButton);
+    countDrawCalls(1);
+    drawText(renderer, font, "X", WINDOW_WIDTH - 35, 10, { 255, 255, 255, 255 });
+}
+
+void invalidateChrome() {
+    for (auto& texture : chromeCache.textures) {
+        if (texture != nullptr) {
+            SDL_DestroyTexture(texture);
+            texture = nullptr;
+        }
+    }
+}
+
+void drawChrome(SDL_Renderer* renderer, TTF_Font* font, bool showBackButton) {
+    int width = 0, height = 0;
+    SDL_GetRendererOutputSize(renderer, &width, &height);
+    if (width != chromeCache.width || height != chromeCache.height) {
+        invalidateChrome();
+        chromeCache.width = width;
+        chromeCache.height = height;
+    }
+
+    SDL_Texture*& texture = chromeCache.textures[showBackButton ? 1 : 0];
+    if (texture == nullptr && SDL_RenderTargetSupported(renderer)) {
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, width, height);
+        if (texture == nullptr) {
+            std::cerr << "SDL_CreateTexture Error: " << SDL_GetError() << std::endl;
+        } else {
+            flushTextBatch(renderer);
+            SDL_SetRenderTarget(renderer, texture);
+            beginCacheRebuild();
+            drawChromeContents(renderer, font, showBackButton);
+            flushTextBatch(renderer);
+            endCacheRebuild();
+            SDL_SetRenderTarget(renderer, nullptr);
+        }
+    }
+
+    // Uten render targets tegnes rammen direkte som før
+    if (texture == nullptr) {
+        drawChromeContents(renderer, font, showBackButton);
+        return;
+    }
+    flushTextBatch(renderer);
+    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+    countDrawCalls(1);
+}
+
+void drawCheckbox(SDL_Renderer* renderer, int x, int y, bool checked) {
+    SDL_Rect box = { x, y, BOX_SIZE, BOX_SIZE };
+    flushTextBatch(renderer);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    SDL_RenderDrawRect(renderer, &box);
+    countDrawCalls(1);
+    if (checked) {
+        SDL_RenderDrawLine(renderer, x, y, x + BOX_SIZE, y + BOX_SIZE);
+        SDL_RenderDrawLine(renderer, x + BOX_SIZE, y, x, y + BOX_SIZE);
+        countDrawCalls(2);
+    }
+}
+
+// Valideringen av hvert tekstfelt, i samme rekkefølge som textFields
+void resetFieldValidators() {
+    fieldValidators.resize(textFields.size());
+    for (size_t i = 0; i < textFields.size(); i++) {
+        resetValidator(fieldValidators[i], fieldKindForLabel(textFields[i].label), textFields[i].value);
+    }
+}
+
+// Alle endringer av en verdi som ikke kommer fra tastaturet går hit, så valideringen følger verdien
+void setTextFieldValue(size_t index, const std::string& value) {
+    TextField& field = textFields[index];
+    forgetTextFieldValue(field);
+    field.value = value;
+    fieldValidators.resize(textFields.size());
+    resetValidator(fieldValidators[index], fieldKindForLabel(field.label), field.value);
+    requestRedrawRect(textFieldDamage(field));
+}
+
+// Første synlige felt som er ugyldig eller uferdig, ellers -1
+int firstFieldNeedingInput() {
+    for (size_t i = 0; i < textFields.size() && i < fieldValidators.size(); i++) {
+        if (textFields[i].label == "Encryption Key" && !encryptionEnabled) {
+            continue;
+        }
+        Validity validity = validatorResult(fieldValidators[i]).validity;
+        if (validity == Validity::Invalid || validity == Validity::Incomplete) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void startInstall() {
+    if (installPipelineRunning()) {
+        return;
+    }
+    installLog.clear();
+    installStepsCompleted = 0;
+    diskProgressLines.clear();
+    activityLines.clear();
+    if (selectedDisk.empty() || (selectedPreset.empty() && replayImageDir.empty())) {
+        installStatus = selectedDisk.empty() ? "Select a drive first" : "Select a preset first";
+        return;
+    }
+    // Samme krav som en svarfil: tilbake til "Your info" med markøren i feltet som må rettes
+    int badField = firstFieldNeedingInput();
+    if (badField >= 0) {
+        TextField& field = textFields[badField];
+        installStatus = "Check " + field.label + ": " + validatorResult(fieldValidators[badField]).message;
+        for (auto& other : textFields) {
+            other.active = &other == &field;
+        }
+        for (auto& dropdown : dropdownFields) {
+            dropdown.active = false;
+        }
+        currentPage = 2;
+        layoutInfoPage();
+        scrollOffset = std::max(0, field.y - (HEADER_HEIGHT + 120));
+        requestRedraw();
+        return;
+    }
+    installStatus = "Starting install";
+    std::vector<std::string> installDisks = selectedInstallDisks();
+    startInstallPipeline(buildSelectedInstallSteps(), []() {
+        SDL_Event event = {};
+        event.type = installEvent;
+        SDL_PushEvent(&event);
+    }, multiDiskParallelSteps(installDisks.size()));
+}
+
+std::vector<std::string> selectedInstallDisks() {
+    return imagingDisks.size() > 1 ? imagingDisks : std::vector<std::string>{ selectedDisk };
+}
+
+std::string textFieldValue(const std::string& label) {
+    for (const auto& field : textFields) {
+        if (field.label == label) {
+            return field.value;
+        }
+    }
+    return "";
+}
+
+// Vanlig installasjon, flere disker samtidig, eller avspilling av et gyllent image
+std::vector<InstallStep> buildSelectedInstallSteps() {
+    std::vector<std::string> installDisks = selectedInstallDisks();
+    if (!replayImageDir.empty()) {
+        MachineFields fields = { textFieldValue("Hostname"), textFieldValue("Username"), textFieldValue("SSH Github Key") };
+        return buildReplayInstallSteps(installDisks, replayImageDir, fields);
+    }
+    std::vector<InstallStep> steps = buildMultiDiskInstallSteps(installDisks, selectedPreset);
+    if (!captureImageDir.empty()) {
+        appendCaptureSteps(steps, selectedDisk, captureImageDir);
+    }
+    return steps;
+}
+
+// Fremdrift per disk fra stegresultatene, når stegene har target satt
+void updateDiskProgress() {
+    std::map<std::string, std::pair<int, int>> progress;
+    for (const auto& result : getInstallStepResults()) {
+        if (result.target.empty()) {
+            continue;
+        }
+        auto& [completed, total] = progress[result.target];
+        completed += result.ran && result.exitStatus == 0 ? 1 : 0;
+        total++;
+    }
+    diskProgressLines.clear();
+    for (const auto& [disk, counts] : progress) {
+        diskProgressLines.push_back(disk + ": " + std::to_string(counts.first) + "/" + std::to_string(counts.second) + " steps");
+    }
+}
+
+void drainInstallEvents() {
+    PipelineEvent event;
+    while (popPipelineEvent(event)) {
+        switch (event.kind) {
+            case PipelineEventKind::StepStarted:
+                installStatus = std::string(event.text) + "...";
+                installLog.push_back("==> " + std::string(event.text));
+                break;
+            case PipelineEventKind::StepOutput:
+                installLog.push_back(event.text);
+                break;
+            case PipelineEventKind::StepProgress: {
+                std::vector<StepResult> results = getInstallStepResults();
+                if (event.step >= 0 && event.step < static_cast<int>(results.size()) && event.total > 0) {
+                    installStatus = results[event.step].name + ": " + std::to_string(event.done * 100 / event.total) + "%";
+                }
+                break;
+            }
+            case PipelineEventKind::StepActivity:
+                if (event.text[0] == '\0') {
+                    activityLines.erase({ event.step, event.done });
+                } else {
+                    activityLines[{ event.step, event.done }] = event.text;
+                }
+                break;
+            case PipelineEventKind::StepFinished:
+                if (event.status == 0) {
+                    installStepsCompleted++;
+                }
+                activityLines.erase(activityLines.lower_bound({ event.step, 0 }), activityLines.lower_bound({ event.step + 1, 0 }));
+                updateDiskProgress();
+                installLog.push_back("<== " + std::string(event.text) + ": exit " + std::to_string(event.status) +
+                                     " after " + std::to_string(static_cast<int>(event.seconds + 0.5)) + " s");
+                break;
+            case PipelineEventKind::PipelineFinished:
+                installStatus = event.text;
+                installLog.push_back(event.text);
+                printInstallStepTimings();
+                break;
+        }
+    }
+    while (installLog.size() > INSTALL_LOG_CAPACITY) {
+        installLog.pop_front();
+    }
+}
+
+void drawInstallProgress(SDL_Renderer* renderer, TTF_Font* font) {
+    SDL_Color textColor = { 255, 255, 255, 255 };
+    int x = MENU_WIDTH + MARGIN;
+    int y = HEADER_HEIGHT + 110;
+    if (!installStatus.empty()) {
+        drawText(renderer, font, installStatus, x, y, textColor);
+    }
+
+    int stepCount = getInstallStepCount();
+    if (stepCount > 0) {
+        SDL_Rect bar = { x, y + 40, WINDOW_WIDTH - MENU_WIDTH - 2 * MARGIN, 24 };
+        SDL_Rect fill = { bar.x, bar.y, bar.w * installStepsCompleted / stepCount, bar.h };
+        flushTextBatch(renderer);
+        SDL_SetRenderDrawColor(renderer, 255, 165, 0, 255);
+        SDL_RenderFillRect(renderer, &fill);
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        SDL_RenderDrawRect(renderer, &bar);
+        countDrawCalls(2);
+    }
+
+    int lineY = y + 80;
+    for (const auto& line : diskProgressLines) {
+        drawText(renderer, font, line, x, lineY, textColor);
+        lineY += LINE_HEIGHT;
+    }
+    size_t activityCount = 0;
+    for (const auto& [key, line] : activityLines) {
+        if (activityCount++ == ACTIVITY_VISIBLE_LINES) {
+            break;
+        }
+        drawText(renderer, font, line.substr(0, INSTALL_LOG_LINE_CHARS), x, lineY, textColor);
+        lineY += LINE_HEIGHT;
+    }
+
+    // Siste linjer av loggen, avkortet til vindusbredden
+    size_t first = installLog.size() > INSTALL_LOG_VISIBLE_LINES ? installLog.size() - INSTALL_LOG_VISIBLE_LINES : 0;
+    for (size_t i = first; i < installLog.size(); ++i) {
+        drawText(renderer, font, installLog[i].substr(0, INSTALL_LOG_LINE_CHARS), x, lineY, textColor);
+        lineY += LINE_HEIGHT;
+    }
+}
+
+void drawTextField(SDL_Renderer* renderer, TTF_Font* font, TextField& field, int yOffset, bool showCursor) {
+    SDL_Color color = TEXT_FIELD_COLOR;
+    SDL_Rect rect = { field.x, field.y - yOffset, field.width, field.height };
+    flushTextBatch(renderer);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    SDL_RenderDrawRect(renderer, &rect);
+    countDrawCalls(1);
+    drawText(renderer, font, field.label, field.x, field.y - 25 - yOffset, color, false);
+    if (!field.value.empty()) {
+        drawText(renderer, font, field.value, field.x + 5, field.y + 5 - yOffset, color, false);
+    }
+    if (showCursor && field.active) {
+        int caretX = 0;
+        caretPosition(getTextLayout(font, field.value, false, 0), field.value.size(), &caretX, nullptr);
+        flushTextBatch(renderer);
+        SDL_RenderDrawLine(renderer, field.x + 5 + caretX, field.y + 5 - yOffset, field.x + 5 + caretX, field.y + field.height - 5 - yOffset);
+        countDrawCalls(1);
+    }
+}
+
+// Før verdien endres: bare teksturen drawTextField har laget for verdien, ikke lik tekst i andre widgeter
+void forgetTextFieldValue(const TextField& field) {
+    invalidateTextCache(uiFont, field.value, TEXT_FIELD_COLOR, false, 0);
+}
+
+// Feilen eller hintet til høyre for feltet: rødt når verdien er ugyldig, grått når den bare er uferdig
+void drawFieldValidation(SDL_Renderer* renderer, TTF_Font* font, const TextField& field, const FieldValidator& validator, int yOffset) {
+    ValidationResult result = validatorResult(validator);
+    if (result.validity != Validity::Invalid && result.validity != Validity::Incomplete) {
+        return;
+    }
+    SDL_Color color = result.validity == Validity::Invalid ? SDL_Color{ 255, 90, 90, 255 } : SDL_Color{ 160, 160, 160, 255 };
+    drawText(renderer, font, result.message, field.x + field.width + 10, field.y + 5 - yOffset, color);
+}
+
+void drawDropdownField(SDL_Renderer* renderer, TTF_Font* font, DropdownField& field, int yOffset) {
+    SDL_Color color = { 255, 255, 255, 255 };
+    SDL_Rect rect = { field.x, field.y - yOffset, field.width, field.height };
+    flushTextBatch(renderer);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    SDL_RenderDrawRect(renderer, &rect);
+    countDrawCalls(1);
+    drawText(renderer, font, field.label, field.x, field.y - 25 - yOffset, color, false);
+    drawText(renderer, font, field.options[field.selectedIndex], field.x + 5, field.y + 5 - yOffset, color, false);
+}
+
+// Det en svarfil velger, samlet og sjekket før noe av det skrives til globalene
+struct AnswerSelection {
+    std::string disk;
+    std::vector<std::string> imagingDisks;
+    std::string captureImageDir;
+    std::string replayImageDir;
+    std::string preset;
+    bool encryptionEnabled = false;
+    std::vector<std::string> textValues; // Samme rekkefølge som textFields
+    std::vector<int> dropdownIndices;    // Samme rekkefølge som dropdownFields
+};
+
+// Fyller de samme globalene som sidene gjør og sjekker dem slik installasjonen krever.
+// Ukjente nøkler avvises så skrivefeil i svarfilen ikke blir stille ignorert. Globalene endres
+// først når alt er godkjent, så en avvist svarfil ikke etterlater halvfylte sider.
+bool applyAnswers(const std::map<std::string, std::string>& answers, std::string& error) {
+    for (const auto& [key, value] : answers) {
+        bool known = key == "disk" || key == "disks" || key == "preset" || key == "encryption.enabled" ||
+                     key == "image.capture" || key == "image.replay";
+        for (const auto& [fieldKey, label] : ANSWER_FIELD_KEYS) {
+            known = known || key == fieldKey;
+        }
+        if (!known) {
+            error = "Unknown answer key: " + key;
+            return false;
+        }
+    }
+    auto answer = [&answers](const std::string& key) {
+        auto it = answers.find(key);
+        return it == answers.end() ? std::string() : it->second;
+    };
+
+    // disk = "..." for én disk, disks = [...] for å avbilde flere like maskiner samtidig
+    if (!answer("disk").empty() && !answer("disks").empty()) {
+        error = "Give either disk or disks, not both";
+        return false;
+    }
+    std::vector<std::string> requestedDisks;
+    std::string diskList = answer("disks").empty() ? answer("disk") : answer("disks");
+    for (size_t start = 0; start < diskList.size();) {
+        size_t end = std::min(diskList.find('\n', start), diskList.size());
+        requestedDisks.push_back(diskList.substr(start, end - start));
+        start = end + 1;
+    }
+    if (requestedDisks.empty()) {
+        error = "No disk given";
+        return false;
+    }
+    std::vector<BlockDevice> devices = scanBlockDevices();
+    for (size_t i = 0; i < requestedDisks.size(); i++) {
+        const std::string& disk = requestedDisks[i];
+        if (std::none_of(devices.begin(), devices.end(), [&disk](const BlockDevice& device) { return device.path == disk; })) {
+            error = "Not an installable disk: " + disk;
+            return false;
+        }
+        if (std::find(requestedDisks.begin(), requestedDisks.begin() + i, disk) != requestedDisks.begin() + i) {
+            error = "Disk listed twice: " + disk;
+            return false;
+        }
+    }
+    std::string disk = requestedDisks[0];
+    std::string preset = answer("preset");
+    // Et gyllent image har forhåndsinnstillingen med seg
+    if (answer("image.replay").empty() && preset != "desktop" && preset != "htpc" && preset != "server") {
+        error = "Unknown preset: " + preset + " (expected desktop, htpc or server)";
+        return false;
+    }
+    if (!answer("image.capture").empty() && (!answer("image.replay").empty() || requestedDisks.size() > 1)) {
+        error = "image.capture needs a single disk and cannot be combined with image.replay";
+        return false;
+    }
+    std::string encryption = answer("encryption.enabled");
+    if (!encryption.empty() && encryption != "true" && encryption != "false") {
+        error = "encryption.enabled must be true or false";
+        return false;
+    }
+    AnswerSelection selection;
+    selection.disk = disk;
+    selection.imagingDisks = requestedDisks.size() > 1 ? requestedDisks : std::vector<std::string>();
+    selection.captureImageDir = answer("image.capture");
+    selection.replayImageDir = answer("image.replay");
+    selection.preset = preset;
+    selection.encryptionEnabled = encryption == "true";
+
+    for (const auto& field : textFields) {
+        selection.textValues.push_back(field.value);
+    }
+    for (const auto& field : dropdownFields) {
+        selection.dropdownIndices.push_back(field.selectedIndex);
+    }
+    for (const auto& [key, label] : ANSWER_FIELD_KEYS) {
+        std::string value = answer(key);
+        for (size_t i = 0; i < textFields.size(); i++) {
+            if (textFields[i].label == label) {
+                selection.textValues[i] = value;
+            }
+        }
+        for (size_t i = 0; i < dropdownFields.size(); i++) {
+            const DropdownField& field = dropdownFields[i];
+            if (field.label != label || value.empty()) {
+                continue;
+            }
+            auto option = std::find(field.options.begin(), field.options.end(), value);
+            if (option == field.options.end()) {
+                error = "Unknown " + key + ": " + value;
+                return false;
+            }
+            selection.dropdownIndices[i] = static_cast<int>(option - field.options.begin());
+        }
+    }
+    for (const char* key : { "user.hostname", "user.username", "user.password" }) {
+        if (answer(key).empty()) {
+            error = std::string("Missing ") + key;
+            return false;
+        }
+    }
+    if (selection.encryptionEnabled && answer("encryption.key").empty()) {
+        error = "encryption.enabled is true but encryption.key is empty";
+        return false;
+    }
+    for (const auto& [key, label] : ANSWER_FIELD_KEYS) {
+        ValidationResult result = validateField(fieldKindForLabel(label), answer(key));
+        if (result.validity == Validity::Invalid || result.validity == Validity::Incomplete) {
+            error = "Invalid " + key + " (" + result.message + "): " + answer(key);
+            return false;
+        }
+    }
+
+    selectedDisk = selection.disk;
+    imagingDisks = selection.imagingDisks;
+    captureImageDir = selection.captureImageDir;
+    replayImageDir = selection.replayImageDir;
+    selectedPreset = selection.preset;
+    encryptionEnabled = selection.encryptionEnabled;
+    for (size_t i = 0; i < textFields.size(); i++) {
+        setTextFieldValue(i, selection.textValues[i]);
+    }
+    for (size_t i = 0; i < dropdownFields.size(); i++) {
+        dropdownFields[i].selectedIndex = selection.dropdownIndices[i];
+    }
+    return true;
+}
+
+int runHeadlessInstall(const std::string& answersPath) {
+    std::map<std::string, std::string> answers;
+    std::string error;
+    if (!parseAnswerFile(answersPath, answers, error) || !applyAnswers(answers, error)) {
+        printHeadlessError(error);
+        return 2;
+    }
+    std::vector<std::string> installDisks = selectedInstallDisks();
+    std::cerr << "Headless install of " << (replayImageDir.empty() ? selectedPreset : replayImageDir) << " to "
+              << (installDisks.size() > 1 ? std::to_string(installDisks.size()) + " disks" : selectedDisk) << std::endl;
+    return runHeadlessPipeline(buildSelectedInstallSteps(), multiDiskParallelSteps(installDisks.size()));
+}
+
+void drawProfilerOverlay(SDL_Renderer* renderer, TTF_Font* font) {
+    std::vector<StageSummary> summaries = summarizeFrameStages();
+    SDL_Rect background = { MARGIN, MARGIN, 440, static_cast<int>(summaries.size() + 1) * 22 + 10 };
+    flushTextBatch(renderer);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderFillRect(renderer, &background);
+    countDrawCalls(1);
+
+    SDL_Color color = { 0, 255, 0, 255 };
+    int y = background.y + 5;
+    drawText(renderer, font, "stage           p50 ms   p99 ms   max ms", background.x + 10, y, color);
+    for (const auto& summary : summaries) {
+        y += 22;
+        char line[96];
+        snprintf(line, sizeof(line), "%-14s %7.2f  %7.2f  %7.2f", summary.name, summary.p50Ms, summary.p99Ms, summary.maxMs);
+        drawText(renderer, font, line, background.x + 10, y, color);
+    }
+}
+
+void toggleProfilerOverlay() {
+    profilerOverlayVisible = !profilerOverlayVisible;
+    setFrameProfilingEnabled(profilerOverlayVisible || profilingRequested);
+}
+
+WidgetTree* rowTreeForPage(int page) {
+    return page == 0 ? &diskTree : page == 1 ? &presetTree : nullptr;
+}
+
+// Én rad per disk eller forhåndsinnstilling; raden dekker både avkrysningsboksen og teksten.
+// En ny liste kan ha færre rader, så musepekerraden glemmes; neste musebevegelse finner den igjen.
+void buildRowTree(WidgetTree& tree, size_t rowCount, int rowHeight) {
+    if (hoveredRow >= 0 && rowTreeForPage(hoveredRowPage) == &tree) {
+        hoveredRow = -1;
+    }
+    initWidgetTree(tree, MENU_WIDTH + MARGIN, HEADER_HEIGHT + 70, WINDOW_WIDTH - MENU_WIDTH - 2 * MARGIN, 0);
+    for (size_t i = 0; i < rowCount; i++) {
+        addWidget(tree, 0, WidgetKind::Row, static_cast<int>(i), 0, rowHeight);
+    }
+}
+
+// "Your info": feltene under hverandre, med avkrysningsboksen for kryptering rett over
+// nøkkelfeltet. 40 px mellom widgetene gir plass til etiketten over hvert felt.
+void buildInfoTree() {
+    initWidgetTree(infoTree, MENU_WIDTH + MARGIN + 20, HEADER_HEIGHT + 120, WINDOW_WIDTH - MENU_WIDTH - 2 * MARGIN - 20, 40);
+    for (size_t i = 0; i < textFields.size(); i++) {
+        if (textFields[i].label == "Encryption Key") {
+            encryptionCheckboxWidget = addWidget(infoTree, 0, WidgetKind::Checkbox, 0, 250, BOX_SIZE);
+            encryptionKeyWidget = addWidget(infoTree, 0, WidgetKind::TextField, static_cast<int>(i), textFields[i].width, textFields[i].height);
+        } else {
+            addWidget(infoTree, 0, WidgetKind::TextField, static_cast<int>(i), textFields[i].width, textFields[i].height);
+        }
+    }
+    for (size_t i = 0; i < dropdownFields.size(); i++) {
+        addWidget(infoTree, 0, WidgetKind::Dropdown, static_cast<int>(i), dropdownFields[i].width, dropdownFields[i].height);
+    }
+}
+
+// Billig når ingenting er endret: layout og kopiering til feltene skjer bare etter endringer
+void layoutInfoPage() {
+    setWidgetVisible(infoTree, encryptionKeyWidget, encryptionEnabled);
+    if (!layoutWidgetTree(infoTree)) {
+        return;
+    }
+    for (size_t widget = 1; widget < infoTree.kinds.size(); widget++) {
+        const SDL_Rect& rect = widgetRect(infoTree, static_cast<int>(widget));
+        if (infoTree.kinds[widget] == WidgetKind::TextField) {
+            TextField& field = textFields[infoTree.payloads[widget]];
+            field.x = rect.x;
+            field.y = rect.y;
+        } else if (infoTree.kinds[widget] == WidgetKind::Dropdown) {
+            DropdownField& field = dropdownFields[infoTree.payloads[widget]];
+            field.x = rect.x;
+            field.y = rect.y;
+        }
+    }
+}
+
+void handleScrolling(SDL_Event& e) {
+    if (e.type == SDL_MOUSEWHEEL) {
+        if (e.wheel.y > 0) { // Scroll up
+            scrollOffset -= SCROLL_SPEED;
+            if (scrollOffset < 0) scrollOffset = 0;
+        } else if (e.wheel.y < 0) { // Scroll down
+            scrollOffset += SCROLL_SPEED;
+        }
+    }
+}
+
+bool updateAuthStatusAnimation(Uint32 currentTime) {
+    if (currentTime - lastAnimationTime > ANIMATION_INTERVAL_MS) {
+        animationFrame = (animationFrame + 1) % 4;
+        lastAnimationTime = currentTime;
+        return true;
+    }
+    return false;
+}
+
+bool eventChangesUi(const SDL_Event& e) {
+    switch (e.type) {
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEWHEEL:
+        case SDL_KEYDOWN:
+        case SDL_TEXTINPUT:
+        case SDL_WINDOWEVENT:
+        case SDL_RENDER_TARGETS_RESET:
+        case SDL_RENDER_DEVICE_RESET:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Skriving og sletting i et aktivt felt på "Your info" endrer bare feltet
+bool eventEditsActiveTextField(const SDL_Event& e) {
+    bool edit = e.type == SDL_TEXTINPUT || (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_BACKSPACE);
+    return edit && currentPage == 2 && std::any_of(textFields.begin(), textFields.end(), [](const TextField& field) { return field.active; });
+}
+
+// Feltet og resten av linjen til høyre, siden lang tekst tegnes forbi rammen
+SDL_Rect textFieldDamage(const TextField& field) {
+    return { field.x, field.y - scrollOffset, WINDOW_WIDTH - field.x, field.height + 1 };
+}
+
+SDL_Rect caretDamage() {
+    for (const auto& field : textFields) {
+        if (field.active) {
+            int caretX = 0;
+            caretPosition(getTextLayout(uiFont, field.value, false, 0), field.value.size(), &caretX, nullptr);
+            return { field.x + 5 + caretX - 1, field.y + 5 - scrollOffset, 3, field.height - 9 };
+        }
+    }
+    return { 0, 0, 0, 0 };
+}
+
+SDL_Rect authStatusDamage() {
+    return { WINDOW_WIDTH - 400, 50, 400, TTF_FontLineSkip(uiFont) };
+}
+
+void updateHoveredRow(int x, int y) {
+    WidgetTree* tree = rowTreeForPage(currentPage);
+    int row = tree != nullptr ? hitTestWidget(*tree, x, y) : -1;
+    if (row == hoveredRow && currentPage == hoveredRowPage) {
+        return;
+    }
+    // Den gamle raden er allerede borte fra skjermen hvis siden er byttet
+    if (hoveredRow >= 0 && hoveredRowPage == currentPage) {
+        requestRedrawRect(widgetRect(*tree, hoveredRow));
+    }
+    if (row >= 0) {
+        requestRedrawRect(widgetRect(*tree, row));
+    }
+    hoveredRow = row;
+    hoveredRowPage = currentPage;
+}
+
+void drawRowHover(SDL_Renderer* renderer, const SDL_Rect& rect, int row) {
+    if (row != hoveredRow || currentPage != hoveredRowPage) {
+        return;
+    }
+    flushTextBatch(renderer);
+    SDL_SetRenderDrawColor(renderer, 50, 50, 50, 255);
+    SDL_RenderFillRect(renderer, &rect);
+    countDrawCalls(1);
+}
+
+void drawClippedRect(SDL_Renderer* renderer, SDL_Rect& rect) {
+    flushTextBatch(renderer);
+    SDL_RenderSetClipRect(renderer, &rect);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderFillRect(renderer, &rect);
+    SDL_RenderSetClipRect(renderer, nullptr);
+}
+
+void notifyDiskPage() {
+    // Før initInstallerUi: initInstallerUi leser listen selv når UI-et er klart
+    Uint32 type = diskInventoryEvent.load();
+    if (type == 0) {
+        return;
+    }
+    SDL_Event event = {};
+    event.type = type;
+    SDL_PushEvent(&event);
+}
+
+// Samme hendelse brukes for nye disker og ferdige lesetester; allerede testede disker køes ikke på nytt
+void onDiskInventoryChanged() {
+    refreshDiskPage(pages[0], disks);
+    std::vector<std::string> paths;
+    for (const auto& device : getDiskInventory()) {
+        paths.push_back(device.path);
+    }
+    if (uiOptions.probeDisks) {
+        queueStorageProbes(paths, notifyDiskPage);
+    }
+}
+
+void startInstallerBackgroundWork(const InstallerUiOptions& options) {
+    startDiskInventory(options.sysRoot, notifyDiskPage);
+}
+
+bool initInstallerUi(SDL_Renderer* renderer, TTF_Font* font, const InstallerUiOptions& options) {
+    uiRenderer = renderer;
+    uiFont = font;
+    uiOptions = options;
+    currentPage = -1;
+    quitRequested = false;
+
+    if (!initGlyphAtlas(renderer, font)) {
+        std::cerr << "Glyph atlas unavailable, falling back to per-string text textures" << std::endl;
+    }
+
+    // Velkomstside
+    welcomePage.title = "Welcome to NixumOS";
+    welcomePage.content = "NixumOS is a project to make Linux more mainstream and simple. "
+                          "NixumOS is based entirely on the Nix ecosystem where everything "
+                          "you do - every program or setting, is stored in your own private "
+                          "repository on GitHub. This makes your system 100% reproducible, "
+                          "which makes your system completely reliable.";
+
+    // De fire sidene
+    pages.assign(4, Page());
+    pages[0].title = "Select Drive";
+    pages[1].title = "Select preset";
+    buildRowTree(presetTree, PRESETS.size(), LINE_HEIGHT);
+    pages[1].content = "1. Desktop\n2. HTPC\n3. Server";
+    pages[2].title = "Your info";
+    buildInfoTree();
+    resetFieldValidators();
+    pages[2].content = "Fill in your details:";
+    pages[3].title = "Install";
+    pages[3].content = "Ready to install NixumOS.";
+
+    if (const char* trace = getenv("NIXUM_TRACE")) {
+        traceExportPath = trace;
+    }
+    const char* profile = getenv("NIXUM_PROFILE");
+    profilingRequested = !traceExportPath.empty() || (profile != nullptr && std::string(profile) == "1");
+    setFrameProfilingEnabled(profilingRequested);
+
+    // Hendelsen registreres før listen leses, så en skanning som blir ferdig imellom ikke går tapt.
+    // Ingen kø-hendelse hvis startInstallerBackgroundWork allerede har startet skanningen.
+    Uint32 events = SDL_RegisterEvents(2);
+    installEvent = events + 1;
+    diskInventoryEvent = events;
+    startDiskInventory(options.sysRoot, notifyDiskPage);
+    onDiskInventoryChanged();
+    return true;
+}
+
+bool handleInstallerEvent(SDL_Event& e) {
+    if (eventChangesUi(e) && !eventEditsActiveTextField(e)) {
+        requestRedraw();
+    }
+    if (e.type == SDL_QUIT) {
+        quitRequested = true;
+    } else if (e.type == installEvent) {
+        drainInstallEvents();
+        requestRedraw();
+    } else if (e.type == diskInventoryEvent) {
+        onDiskInventoryChanged();
+        requestRedraw();
+    } else if (e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET) {
+        // Innholdet i texturene kan være borte; teksttexturene og atlaset lages på nytt
+        invalidateChrome();
+        clearTextCache();
+        if (!initGlyphAtlas(uiRenderer, uiFont)) {
+            std::cerr << "Glyph atlas unavailable after render reset, falling back to per-string text textures" << std::endl;
+        }
+    } else if (e.type == SDL_MOUSEBUTTONDOWN) {
+        int x = e.button.x;
+        int y = e.button.y;
+        std::cerr << "Mouse click at (" << x << ", " << y << ")" << std::endl;
+        if (x > WINDOW_WIDTH - 50 && y < 50) {
+            quitRequested = true;
+        }
+        if (x > WINDOW_WIDTH - 150 && y > WINDOW_HEIGHT - 100 && y < WINDOW_HEIGHT - 50) {
+            if (currentPage == -1) {
+                std::cerr << "Transition from welcome page to Select Drive" << std::endl;
+                currentPage = 0;
+            } else if (currentPage < static_cast<int>(pages.size()) - 1) {
+                currentPage++;
+                std::cerr << "Transition to page " << currentPage << std::endl;
+            } else if (currentPage == static_cast<int>(pages.size()) - 1) {
+                startInstall();
+            }
+        }
+        if (x > 50 && x < 150 && y > WINDOW_HEIGHT - 100 && y < WINDOW_HEIGHT - 50) {
+            if (currentPage > 0) {
+                currentPage--;
+                std::cerr << "Transition to previous page " << currentPage << std::endl;
+            }
+        }
+        if (x > MARGIN && x < MENU_WIDTH - MARGIN) {
+            int index = (y - (HEADER_HEIGHT + 40)) / 60;
+            if (index >= 0 && index < static_cast<int>(pages.size())) {
+                currentPage = index;
+            }
+        }
+        if (currentPage == 0) {
+            int hit = hitTestWidget(diskTree, x, y);
+            if (hit >= 0) {
+                const std::string& disk = disks[diskTree.payloads[hit]];
+                selectedDisk = disk.substr(0, disk.find(" - Size:"));
+                imagingDisks.clear();
+                std::cerr << "Selected disk: " << selectedDisk << std::endl;
+            }
+        }
+        if (currentPage == 1) {
+            int hit = hitTestWidget(presetTree, x, y);
+            if (hit >= 0) {
+                selectedPreset = PRESETS[presetTree.payloads[hit]];
+                std::cerr << "Selected preset: " << selectedPreset << std::endl;
+            }
+        }
+        if (currentPage == 2) {
+            // Klikk utenfor alle felt deaktiverer dem
+            int hit = hitTestWidget(infoTree, x, y + scrollOffset);
+            WidgetKind kind = hit >= 0 ? infoTree.kinds[hit] : WidgetKind::Container;
+            int payload = hit >= 0 ? infoTree.payloads[hit] : -1;
+            for (size_t i = 0; i < textFields.size(); i++) {
+                textFields[i].active = kind == WidgetKind::TextField && payload == static_cast<int>(i);
+            }
+            for (size_t i = 0; i < dropdownFields.size(); i++) {
+                dropdownFields[i].active = kind == WidgetKind::Dropdown && payload == static_cast<int>(i);
+            }
+            if (kind == WidgetKind::Checkbox) {
+                encryptionEnabled = !encryptionEnabled;
+                setWidgetVisible(infoTree, encryptionKeyWidget, encryptionEnabled);
+            }
+        }
+    } else if (e.type == SDL_MOUSEMOTION) {
+        updateHoveredRow(e.motion.x, e.motion.y);
+    } else if (e.type == SDL_TEXTINPUT) {
+        for (size_t i = 0; i < textFields.size(); i++) {
+            TextField& field = textFields[i];
+            if (field.active) {
+                forgetTextFieldValue(field);
+                field.value += e.text.text;
+                validatorAppend(fieldValidators[i], e.text.text);
+                requestRedrawRect(textFieldDamage(field));
+            }
+        }
+    } else if (e.type == SDL_KEYDOWN) {
+        if (e.key.keysym.sym == SDLK_BACKSPACE) {
+            for (size_t i = 0; i < textFields.size(); i++) {
+                TextField& field = textFields[i];
+                if (field.active && !field.value.empty()) {
+                    forgetTextFieldValue(field);
+                    field.value.pop_back();
+                    validatorBackspace(fieldValidators[i]);
+                    requestRedrawRect(textFieldDamage(field));
+                }
+            }
+        } else if (e.key.keysym.sym == SDLK_TAB) {
+            for (size_t i = 0; i < textFields.size(); ++i) {
+                if (textFields[i].active) {
+                    textFields[i].active = false;
+                    textFields[(i + 1) % textFields.size()].active = true;
+                    break;
+                }
+            }
+        } else if (e.key.keysym.sym == SDLK_DOWN) {
+            for (auto& field : dropdownFields) {
+                if (field.active) {
+                    field.selectedIndex = (field.selectedIndex + 1) % field.options.size();
+                }
+            }
+        } else if (e.key.keysym.sym == SDLK_UP) {
+            for (auto& field : dropdownFields) {
+                if (field.active) {
+                    field.selectedIndex = (field.selectedIndex - 1 + field.options.size()) % field.options.size();
+                }
+            }
+        } else if (e.key.keysym.sym == SDLK_F12 && (e.key.keysym.mod & KMOD_CTRL)) {
+            writeChromeTrace(traceExportPath.empty() ? "/tmp/nixum-trace.json" : traceExportPath);
+        } else if (e.key.keysym.sym == SDLK_F12) {
+            toggleProfilerOverlay();
+        }
+    }
+
+    handleScrolling(e);
+    return !quitRequested;
+}
+
+void updateInstallerTimers(Uint32 currentTime) {
+    if (updateAuthStatusAnimation(currentTime)) {
+        requestRedrawRect(authStatusDamage());
+    }
+    scheduleWakeupAt(lastAnimationTime + ANIMATION_INTERVAL_MS + 1);
+
+    // Markøren blinker kun når et tekstfelt er aktivt på "Your info"
+    cursorVisible = currentTime / CURSOR_BLINK_MS % 2 == 0;
+    bool cursorBlinking = currentPage == 2 && std::any_of(textFields.begin(), textFields.end(), [](const TextField& field) { return field.active; });
+    if (cursorBlinking) {
+        if (cursorVisible != lastCursorVisible) {
+            requestRedrawRect(caretDamage());
+        }
+        scheduleWakeupAt((currentTime / CURSOR_BLINK_MS + 1) * CURSOR_BLINK_MS);
+    }
+    lastCursorVisible = cursorVisible;
+}
+
+void renderInstallerFrame() {
+    SDL_Renderer* renderer = uiRenderer;
+    TTF_Font* font = uiFont;
+    uint64_t frameStart = profileStart();
+    takeFrameDamage(WINDOW_WIDTH, WINDOW_HEIGHT, frameDamage);
+
+    {
+        ProfileScope scope(FrameStage::Layout);
+        layoutInfoPage();
+        layoutWidgetTree(diskTree);
+        layoutWidgetTree(presetTree);
+    }
+    if (softwarePresentWindow == nullptr) {
+        drawFrame(renderer, font);
+        countPixelsDrawn(static_cast<Uint64>(WINDOW_WIDTH) * WINDOW_HEIGHT);
+        ProfileScope scope(FrameStage::Present);
+        SDL_RenderPresent(renderer);
+    } else if (!frameDamage.empty()) {
+        // Én tegning klippet til rektangelet rundt all skaden; resten av overflaten har fortsatt
+        // forrige frame. Det som tegnes på nytt mellom de skadde områdene er uendret, så bare
+        // områdene selv sendes til skjermen.
+        drawBounds = frameDamage[0];
+        for (const auto& rect : frameDamage) {
+            SDL_UnionRect(&drawBounds, &rect, &drawBounds);
+        }
+        SDL_RenderSetClipRect(renderer, &drawBounds);
+        drawFrame(renderer, font);
+        countPixelsDrawn(static_cast<Uint64>(drawBounds.w) * drawBounds.h);
+        SDL_RenderSetClipRect(renderer, nullptr);
+        drawBounds = { 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT };
+        ProfileScope scope(FrameStage::Present);
+        if (SDL_UpdateWindowSurfaceRects(softwarePresentWindow, frameDamage.data(), static_cast<int>(frameDamage.size())) != 0) {
+            std::cerr << "SDL_UpdateWindowSurfaceRects Error: " << SDL_GetError() << std::endl;
+        }
+    }
+    profileEnd(FrameStage::Frame, frameStart);
+}
+
+void setSoftwarePresentWindow(SDL_Window* window) {
+    softwarePresentWindow = window;
+    requestRedraw();
+}
+
+bool insideDrawBounds(const SDL_Rect& rect) {
+    return SDL_HasIntersection(&rect, &drawBounds) == SDL_TRUE;
+}
+
+// Et felt med etiketten over og teksten (eller valideringsmeldingen) ut mot høyre kant, i vinduskoordinater
+SDL_Rect labeledFieldBounds(int x, int y, int height) {
+    return { x, y - 25 - scrollOffset, WINDOW_WIDTH - x, height + 26 };
+}
+
+// Alt som tegnes i én frame, uten presentasjon. Med programvaretegning er bare drawBounds skadd,
+// så rader og felt utenfor hoppes over.
+void drawFrame(SDL_Renderer* renderer, TTF_Font* font) {
+    std::string animatedAuthStatus = authStatus;
+    for (int i = 0; i < animationFrame; ++i) {
+        animatedAuthStatus += ".";
+    }
+
+    {
+        ProfileScope scope(FrameStage::Chrome);
+        drawChrome(renderer, font, currentPage > 0);
+    }
+    {
+        ProfileScope scope(FrameStage::Menu);
+        drawMenu(renderer, font, currentPage);
+    }
+    drawText(renderer, font, animatedAuthStatus, WINDOW_WIDTH - 400, 50, { 255, 255, 255, 255 });
+
+    uint64_t pageStart = profileStart();
+    if (currentPage == -1) {
+        drawPage(renderer, font, welcomePage);
+    } else if (currentPage == 0) {
+        for (int row : diskTree.children[0]) {
+            const SDL_Rect& rect = widgetRect(diskTree, row);
+            if (!insideDrawBounds(rect)) {
+                continue;
+            }
+            drawRowHover(renderer, rect, row);
+            const std::string& disk = disks[diskTree.payloads[row]];
+            drawCheckbox(renderer, rect.x, rect.y, selectedDisk == disk.substr(0, disk.find(" - Size:")));
+            drawText(renderer, font, disk, rect.x + BOX_SIZE + 10, rect.y, { 255, 255, 255, 255 });
+            drawText(renderer, font, diskProbeLines[diskTree.payloads[row]], rect.x + BOX_SIZE + 10, rect.y + LINE_HEIGHT, { 200, 200, 200, 255 });
+        }
+        const SDL_Rect& list = widgetRect(diskTree, 0);
+        drawText(renderer, font, describeSelectedDiskProbe(), list.x, list.y + list.h + 20, { 200, 200, 200, 255 }, false, list.w);
+    } else if (currentPage == 1) {
+        for (int row : presetTree.children[0]) {
+            const SDL_Rect& rect = widgetRect(presetTree, row);
+            if (!insideDrawBounds(rect)) {
+                continue;
+            }
+            drawRowHover(renderer, rect, row);
+            const std::string& preset = PRESETS[presetTree.payloads[row]];
+            drawCheckbox(renderer, rect.x, rect.y, selectedPreset == preset);
+            drawText(renderer, font, preset, rect.x + BOX_SIZE + 10, rect.y, { 255, 255, 255, 255 });
+        }
+    } else if (currentPage == 2) {
+        drawText(renderer, font, "Your info", MENU_WIDTH + MARGIN, HEADER_HEIGHT + 20 - scrollOffset, { 255, 255, 255, 255 }, true);
+        drawText(renderer, font, "Fill in your details:", MENU_WIDTH + MARGIN, HEADER_HEIGHT + 60 - scrollOffset, { 255, 255, 255, 255 });
+        for (size_t i = 0; i < textFields.size(); i++) {
+            TextField& field = textFields[i];
+            if ((field.label == "Encryption Key" && !encryptionEnabled) || !insideDrawBounds(labeledFieldBounds(field.x, field.y, field.height))) {
+                continue;
+            }
+            drawTextField(renderer, font, field, scrollOffset, cursorVisible);
+            drawFieldValidation(renderer, font, field, fieldValidators[i], scrollOffset);
+        }
+        for (auto& field : dropdownFields) {
+            if (insideDrawBounds(labeledFieldBounds(field.x, field.y, field.height))) {
+                drawDropdownField(renderer, font, field, scrollOffset);
+            }
+        }
+        const SDL_Rect& encryptionCheckbox = widgetRect(infoTree, encryptionCheckboxWidget);
+        drawCheckbox(renderer, encryptionCheckbox.x, encryptionCheckbox.y - scrollOffset, encryptionEnabled);
+        drawText(renderer, font, "Enable Encryption", encryptionCheckbox.x + BOX_SIZE + 10, encryptionCheckbox.y - scrollOffset, { 255, 255, 255, 255 });
+    } else {
+        drawPage(renderer, font, pages[currentPage]);
+        if (currentPage == static_cast<int>(pages.size()) - 1) {
+            drawInstallProgress(renderer, font);
+        }
+    }
+
+    drawText(renderer, font, (currentPage == -1 ? "Let's begin!" : (currentPage == static_cast<int>(pages.size()) - 1 ? "Let's Install" : "Next")), WINDOW_WIDTH - 140, WINDOW_HEIGHT - 90, { 255, 255, 255, 255 });
+    profileEnd(FrameStage::Page, pageStart);
+
+    {
+        ProfileScope scope(FrameStage::TextFlush);
+        flushTextBatch(renderer);
+    }
+    // Overlayet tegnes over den ferdige framen, med egen flush for teksten sin
+    if (profilerOverlayVisible) {
+        ProfileScope scope(FrameStage::Overlay);
+        drawProfilerOverlay(renderer, font);
+        flushTextBatch(renderer);
+    }
+}
+
+void shutdownInstallerUi() {
+    stopDiskInventory();
+    stopStorageProbes();
+    if (installPipelineRunning()) {
+        std::cerr << "Waiting for the install to finish..." << std::endl;
+    }
+    joinInstallPipeline();
+    printRedrawStats();
+    printTextCacheStats();
+    printTextLayoutStats();
+    if (!traceExportPath.empty()) {
+        writeChromeTrace(traceExportPath);
+    }
+    clearTextCache();
+    clearTextLayoutCache();
+    invalidateChrome();
+    destroyGlyphAtlas();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+#include <map>
+#include <string>
+
+// Installasjonsveiviseren: sidene, feltene, hendelseshåndteringen og tegningen av én frame.
+// Hovedløkken (og vindu, renderer og font) eies av den som kaller, slik at nixum_install og
+// nixum_bench kjører nøyaktig samme UI-kode.
+
+const int WINDOW_WIDTH = 1000;
+const int WINDOW_HEIGHT = 900;
+
+struct InstallerUiOptions {
+    std::string sysRoot = "/sys";
+    bool probeDisks = true; // Lesetest av diskene i bakgrunnen (se storage_probe.h)
+};
+
+// Åpner fonten som er lagt inn i binærfilen (embedded_font.h)
+TTF_Font* loadEmbeddedFont(int fontSize);
+
+// Starter diskskanningen før SDL er initialisert, slik at den går parallelt med vindusoppsettet.
+// Valgfri: initInstallerUi starter den selv hvis den ikke kjører.
+void startInstallerBackgroundWork(const InstallerUiOptions& options = InstallerUiOptions());
+
+// Bygger sidene, starter diskskanningen og glyfatlaset
+bool initInstallerUi(SDL_Renderer* renderer, TTF_Font* font, const InstallerUiOptions& options = InstallerUiOptions());
+
+// Behandler én hendelse. Returnerer false når brukeren har bedt om å avslutte.
+bool handleInstallerEvent(SDL_Event& e);
+
+// Animasjon og markørblink: ber om ny frame og setter neste oppvåkning ved behov
+void updateInstallerTimers(Uint32 currentTime);
+
+// Tegner og presenterer én frame av gjeldende side
+void renderInstallerFrame();
+
+// Programvaretegning for maskiner uten GPU: rendereren er laget med SDL_CreateSoftwareRenderer på
+// SDL_GetWindowSurface(window). Da tegnes bare områdene som er endret siden forrige frame, og de
+// presenteres med SDL_UpdateWindowSurfaceRects.
+void setSoftwarePresentWindow(SDL_Window* window);
+
+// Stopper bakgrunnsarbeid, venter på en pågående installasjon og frigjør texturene
+void shutdownInstallerUi();
+
+// Svarfil (se headless_install.h): fyller sidene, eller kjører hele installasjonen uten SDL
+bool applyAnswers(const std::map<std::string, std::string>& answers, std::string& error);
+int runHeadlessInstall(const std::string& answersPath);
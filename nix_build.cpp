@@ -0,0 +1,404 @@
+#include "nix_build.h"
+#include "install_pipeline.h"
+#include "preset_fetch.h"
+#include "util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+namespace {
+
+const char* NIX_LOG_PREFIX = "@nix ";
+// Aktivitetslinjene sendes høyst så ofte, så en stor lukning ikke fyller ringbufferen
+const double ACTIVITY_REPORT_INTERVAL_SECONDS = 0.5;
+
+// /nix/store/<hash>-navn[.drv] -> navn
+std::string storePathName(const std::string& path) {
+    std::string name = path.substr(path.rfind('/') + 1);
+    size_t dash = name.find('-');
+    if (dash != std::string::npos) {
+        name = name.substr(dash + 1);
+    }
+    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".drv") == 0) {
+        name.resize(name.size() - 4);
+    }
+    return name;
+}
+
+// Fjerner ANSI-fargekoder fra Nix' meldinger
+std::string stripAnsi(const std::string& text) {
+    std::string out;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '\x1b' && i + 1 < text.size() && text[i + 1] == '[') {
+            i += 2;
+            while (i < text.size() && !(text[i] >= '@' && text[i] <= '~')) {
+                i++;
+            }
+        } else {
+            out += text[i];
+        }
+    }
+    return out;
+}
+
+// Kopierer flaken og alle inndataene dens inn i målets store og gir stien til kopien av flaken
+// ("path" på toppnivå; inndataene har sine egne under "inputs")
+bool archivePresetFlake(const std::string& targetRoot, const std::string& checkoutDir, const std::string& nixConfig,
+                        std::string& storePath) {
+    std::string command = nixConfig + "nix --extra-experimental-features 'nix-command flakes' flake archive --json --to " +
+                          shellQuote("local?root=" + targetRoot) + " " + shellQuote(presetFlakeReference(checkoutDir));
+    std::string output;
+    if (!captureLines(command, [&output](const std::string& line) { output += line + "\n"; })) {
+        return false;
+    }
+    JsonReader reader = { output, 0 };
+    storePath.clear();
+    bool ok = reader.readObject([&](const std::string& key) {
+        return key == "path" ? reader.readString(storePath) : reader.skipValue();
+    });
+    return ok && !storePath.empty();
+}
+
+bool writeTargetFlake(const std::string& targetRoot, const std::string& presetSource, const std::string& preset) {
+    std::string dir = targetRoot + TARGET_FLAKE_DIR;
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    // Låsefilen hører til forrige kilde, f.eks. fra "Copy config" ved flere disker
+    std::filesystem::remove(dir + "/flake.lock", ec);
+    std::ofstream out(dir + "/flake.nix");
+    out << "# Written by nixum_install. The preset is a copy in this system's Nix store, so the system can be\n"
+        << "# rebuilt without network access: nixos-rebuild switch --flake /etc/nixos#" << TARGET_FLAKE_CONFIGURATION << "\n"
+        << "{\n"
+        << "  inputs.preset.url = \"path:" << presetSource << "\";\n"
+        << "  outputs = { preset, ... }: {\n"
+        << "    nixosConfigurations." << TARGET_FLAKE_CONFIGURATION << " =\n"
+        << "      let\n"
+        << "        system = preset.nixosConfigurations.\"" << preset << "\";\n"
+        << "        machine = builtins.filter builtins.pathExists [ ./hardware-configuration.nix ./machine.nix ];\n"
+        << "      in if machine == [ ] then system else system.extendModules { modules = machine; };\n"
+        << "  };\n"
+        << "}\n";
+    out.close();
+    return static_cast<bool>(out);
+}
+
+} // namespace
+
+BuildHardware readBuildHardware() {
+    BuildHardware hardware;
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    unsigned cpus = 0;
+    while (std::getline(cpuinfo, line)) {
+        if (line.compare(0, 9, "processor") == 0) {
+            cpus++;
+        }
+    }
+    hardware.cpus = std::max(1u, cpus);
+
+    std::ifstream meminfo("/proc/meminfo");
+    while (std::getline(meminfo, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        uint64_t kibibytes = 0;
+        fields >> key >> kibibytes;
+        if (key == "MemTotal:") {
+            hardware.memoryTotalBytes = kibibytes * 1024;
+        } else if (key == "MemAvailable:") {
+            hardware.memoryAvailableBytes = kibibytes * 1024;
+        }
+    }
+
+    std::ifstream mounts("/proc/mounts");
+    while (std::getline(mounts, line)) {
+        std::istringstream fields(line);
+        std::string device, mountPoint, type;
+        fields >> device >> mountPoint >> type;
+        if ((mountPoint == "/" || mountPoint == "/nix/.rw-store") && type == "tmpfs") {
+            hardware.ramBackedRoot = true;
+        }
+    }
+    return hardware;
+}
+
+NixBuildTuning tuneNixBuild(const BuildHardware& hardware, unsigned concurrentBuilds) {
+    unsigned builds = std::max(1u, concurrentBuilds);
+    unsigned cpus = std::max(1u, hardware.cpus / builds);
+    // Byggekataloger og nedlastinger havner i RAM på live-systemet, så en del holdes igjen
+    uint64_t reserve = hardware.ramBackedRoot ? LIVE_SYSTEM_RESERVE_BYTES : 0;
+    uint64_t memory = hardware.memoryAvailableBytes > reserve ? (hardware.memoryAvailableBytes - reserve) / builds : 0;
+
+    NixBuildTuning tuning;
+    uint64_t jobsByMemory = memory / NIX_BUILD_JOB_MEMORY_BYTES;
+    tuning.maxJobs = static_cast<unsigned>(std::max<uint64_t>(1, std::min<uint64_t>({ cpus, jobsByMemory, NIX_MAX_BUILD_JOBS })));
+    tuning.cores = std::max(1u, cpus / tuning.maxJobs);
+    // Nedlastingene venter mest på nettet, men hver utpakking holder en NAR-bit i minnet
+    uint64_t substitutionsByMemory = memory / NIX_SUBSTITUTION_JOB_MEMORY_BYTES;
+    tuning.substitutionJobs = static_cast<unsigned>(std::clamp<uint64_t>(std::min<uint64_t>(substitutionsByMemory, cpus * 4ull), 4, 32));
+    tuning.httpConnections = std::max(25u, tuning.substitutionJobs * 2);
+    return tuning;
+}
+
+std::string nixBuildConfig(const NixBuildTuning& tuning, const std::string& substituters) {
+    return "max-jobs = " + std::to_string(tuning.maxJobs) + "\n"
+           "cores = " + std::to_string(tuning.cores) + "\n"
+           "http-connections = " + std::to_string(tuning.httpConnections) + "\n"
+           "max-substitution-jobs = " + std::to_string(tuning.substitutionJobs) + "\n"
+           "substituters = " + substituters + "\n";
+}
+
+std::string describeNixBuildTuning(const BuildHardware& hardware, const NixBuildTuning& tuning) {
+    char text[200];
+    snprintf(text, sizeof(text), "Build settings: max-jobs %u, cores %u, %u downloads (%u CPUs, %.1f of %.1f GiB available%s)", tuning.maxJobs,
+             tuning.cores, tuning.substitutionJobs, hardware.cpus, hardware.memoryAvailableBytes / (1024.0 * 1024.0 * 1024.0),
+             hardware.memoryTotalBytes / (1024.0 * 1024.0 * 1024.0), hardware.ramBackedRoot ? ", RAM-backed live system" : "");
+    return text;
+}
+
+bool parseNixLogLine(const std::string& line, NixLogEntry& entry) {
+    if (line.compare(0, strlen(NIX_LOG_PREFIX), NIX_LOG_PREFIX) != 0) {
+        return false;
+    }
+    JsonReader reader = { line, strlen(NIX_LOG_PREFIX) };
+    entry = NixLogEntry();
+    return reader.readObject([&](const std::string& key) {
+        if (key == "fields") {
+            return reader.readList(entry.fields);
+        }
+        std::string value;
+        if (!reader.readValue(value)) {
+            return false;
+        }
+        if (key == "action") {
+            entry.action = value;
+        } else if (key == "id") {
+            entry.id = strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "parent") {
+            entry.parent = strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "type") {
+            entry.type = atoi(value.c_str());
+        } else if (key == "level") {
+            entry.level = atoi(value.c_str());
+        } else if (key == "text" || key == "msg") {
+            entry.text = value;
+        }
+        return true;
+    });
+}
+
+void applyNixLogEntry(const NixLogEntry& entry, double nowSeconds, NixBuildProgress& progress) {
+    if (entry.action == "start") {
+        NixBuildActivity activity;
+        activity.type = entry.type;
+        activity.parent = entry.parent;
+        activity.startSeconds = nowSeconds;
+        if (!entry.fields.empty() && (entry.type == NixActivityBuild || entry.type == NixActivitySubstitute || entry.type == NixActivityCopyPath)) {
+            activity.name = storePathName(entry.fields[0]);
+        }
+        progress.activities[entry.id] = activity;
+    } else if (entry.action == "stop") {
+        progress.activities.erase(entry.id);
+    } else if (entry.action == "result") {
+        auto found = progress.activities.find(entry.id);
+        if (found == progress.activities.end()) {
+            return;
+        }
+        NixBuildActivity& activity = found->second;
+        if (entry.type == NixResultSetPhase && !entry.fields.empty()) {
+            activity.phase = entry.fields[0];
+        } else if (entry.type == NixResultProgress && entry.fields.size() >= 2) {
+            uint64_t done = strtoull(entry.fields[0].c_str(), nullptr, 10);
+            uint64_t expected = strtoull(entry.fields[1].c_str(), nullptr, 10);
+            switch (activity.type) {
+                case NixActivityBuilds:
+                    progress.buildsDone = done;
+                    progress.buildsExpected = expected;
+                    break;
+                case NixActivityCopyPaths:
+                    progress.pathsDone = done;
+                    progress.pathsExpected = expected;
+                    break;
+                case NixActivityFileTransfer:
+                case NixActivityCopyPath: {
+                    activity.bytesDone = done;
+                    activity.bytesExpected = expected;
+                    // Nedlastingen er et barn av substitusjonen, som er den som vises
+                    auto parent = progress.activities.find(activity.parent);
+                    if (parent != progress.activities.end() && parent->second.type == NixActivitySubstitute) {
+                        parent->second.bytesDone = done;
+                        parent->second.bytesExpected = expected;
+                    }
+                    break;
+                }
+            }
+        }
+    } else if (entry.action == "msg" && entry.level <= 1) {
+        // Nivå 0 og 1 er feil og advarsler; feilmeldingene har de siste byggelinjene med
+        std::istringstream lines(stripAnsi(entry.text));
+        std::string line;
+        while (std::getline(lines, line)) {
+            if (!line.empty()) {
+                progress.messages.push_back(line);
+            }
+        }
+    }
+}
+
+std::string targetFlakeReference(const std::string& targetRoot) {
+    return "path:" + targetRoot + TARGET_FLAKE_DIR;
+}
+
+bool checkTargetFilesystems(const std::string& targetRoot, const NixBuildLog& log) {
+    std::string attribute = targetFlakeReference(targetRoot) + "#nixosConfigurations." + TARGET_FLAKE_CONFIGURATION + ".config.fileSystems";
+    std::string json;
+    bool evaluated = captureLines("nix --extra-experimental-features 'nix-command flakes' eval --json --store " +
+                                  shellQuote("local?root=" + targetRoot) + " " + shellQuote(attribute) +
+                                  " --apply 'fs: builtins.mapAttrs (name: value: value.device or \"\") fs'",
+                                  [&json](const std::string& line) { json += line + "\n"; });
+    std::map<std::string, std::string> devices;
+    JsonReader reader = { json, 0 };
+    if (!evaluated || !reader.readObject([&](const std::string& mountPoint) { return reader.readString(devices[mountPoint]); })) {
+        log("Cannot evaluate the file systems in " + attribute);
+        return false;
+    }
+    for (const char* mountPoint : { "/", "/boot" }) {
+        std::string path = targetRoot + (std::string(mountPoint) == "/" ? "" : mountPoint);
+        std::vector<std::string> uuid;
+        if (!captureLines("findmnt -n -o UUID --mountpoint " + shellQuote(path), uuid) || uuid.empty()) {
+            log("Cannot read the file system UUID of " + path);
+            return false;
+        }
+        std::string expected = "/dev/disk/by-uuid/" + uuid[0];
+        if (devices[mountPoint] != expected) {
+            log("The system would mount " + (devices[mountPoint].empty() ? std::string("nothing") : devices[mountPoint]) + " on " +
+                mountPoint + ", but this disk has " + expected);
+            return false;
+        }
+    }
+    log("The system mounts this disk's own file systems on / and /boot");
+    return true;
+}
+
+std::string describeNixActivity(const NixBuildActivity& activity, double nowSeconds) {
+    double seconds = std::max(0.0, nowSeconds - activity.startSeconds);
+    char text[160];
+    if (activity.type == NixActivityBuild) {
+        snprintf(text, sizeof(text), "building %s (%s%.0f s)", activity.name.c_str(),
+                 activity.phase.empty() ? "" : (activity.phase + ", ").c_str(), seconds);
+        return text;
+    }
+    if (activity.type == NixActivitySubstitute) {
+        if (activity.bytesExpected == 0) {
+            return "fetching " + activity.name;
+        }
+        double mibPerSecond = activity.bytesDone / (1024.0 * 1024.0) / std::max(seconds, 0.1);
+        snprintf(text, sizeof(text), "fetching %s: %.1f/%s at %.1f MiB/s", activity.name.c_str(), activity.bytesDone / (1024.0 * 1024.0),
+                 mebibytes(activity.bytesExpected).c_str(), mibPerSecond);
+        return text;
+    }
+    return "";
+}
+
+bool buildAndInstallSystem(const std::string& targetRoot, const std::string& checkoutDir, const std::string& preset,
+                           const std::string& substituters, unsigned concurrentBuilds, const NixBuildLog& log) {
+    BuildHardware hardware = readBuildHardware();
+    NixBuildTuning tuning = tuneNixBuild(hardware, concurrentBuilds);
+    log(describeNixBuildTuning(hardware, tuning));
+    // Live-systemets nix.conf ligger i storen og kan ikke skrives. Innstillingene gis hver kommando
+    // med env i stedet for setenv, som ville rørt environ mens andre steg starter prosesser.
+    std::string nixConfig = "env NIX_CONFIG=" + shellQuote(nixBuildConfig(tuning, substituters)) + " ";
+
+    std::string presetSource;
+    if (!archivePresetFlake(targetRoot, checkoutDir, nixConfig, presetSource) || !writeTargetFlake(targetRoot, presetSource, preset)) {
+        log("Cannot write " + targetRoot + TARGET_FLAKE_DIR + "/flake.nix for " + checkoutDir);
+        return false;
+    }
+    log("Building from " + targetFlakeReference(targetRoot) + " (preset copied to " + presetSource + ")");
+
+    std::string attribute = targetFlakeReference(targetRoot) + "#nixosConfigurations." + TARGET_FLAKE_CONFIGURATION +
+                            ".config.system.build.toplevel";
+    std::string command = nixConfig + "nix --extra-experimental-features 'nix-command flakes' build --no-link --print-out-paths"
+                          " --log-format internal-json -v --store " + shellQuote("local?root=" + targetRoot) + " " +
+                          shellQuote(attribute);
+
+    auto start = std::chrono::steady_clock::now();
+    auto now = [&start]() { return secondsSince(start); };
+    NixBuildProgress progress;
+    std::map<uint64_t, std::string> reported; // Aktivitetslinjene UI-et har fått
+    double lastReport = -ACTIVITY_REPORT_INTERVAL_SECONDS;
+    std::string systemPath;
+
+    auto report = [&](bool force) {
+        double seconds = now();
+        if (!force && seconds - lastReport < ACTIVITY_REPORT_INTERVAL_SECONDS) {
+            return;
+        }
+        lastReport = seconds;
+        for (const auto& message : progress.messages) {
+            log(message);
+        }
+        progress.messages.clear();
+        std::set<uint64_t> visible;
+        for (const auto& [id, activity] : progress.activities) {
+            std::string description = describeNixActivity(activity, seconds);
+            if (description.empty()) {
+                continue;
+            }
+            visible.insert(id);
+            if (reported[id] != description) {
+                reported[id] = description;
+                log(formatStepActivity(id, description));
+            }
+        }
+        for (auto it = reported.begin(); it != reported.end();) {
+            if (visible.count(it->first)) {
+                ++it;
+            } else {
+                log(formatStepActivity(it->first, ""));
+                it = reported.erase(it);
+            }
+        }
+        uint64_t expected = progress.buildsExpected + progress.pathsExpected;
+        if (expected > 0) {
+            log(formatStepProgress(progress.buildsDone + progress.pathsDone, expected));
+        }
+    };
+
+    bool built = captureLines(command, [&](const std::string& line) {
+        NixLogEntry entry;
+        if (parseNixLogLine(line, entry)) {
+            applyNixLogEntry(entry, now(), progress);
+            report(false);
+        } else if (line.compare(0, 1, "/") == 0) {
+            systemPath = line;
+        } else {
+            log(line);
+        }
+    }, true);
+    progress.activities.clear();
+    report(true);
+    if (!built || systemPath.empty()) {
+        log("nix build failed");
+        return false;
+    }
+
+    char summary[160];
+    snprintf(summary, sizeof(summary), "Built %s in %.1f s (%llu builds, %llu paths fetched)", systemPath.c_str(), now(),
+             static_cast<unsigned long long>(progress.buildsDone), static_cast<unsigned long long>(progress.pathsDone));
+    log(summary);
+    if (!checkTargetFilesystems(targetRoot, log)) {
+        return false;
+    }
+
+    // Systemet ligger allerede i målets store; nixos-install setter opp profilen og oppstartslasteren
+    std::string install = nixConfig + "nixos-install --root " + shellQuote(targetRoot) + " --system " + shellQuote(systemPath) +
+                          " --no-root-passwd --no-channel-copy";
+    return captureLines(install, log, true);
+}
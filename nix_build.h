@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Bygger systemet til forhåndsinnstillingen inn i målets store og installerer det. Parallelliteten
+// settes ut fra CPU-ene og det ledige minnet i /proc i stedet for Nix' standardverdier, med et tak
+// så samtidige bygg ikke fyller RAM-en til et live-system der /tmp og storen ligger i tmpfs.
+// Bygget kjøres med --log-format internal-json, og loggen tolkes til fremdrift per derivasjon.
+
+// Grovt anslag på minnet én byggejobb trenger, og hvor mye live-systemet selv må beholde
+const uint64_t NIX_BUILD_JOB_MEMORY_BYTES = 2048ull * 1024 * 1024;
+const uint64_t NIX_SUBSTITUTION_JOB_MEMORY_BYTES = 128ull * 1024 * 1024;
+const uint64_t LIVE_SYSTEM_RESERVE_BYTES = 1024ull * 1024 * 1024;
+const unsigned NIX_MAX_BUILD_JOBS = 8;
+
+struct BuildHardware {
+    unsigned cpus = 1;
+    uint64_t memoryTotalBytes = 0;
+    uint64_t memoryAvailableBytes = 0;
+    bool ramBackedRoot = false; // / eller /nix/.rw-store i tmpfs, som på installasjonsmediet
+};
+
+struct NixBuildTuning {
+    unsigned maxJobs = 1;
+    unsigned cores = 1;
+    unsigned httpConnections = 25;
+    unsigned substitutionJobs = 16;
+};
+
+// Leser /proc/cpuinfo, /proc/meminfo og /proc/mounts
+BuildHardware readBuildHardware();
+
+// concurrentBuilds er antall bygg som deler maskinen, f.eks. ett per disk ved flere disker
+NixBuildTuning tuneNixBuild(const BuildHardware& hardware, unsigned concurrentBuilds = 1);
+
+// Innholdet til NIX_CONFIG for bygget
+std::string nixBuildConfig(const NixBuildTuning& tuning, const std::string& substituters);
+std::string describeNixBuildTuning(const BuildHardware& hardware, const NixBuildTuning& tuning);
+
+// Én linje fra internal-json-loggen ("@nix {...}"), bare feltene som brukes her
+struct NixLogEntry {
+    std::string action; // start, stop, result, msg
+    uint64_t id = 0;
+    uint64_t parent = 0;
+    int type = 0;
+    int level = 0;
+    std::string text;
+    std::vector<std::string> fields; // Tall lagres som tekst
+};
+
+bool parseNixLogLine(const std::string& line, NixLogEntry& entry);
+
+// Aktivitetstypene og resultattypene fra Nix' logging.hh
+enum NixActivityType {
+    NixActivityCopyPath = 100,
+    NixActivityFileTransfer = 101,
+    NixActivityCopyPaths = 103,
+    NixActivityBuilds = 104,
+    NixActivityBuild = 105,
+    NixActivitySubstitute = 108
+};
+
+enum NixResultType {
+    NixResultSetPhase = 104,
+    NixResultProgress = 105
+};
+
+struct NixBuildActivity {
+    int type = 0;
+    uint64_t parent = 0;
+    std::string name; // Stinavn uten hash, f.eks. hello-2.12.1
+    std::string phase;
+    uint64_t bytesDone = 0;
+    uint64_t bytesExpected = 0;
+    double startSeconds = 0.0;
+};
+
+struct NixBuildProgress {
+    std::map<uint64_t, NixBuildActivity> activities; // Bygg og nedlastinger som pågår
+    uint64_t buildsDone = 0, buildsExpected = 0;
+    uint64_t pathsDone = 0, pathsExpected = 0; // Substituerte stier
+    std::vector<std::string> messages;         // Feil og advarsler fra Nix, tømmes av den som leser
+};
+
+// Oppdaterer fremdriften fra én loggoppføring; nowSeconds brukes for varighet og gjennomstrømning
+void applyNixLogEntry(const NixLogEntry& entry, double nowSeconds, NixBuildProgress& progress);
+
+// Statuslinjen for en aktivitet, f.eks. "building hello-2.12.1 (buildPhase, 42 s)" eller
+// "fetching firefox-128.0: 31.0/80.2 MiB at 12.4 MiB/s". Tom for aktiviteter som ikke vises.
+std::string describeNixActivity(const NixBuildActivity& activity, double nowSeconds);
+
+using NixBuildLog = std::function<void(const std::string&)>;
+
+// Flaken buildAndInstallSystem skriver i /etc/nixos på målet. Den peker på en kopi av
+// forhåndsinnstillingen (med alle inndataene) i målets store og kaller systemet
+// nixosConfigurations.nixum, så det kan bygges på nytt uten checkouten og uten nett. Modulene
+// ved siden av tas med når de finnes: hardware-configuration.nix fra nixos-generate-config
+// (filsystemene med UUID-ene og maskinvaren på denne disken) og machine.nix (maskinens egne felt
+// etter avspilling av et image). Forhåndsinnstillingen skal derfor ikke selv definere filsystemene.
+const char* const TARGET_FLAKE_DIR = "/etc/nixos";
+const char* const TARGET_FLAKE_CONFIGURATION = "nixum";
+
+// "path:<targetRoot>/etc/nixos"
+std::string targetFlakeReference(const std::string& targetRoot);
+
+// Sjekker at systemet i målets flake monterer de filsystemene som er montert på targetRoot og
+// targetRoot/boot nå (/dev/disk/by-uuid/<UUID>), så hver disk starter fra sine egne og ikke fra
+// UUID-ene til disken konfigurasjonen ble kopiert fra eller imaget ble tatt av
+bool checkTargetFilesystems(const std::string& targetRoot, const NixBuildLog& log);
+
+// Kopierer flaken i checkoutDir inn i målets store, skriver målets flake, bygger
+// nixosConfigurations.<preset> fra den inn i targetRoot og kjører nixos-install med resultatet.
+// Fremdriften meldes som formatStepProgress- og formatStepActivity-linjer på log.
+bool buildAndInstallSystem(const std::string& targetRoot, const std::string& checkoutDir, const std::string& preset,
+                           const std::string& substituters, unsigned concurrentBuilds, const NixBuildLog& log);
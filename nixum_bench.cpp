@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <time.h>
+
+#include "input_script.h"
+#include "installer_ui.h"
+#include "redraw_scheduler.h"
+
+// Kjører veiviseren uten skjerm (SDLs dummy-videodriver og programvarerendereren),
+// spiller av innspilt input steg for steg og tegner etter hvert steg:
+//
+//   nixum_bench [skript] [--iterations N] [--damage-tracking]
+//
+// Uten skript brukes defaultInputScript(). Rapporterer steg og tegnede frames per sekund, CPU-tid
+// og C++-allokeringer per steg for UI-tråden og høyeste RSS. Uten --damage-tracking gir hvert steg
+// én frame. Med --damage-tracking tegnes som i nixum_install uten GPU: i vinduets overflate, og
+// bare det handlingene faktisk endrer, så steg som ikke endrer noe gir ingen frame.
+
+namespace {
+
+std::atomic<uint64_t> allocationCount{ 0 };
+bool damageTracking = false;
+
+double threadCpuSeconds() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+double wallSeconds() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+struct StepSample {
+    double cpuSeconds;
+    uint64_t allocations;
+};
+
+// Hendelser fra bakgrunnstrådene (diskskanning) behandles som i nixum_install
+void pumpBackgroundEvents() {
+    SDL_Event e;
+    while (SDL_PollEvent(&e)) {
+        handleInstallerEvent(e);
+    }
+}
+
+StepSample renderStep(InputStep& step) {
+    double cpuStart = threadCpuSeconds();
+    uint64_t allocationsStart = allocationCount.load(std::memory_order_relaxed);
+    pumpBackgroundEvents();
+    if (step.hasEvent) {
+        handleInstallerEvent(step.event);
+    }
+    updateInstallerTimers(SDL_GetTicks());
+    // Hver handling skal gi en frame, også de som ellers ikke ville endret noe. Med skadesporing
+    // tegnes bare det handlingen endret, og ingenting hvis den ikke endret noe.
+    if (!damageTracking) {
+        requestRedraw();
+    }
+    if (beginFrameIfDirty()) {
+        renderInstallerFrame();
+    }
+    return { threadCpuSeconds() - cpuStart, allocationCount.load(std::memory_order_relaxed) - allocationsStart };
+}
+
+double percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[static_cast<size_t>((values.size() - 1) * fraction)];
+}
+
+} // namespace
+
+// Teller alle C++-allokeringer i prosessen; SDL og FreeType bruker malloc og telles ikke
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+int main(int argc, char* argv[]) {
+    std::string scriptPath;
+    int iterations = 5;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--damage-tracking") {
+            damageTracking = true;
+        } else {
+            scriptPath = arg;
+        }
+    }
+
+    std::vector<InputStep> steps;
+    std::string error;
+    bool loaded = scriptPath.empty() ? parseInputScript(defaultInputScript(), steps, error) : loadInputScript(scriptPath, steps, error);
+    if (!loaded) {
+        std::cerr << "Invalid input script: " << error << std::endl;
+        return 2;
+    }
+
+    // Kan overstyres, f.eks. SDL_VIDEODRIVER=offscreen
+    setenv("SDL_VIDEODRIVER", "dummy", 0);
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        std::cerr << "SDL_Init Error: " << SDL_GetError() << std::endl;
+        return 1;
+    }
+    if (TTF_Init() != 0) {
+        std::cerr << "TTF_Init Error: " << TTF_GetError() << std::endl;
+        return 1;
+    }
+    SDL_Window* window = SDL_CreateWindow("nixum_bench", 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_HIDDEN);
+    SDL_Surface* surface = window && damageTracking ? SDL_GetWindowSurface(window) : nullptr;
+    SDL_Renderer* renderer = surface ? SDL_CreateSoftwareRenderer(surface)
+                             : window ? SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE) : nullptr;
+    if (renderer == nullptr) {
+        std::cerr << "Cannot create a software renderer: " << SDL_GetError() << std::endl;
+        SDL_Quit();
+        return 1;
+    }
+    TTF_Font* font = loadEmbeddedFont(24);
+    if (font == nullptr) {
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+        return 1;
+    }
+
+    // Ingen lesetest av diskene: den ville konkurrert med målingen og krever root
+    InstallerUiOptions options;
+    options.probeDisks = false;
+    initInstallerUi(renderer, font, options);
+    if (damageTracking) {
+        setSoftwarePresentWindow(window);
+    }
+
+    // Første runde varmer opp glyfatlas, texturcache og allokatorer og telles ikke
+    std::vector<StepSample> samples;
+    double measuredWall = 0.0;
+    RedrawStats warmupStats = {};
+    for (int iteration = 0; iteration <= iterations; iteration++) {
+        double wallStart = wallSeconds();
+        for (auto& step : steps) {
+            int frames = step.hasEvent ? 1 : step.idleFrames;
+            for (int frame = 0; frame < frames; frame++) {
+                StepSample sample = renderStep(step);
+                if (iteration > 0) {
+                    samples.push_back(sample);
+                }
+            }
+        }
+        if (iteration > 0) {
+            measuredWall += wallSeconds() - wallStart;
+        } else {
+            warmupStats = getRedrawStats();
+        }
+    }
+    const RedrawStats& stats = getRedrawStats();
+    double drawCalls = static_cast<double>(stats.drawCalls - warmupStats.drawCalls);
+    double renderedFrames = static_cast<double>(std::max<Uint64>(1, stats.framesRendered - warmupStats.framesRendered));
+
+    std::vector<double> cpuMs;
+    double totalAllocations = 0;
+    for (const auto& sample : samples) {
+        cpuMs.push_back(sample.cpuSeconds * 1000.0);
+        totalAllocations += sample.allocations;
+    }
+    double stepCount = std::max<double>(1, samples.size());
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    Uint64 framesRendered = stats.framesRendered - warmupStats.framesRendered;
+    printf("steps:             %zu (%d iterations of %zu steps)\n", samples.size(), iterations, steps.size());
+    printf("frames rendered:   %llu\n", static_cast<unsigned long long>(framesRendered));
+    printf("steps per second:  %.1f\n", samples.size() / std::max(measuredWall, 1e-9));
+    printf("frames per second: %.1f\n", framesRendered / std::max(measuredWall, 1e-9));
+    printf("cpu ms per step:   mean %.3f  p50 %.3f  p99 %.3f  max %.3f\n",
+           std::accumulate(cpuMs.begin(), cpuMs.end(), 0.0) / stepCount, percentile(cpuMs, 0.5), percentile(cpuMs, 0.99),
+           percentile(cpuMs, 1.0));
+    printf("allocations/step:  %.1f\n", totalAllocations / stepCount);
+    printf("draw calls/frame:  %.1f\n", drawCalls / renderedFrames);
+    printf("cache rebuilds:    %llu (%llu draw calls, not in draw calls/frame)\n",
+           static_cast<unsigned long long>(stats.cacheRebuilds - warmupStats.cacheRebuilds),
+           static_cast<unsigned long long>(stats.cacheRebuildDrawCalls - warmupStats.cacheRebuildDrawCalls));
+    printf("pixels/frame:      %.0f\n", (stats.pixelsDrawn - warmupStats.pixelsDrawn) / renderedFrames);
+    printf("peak RSS:          %.1f MiB\n", usage.ru_maxrss / 1024.0);
+
+    shutdownInstallerUi();
+    TTF_CloseFont(font);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return 0;
+}
@@ -0,0 +1,187 @@
+#include "preset_fetch.h"
+#include "install_pipeline.h"
+#include "util.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+// Oppføringer fra før hele tupp-commiten ble hentet (blob-løse med sparse checkout) har et annet
+// merke og gjenbrukes ikke; Nix leser hele treet når checkouten brukes som flake
+const char* COMPLETE_MARKER = ".git/nixum_complete_full";
+
+std::string environmentOr(const char* name, const std::string& fallback) {
+    const char* value = getenv(name);
+    return (value != nullptr && value[0] != '\0') ? value : fallback;
+}
+
+// Kjører en kort kommando og returnerer første linje av stdout
+bool captureFirstLine(const std::string& command, std::string& line) {
+    std::vector<std::string> lines;
+    bool ok = captureLines(command, lines);
+    line = lines.empty() ? "" : lines[0];
+    line.erase(line.find_last_not_of(" \t\r") + 1);
+    return ok && !line.empty();
+}
+
+bool isCommitId(const std::string& value) {
+    return value.size() == 40 && value.find_first_not_of("0123456789abcdef") == std::string::npos;
+}
+
+// Nyeste komplette oppføring i cachen, brukes når remoten ikke svarer
+std::string newestCachedCommit(const std::string& cacheDir) {
+    std::string newest;
+    std::filesystem::file_time_type newestTime;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(cacheDir, ec)) {
+        std::filesystem::path marker = entry.path() / COMPLETE_MARKER;
+        std::string name = entry.path().filename();
+        if (!isCommitId(name) || !std::filesystem::exists(marker, ec)) {
+            continue;
+        }
+        auto time = std::filesystem::last_write_time(marker, ec);
+        if (newest.empty() || time > newestTime) {
+            newest = name;
+            newestTime = time;
+        }
+    }
+    return newest;
+}
+
+int fetchIntoCache(int step, const PresetFetchOptions& options, const std::string& commit, std::string& fetchedCommit) {
+    std::filesystem::path partial = options.cacheDir + "/" + commit + ".partial";
+    std::error_code ec;
+    std::filesystem::remove_all(partial, ec);
+    std::filesystem::create_directories(partial, ec);
+    std::string git = "git -C " + shellQuote(partial.string()) + " ";
+
+    int status = runStepCommand(step,
+        git + "init -q && " +
+        git + "remote add origin " + shellQuote(options.remoteUrl));
+    if (status != 0) {
+        return status;
+    }
+
+    // Kun tupp-commiten, uten historikk, men med alle filene: nix flake archive og nix eval på
+    // checkouten kopierer hele commit-treet, også de andre hosts-katalogene
+    status = runStepCommand(step,
+        git + "fetch -q --depth=1 origin HEAD && " +
+        git + "-c advice.detachedHead=false checkout -q --detach FETCH_HEAD");
+    if (status != 0) {
+        return status;
+    }
+    if (!captureFirstLine(git + "rev-parse HEAD", fetchedCommit) || !isCommitId(fetchedCommit)) {
+        logStepOutput(step, "Could not resolve fetched commit");
+        return 1;
+    }
+
+    // Remoten kan ha flyttet seg mellom ls-remote og fetch; oppføringen navngis etter det vi faktisk fikk
+    std::filesystem::path entry = options.cacheDir + "/" + fetchedCommit;
+    std::filesystem::remove_all(entry, ec);
+    std::filesystem::rename(partial, entry, ec);
+    if (ec) {
+        logStepOutput(step, "Failed to store cache entry: " + ec.message());
+        return 1;
+    }
+    std::ofstream(entry / COMPLETE_MARKER) << options.remoteUrl << "\n";
+    return 0;
+}
+
+} // namespace
+
+PresetFetchOptions defaultPresetFetchOptions(const std::string& preset) {
+    PresetFetchOptions options;
+    options.remoteUrl = environmentOr("NIXUM_CONFIG_URL", "https://github.com/aCeTotal/nixum_config");
+    options.cacheDir = environmentOr("NIXUM_CACHE_DIR", "/tmp/nixum_cache");
+    options.mediaCacheDir = environmentOr("NIXUM_MEDIA_CACHE_DIR", "/iso/nixum_cache");
+    options.checkoutDir = "/tmp/nixum_config";
+    options.preset = preset;
+    return options;
+}
+
+int fetchPreset(int step, const PresetFetchOptions& options) {
+    std::error_code ec;
+    std::filesystem::create_directories(options.cacheDir, ec);
+    if (ec) {
+        logStepOutput(step, "Cannot create cache directory " + options.cacheDir + ": " + ec.message());
+        return 1;
+    }
+
+    std::string remoteHead;
+    std::string lsRemote = "git ls-remote " + shellQuote(options.remoteUrl) + " HEAD 2>/dev/null";
+    if (captureFirstLine(lsRemote, remoteHead)) {
+        remoteHead = remoteHead.substr(0, remoteHead.find_first_of(" \t"));
+    }
+
+    std::string commit;
+    if (isCommitId(remoteHead)) {
+        commit = remoteHead;
+        logStepOutput(step, "Remote HEAD is " + commit.substr(0, 12));
+    } else {
+        // Uten nett: bruk det nyeste vi har, først fra økten og så fra live-mediet
+        commit = newestCachedCommit(options.cacheDir);
+        if (commit.empty()) {
+            commit = newestCachedCommit(options.mediaCacheDir);
+        }
+        if (commit.empty()) {
+            logStepOutput(step, "Cannot reach " + options.remoteUrl + " and no cached config is available");
+            return 1;
+        }
+        logStepOutput(step, "Remote unreachable, using cached commit " + commit.substr(0, 12));
+    }
+
+    std::filesystem::path entry = options.cacheDir + "/" + commit;
+    std::filesystem::path mediaEntry = options.mediaCacheDir + "/" + commit;
+    if (std::filesystem::exists(entry / COMPLETE_MARKER, ec)) {
+        logStepOutput(step, "Reusing cached config " + commit.substr(0, 12));
+    } else if (!options.mediaCacheDir.empty() && std::filesystem::exists(mediaEntry / COMPLETE_MARKER, ec)) {
+        logStepOutput(step, "Copying config " + commit.substr(0, 12) + " from live media cache");
+        // Rester etter en avbrutt kjøring ville gitt en kopi inni kopien (cp -a og mv inn i en eksisterende katalog)
+        std::filesystem::path partial = options.cacheDir + "/" + commit + ".partial";
+        std::filesystem::remove_all(partial, ec);
+        std::filesystem::remove_all(entry, ec);
+        int status = runStepCommand(step, "cp -a " + shellQuote(mediaEntry.string()) + " " + shellQuote(partial.string()) +
+                                          " && mv " + shellQuote(partial.string()) + " " + shellQuote(entry.string()));
+        if (status != 0) {
+            return status;
+        }
+    } else {
+        std::string fetchedCommit;
+        int status = fetchIntoCache(step, options, commit, fetchedCommit);
+        if (status != 0) {
+            return status;
+        }
+        commit = fetchedCommit;
+        entry = options.cacheDir + "/" + commit;
+    }
+
+    // Valider mot commiten vi ba om i stedet for å slette og hente på nytt
+    std::string head;
+    std::string git = "git -C " + shellQuote(entry.string()) + " ";
+    if (!captureFirstLine(git + "rev-parse HEAD", head) || head != commit) {
+        logStepOutput(step, "Cached config at " + entry.string() + " does not match " + commit + ", discarding it");
+        std::filesystem::remove_all(entry, ec);
+        return 1;
+    }
+    if (!std::filesystem::is_directory(entry / "hosts" / options.preset, ec)) {
+        logStepOutput(step, "Preset " + options.preset + " not found in nixum_config " + commit.substr(0, 12));
+        return 1;
+    }
+    std::filesystem::last_write_time(entry / COMPLETE_MARKER, std::filesystem::file_time_type::clock::now(), ec);
+
+    std::filesystem::remove_all(options.checkoutDir, ec);
+    std::filesystem::create_directory_symlink(std::filesystem::absolute(entry), options.checkoutDir, ec);
+    if (ec) {
+        logStepOutput(step, "Failed to link " + options.checkoutDir + ": " + ec.message());
+        return 1;
+    }
+    logStepOutput(step, options.checkoutDir + " -> " + entry.string());
+    return 0;
+}
+
+std::string presetFlakeReference(const std::string& checkoutDir) {
+    return "git+file://" + checkoutDir + "?shallow=1";
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+
+// Henter kun tuppen av nixum_config, grunt (--depth=1) men med hele treet, siden checkouten
+// brukes som flake og Nix kopierer hele commiten. Hver commit caches i cacheDir/<commit> og
+// gjenbrukes ved nye forsøk så lenge den matcher HEAD hos remoten. En ferdig cache på
+// live-mediet brukes hvis den finnes. remoteUrl kan være en lokal bar repo via file://.
+
+struct PresetFetchOptions {
+    std::string remoteUrl;
+    std::string cacheDir;      // Cache for denne økten, én katalog per commit
+    std::string mediaCacheDir; // Forhåndsfylt cache på live-mediet, kun lesing
+    std::string checkoutDir;   // Symlenke til cache-oppføringen som resten av installasjonen bruker
+    std::string preset;
+};
+
+// Standardverdier, kan overstyres med NIXUM_CONFIG_URL, NIXUM_CACHE_DIR og NIXUM_MEDIA_CACHE_DIR
+PresetFetchOptions defaultPresetFetchOptions(const std::string& preset);
+
+// Kjøres som installasjonssteg; returnerer 0 når checkoutDir peker på en gyldig checkout
+int fetchPreset(int step, const PresetFetchOptions& options);
+
+// Flake-referansen Nix skal bruke for checkouten: "git+file://<checkoutDir>?shallow=1", siden
+// Nix ellers avviser en grunn repo
+std::string presetFlakeReference(const std::string& checkoutDir);
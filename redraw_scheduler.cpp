@@ -0,0 +1,135 @@
+#include "redraw_scheduler.h"
+
+#include <iostream>
+
+namespace {
+
+bool dirty = true; // Første frame tegnes alltid
+bool fullDamage = true;
+std::vector<SDL_Rect> damage;
+bool hasDeadline = false;
+Uint32 nextDeadline = 0;
+RedrawStats stats = { 0, 0, 0, 0, 0, 0, 0 };
+Uint64 currentFrameDrawCalls = 0;
+bool rebuildingCache = false;
+
+} // namespace
+
+void requestRedraw() {
+    dirty = true;
+    fullDamage = true;
+}
+
+void requestRedrawRect(const SDL_Rect& rect) {
+    dirty = true;
+    if (fullDamage || SDL_RectEmpty(&rect)) {
+        return;
+    }
+    // Overlappende rektangler slås sammen, så samme piksler ikke tegnes to ganger
+    SDL_Rect merged = rect;
+    for (size_t i = 0; i < damage.size();) {
+        if (SDL_HasIntersection(&merged, &damage[i])) {
+            SDL_UnionRect(&merged, &damage[i], &merged);
+            damage.erase(damage.begin() + i);
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+    if (damage.size() == MAX_DAMAGE_RECTS) {
+        for (const auto& other : damage) {
+            SDL_UnionRect(&merged, &other, &merged);
+        }
+        damage.clear();
+    }
+    damage.push_back(merged);
+}
+
+void takeFrameDamage(int width, int height, std::vector<SDL_Rect>& rects) {
+    SDL_Rect window = { 0, 0, width, height };
+    rects.clear();
+    if (fullDamage) {
+        rects.push_back(window);
+    } else {
+        for (const auto& rect : damage) {
+            SDL_Rect visible;
+            if (SDL_IntersectRect(&rect, &window, &visible)) {
+                rects.push_back(visible);
+            }
+        }
+    }
+    damage.clear();
+    fullDamage = false;
+}
+
+void scheduleWakeupAt(Uint32 deadline) {
+    if (!hasDeadline || static_cast<Sint32>(deadline - nextDeadline) < 0) {
+        nextDeadline = deadline;
+        hasDeadline = true;
+    }
+}
+
+int waitForEventOrDeadline(SDL_Event* e) {
+    bool wasScheduled = hasDeadline;
+    hasDeadline = false;
+    if (dirty) {
+        return SDL_PollEvent(e);
+    }
+    if (!wasScheduled) {
+        return SDL_WaitEvent(e);
+    }
+    Sint32 remaining = static_cast<Sint32>(nextDeadline - SDL_GetTicks());
+    if (remaining <= 0) {
+        return SDL_PollEvent(e);
+    }
+    return SDL_WaitEventTimeout(e, remaining);
+}
+
+bool beginFrameIfDirty() {
+    if (!dirty) {
+        stats.framesSkipped++;
+        return false;
+    }
+    dirty = false;
+    stats.lastFrameDrawCalls = currentFrameDrawCalls;
+    currentFrameDrawCalls = 0;
+    stats.framesRendered++;
+    return true;
+}
+
+void countDrawCalls(int count) {
+    if (rebuildingCache) {
+        stats.cacheRebuildDrawCalls += count;
+        return;
+    }
+    currentFrameDrawCalls += count;
+    stats.drawCalls += count;
+}
+
+void beginCacheRebuild() {
+    rebuildingCache = true;
+    stats.cacheRebuilds++;
+}
+
+void endCacheRebuild() {
+    rebuildingCache = false;
+}
+
+void countPixelsDrawn(Uint64 pixels) {
+    stats.pixelsDrawn += pixels;
+}
+
+const RedrawStats& getRedrawStats() {
+    return stats;
+}
+
+void printRedrawStats() {
+    double averageDrawCalls = stats.framesRendered > 0 ? static_cast<double>(stats.drawCalls) / static_cast<double>(stats.framesRendered) : 0.0;
+    std::cerr << "Redraw: " << stats.framesRendered << " frames rendered, "
+              << stats.framesSkipped << " wakeups skipped, "
+              << averageDrawCalls << " draw calls per frame (last frame: " << stats.lastFrameDrawCalls << ")";
+    if (stats.framesRendered > 0) {
+        std::cerr << ", " << stats.pixelsDrawn / stats.framesRendered << " pixels drawn per frame";
+    }
+    std::cerr << ", " << stats.cacheRebuilds << " cache rebuilds (" << stats.cacheRebuildDrawCalls << " draw calls)" << std::endl;
+}
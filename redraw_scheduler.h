@@ -0,0 +1,56 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+
+#include <vector>
+
+// Hendelsesdrevet tegning: hovedløkken sover i SDL_WaitEventTimeout til input
+// kommer eller neste frist (markørblink, animasjon) nås, og tegner kun når noe er endret.
+// Endringene samles også som skadde rektangler, slik at programvaretegningen bare tegner og
+// presenterer de delene av vinduet som faktisk er endret.
+
+// Flere rektangler enn dette slås sammen til ett omsluttende
+const size_t MAX_DAMAGE_RECTS = 8;
+
+struct RedrawStats {
+    Uint64 framesRendered;
+    Uint64 framesSkipped;
+    Uint64 drawCalls;
+    Uint64 lastFrameDrawCalls;
+    Uint64 pixelsDrawn;
+    Uint64 cacheRebuilds;
+    Uint64 cacheRebuildDrawCalls; // Tegnekall inn i bufrede texturer, holdes utenfor tallene per frame
+};
+
+// Markerer hele UI-et som endret, neste runde i løkken tegner en frame
+void requestRedraw();
+
+// Markerer bare rect som endret, f.eks. et tekstfelt eller markøren
+void requestRedrawRect(const SDL_Rect& rect);
+
+// Henter og nullstiller de skadde områdene for framen som tegnes nå, begrenset til vinduet.
+// requestRedraw() gir ett rektangel for hele vinduet.
+void takeFrameDamage(int width, int height, std::vector<SDL_Rect>& rects);
+
+// Vekker løkken senest ved tidspunktet (SDL_GetTicks). Fristene gjelder kun neste venting.
+void scheduleWakeupAt(Uint32 deadline);
+
+// Venter på neste hendelse eller frist. Returnerer 1 hvis e ble fylt, 0 ellers.
+int waitForEventOrDeadline(SDL_Event* e);
+
+// Returnerer true hvis en frame skal tegnes, og teller framen som tegnet eller hoppet over
+bool beginFrameIfDirty();
+
+// Teller tegnekall (clear, draw, fill, copy, geometry) for framen som tegnes nå
+void countDrawCalls(int count);
+
+// Mellom disse telles tegnekallene som gjenoppbygging av en bufret texture (f.eks. rammen),
+// ikke som en del av framen som tilfeldigvis utløste den
+void beginCacheRebuild();
+void endCacheRebuild();
+
+// Teller pikslene framen tegner: hele vinduet, eller bare de skadde områdene
+void countPixelsDrawn(Uint64 pixels);
+
+const RedrawStats& getRedrawStats();
+void printRedrawStats();
@@ -22,6 +22,7 @@ in
       SDL2_Pango
       SDL2_sound
       SDL2_mixer
+      zstd
       nushell
     ];
   }
@@ -0,0 +1,483 @@
+#include "storage_probe.h"
+#include "disk_inventory.h"
+#include "install_steps.h"
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <linux/io_uring.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+// Lesetesten skal ta under to sekunder per disk og aldri lese mer enn dette
+const uint64_t SEQUENTIAL_READ_BYTES = 256ull * 1024 * 1024;
+const size_t SEQUENTIAL_BLOCK_SIZE = 1024 * 1024;
+const double SEQUENTIAL_TIME_LIMIT = 0.75;
+const double RANDOM_TIME_LIMIT = 0.75;
+const size_t RANDOM_BLOCK_SIZE = 4096;
+const unsigned int RANDOM_QUEUE_DEPTH = 32;
+const unsigned int RANDOM_FALLBACK_THREADS = 4;
+
+std::mutex probeMutex;
+std::condition_variable probeWake;
+std::map<std::string, StorageProbe> probes;
+std::deque<std::string> pendingProbes;
+std::function<void()> probeCallback;
+std::thread probeThread;
+bool stopRequested = false;
+
+void* allocateAligned(size_t size) {
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, 4096, size) != 0) {
+        return nullptr;
+    }
+    return buffer;
+}
+
+// Minimal io_uring uten liburing: én ring, kun IORING_OP_READ
+struct Uring {
+    int fd = -1;
+    void* sqRing = MAP_FAILED;
+    void* cqRing = MAP_FAILED;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesSize = 0;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    unsigned pendingSubmits = 0;
+
+    bool setup(unsigned entries) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) {
+            return false;
+        }
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMmap) {
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) {
+            return false;
+        }
+        cqRing = singleMmap ? sqRing
+                            : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            return false;
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+        char* sq = static_cast<char*>(sqRing);
+        char* cq = static_cast<char*>(cqRing);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    void queueRead(int fileFd, void* buffer, unsigned length, uint64_t offset, uint64_t userData) {
+        unsigned tail = *sqTail;
+        unsigned index = tail & *sqMask;
+        io_uring_sqe& sqe = sqes[index];
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = fileFd;
+        sqe.addr = reinterpret_cast<uint64_t>(buffer);
+        sqe.len = length;
+        sqe.off = offset;
+        sqe.user_data = userData;
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        pendingSubmits++;
+    }
+
+    // Sender køede lesinger og venter på minst én fullføring
+    bool submitAndWait() {
+        int result = static_cast<int>(syscall(__NR_io_uring_enter, fd, pendingSubmits, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+        if (result < 0 && errno != EINTR) {
+            return false;
+        }
+        pendingSubmits = 0;
+        return true;
+    }
+
+    template <typename Handler>
+    void reap(Handler handler) {
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const io_uring_cqe& cqe = cqes[head & *cqMask];
+            handler(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+
+    ~Uring() {
+        if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+        if (fd >= 0) close(fd);
+    }
+};
+
+bool benchmarkSequential(int fd, uint64_t size, double& mbps) {
+    void* buffer = allocateAligned(SEQUENTIAL_BLOCK_SIZE);
+    if (!buffer) {
+        return false;
+    }
+    uint64_t limit = std::min(size, SEQUENTIAL_READ_BYTES);
+    uint64_t total = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (total + SEQUENTIAL_BLOCK_SIZE <= limit && secondsSince(start) < SEQUENTIAL_TIME_LIMIT) {
+        ssize_t count = pread(fd, buffer, SEQUENTIAL_BLOCK_SIZE, total);
+        if (count <= 0) {
+            break;
+        }
+        total += count;
+    }
+    double seconds = secondsSince(start);
+    free(buffer);
+    if (total == 0 || seconds <= 0) {
+        return false;
+    }
+    mbps = total / seconds / 1e6;
+    return true;
+}
+
+// Tilfeldige 4K-lesinger med RANDOM_QUEUE_DEPTH lesinger i flukt via io_uring
+bool benchmarkRandomUring(int fd, uint64_t blocks, double& iops) {
+    Uring ring;
+    if (!ring.setup(RANDOM_QUEUE_DEPTH)) {
+        return false;
+    }
+    char* buffers = static_cast<char*>(allocateAligned(RANDOM_QUEUE_DEPTH * RANDOM_BLOCK_SIZE));
+    if (!buffers) {
+        return false;
+    }
+    std::mt19937_64 random(blocks);
+    std::uniform_int_distribution<uint64_t> pick(0, blocks - 1);
+    for (unsigned slot = 0; slot < RANDOM_QUEUE_DEPTH; slot++) {
+        ring.queueRead(fd, buffers + slot * RANDOM_BLOCK_SIZE, RANDOM_BLOCK_SIZE, pick(random) * RANDOM_BLOCK_SIZE, slot);
+    }
+    uint64_t completed = 0;
+    unsigned inFlight = RANDOM_QUEUE_DEPTH;
+    bool failed = false;
+    auto start = std::chrono::steady_clock::now();
+    while (inFlight > 0) {
+        if (!ring.submitAndWait()) {
+            failed = true;
+            break;
+        }
+        bool refill = !failed && secondsSince(start) < RANDOM_TIME_LIMIT;
+        ring.reap([&](uint64_t slot, int result) {
+            inFlight--;
+            if (result != static_cast<int>(RANDOM_BLOCK_SIZE)) {
+                failed = true;
+                return;
+            }
+            completed++;
+            if (refill) {
+                ring.queueRead(fd, buffers + slot * RANDOM_BLOCK_SIZE, RANDOM_BLOCK_SIZE, pick(random) * RANDOM_BLOCK_SIZE, slot);
+                inFlight++;
+            }
+        });
+    }
+    double seconds = secondsSince(start);
+    free(buffers);
+    if (failed || completed == 0) {
+        return false;
+    }
+    iops = completed / seconds;
+    return true;
+}
+
+// Reserve når io_uring er slått av (f.eks. kernel.io_uring_disabled): samme dybde
+// tilnærmet med noen få tråder som gjør blokkerende pread
+bool benchmarkRandomThreads(int fd, uint64_t blocks, double& iops) {
+    std::atomic<uint64_t> completed{ 0 };
+    std::atomic<bool> failed{ false };
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned worker = 0; worker < RANDOM_FALLBACK_THREADS; worker++) {
+        workers.emplace_back([&, worker] {
+            void* buffer = allocateAligned(RANDOM_BLOCK_SIZE);
+            if (!buffer) {
+                failed = true;
+                return;
+            }
+            std::mt19937_64 random(blocks + worker);
+            std::uniform_int_distribution<uint64_t> pick(0, blocks - 1);
+            while (!failed && secondsSince(start) < RANDOM_TIME_LIMIT) {
+                if (pread(fd, buffer, RANDOM_BLOCK_SIZE, pick(random) * RANDOM_BLOCK_SIZE) != static_cast<ssize_t>(RANDOM_BLOCK_SIZE)) {
+                    failed = true;
+                    break;
+                }
+                completed++;
+            }
+            free(buffer);
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double seconds = secondsSince(start);
+    if (failed || completed == 0) {
+        return false;
+    }
+    iops = completed / seconds;
+    return true;
+}
+
+// Kjører lesetesten via sudo når vi ikke er root. -n gjør at vi heller hopper over
+// testen enn å henge på et passordspørsmål.
+bool benchmarkViaHelper(const std::string& path, StorageProbe& probe) {
+    std::string command = "sudo -n " + helperCommandLine(getExecutablePath(), { "probe", path }) + " 2>/dev/null";
+    std::string output;
+    if (!captureLines(command, [&output](const std::string& line) { output += line + "\n"; })) {
+        return false;
+    }
+    parseStorageProbe(output, probe);
+    return probe.benchmarked;
+}
+
+void probeLoop() {
+    std::unique_lock<std::mutex> lock(probeMutex);
+    while (true) {
+        probeWake.wait(lock, [] { return stopRequested || !pendingProbes.empty(); });
+        if (stopRequested) {
+            return;
+        }
+        std::string path = pendingProbes.front();
+        pendingProbes.pop_front();
+        lock.unlock();
+
+        StorageProbe probe = readStorageAttributes(path);
+        if (geteuid() == 0) {
+            benchmarkStorageReads(path, probe);
+        } else {
+            benchmarkViaHelper(path, probe);
+        }
+
+        lock.lock();
+        probes[path] = probe;
+        if (probeCallback) {
+            probeCallback();
+        }
+    }
+}
+
+} // namespace
+
+StorageProbe readStorageAttributes(const std::string& path, const std::string& sysRoot) {
+    StorageProbe probe{};
+    probe.path = path;
+    std::filesystem::path queueDir = std::filesystem::path(sysRoot) / "block" / std::filesystem::path(path).filename() / "queue";
+    probe.rotational = readSysfsNumber(queueDir / "rotational", 0) != 0;
+    probe.logicalSectorSize = static_cast<int>(readSysfsNumber(queueDir / "logical_block_size", 512));
+    probe.physicalSectorSize = static_cast<int>(readSysfsNumber(queueDir / "physical_block_size", probe.logicalSectorSize));
+    probe.discardGranularity = readSysfsNumber(queueDir / "discard_granularity", 0);
+    probe.discardMaxBytes = readSysfsNumber(queueDir / "discard_max_bytes", 0);
+    probe.supportsDiscard = probe.discardMaxBytes > 0;
+    probe.writeZeroesMaxBytes = readSysfsNumber(queueDir / "write_zeroes_max_bytes", 0);
+    return probe;
+}
+
+bool benchmarkStorageReads(const std::string& path, StorageProbe& probe) {
+    int fd = open(path.c_str(), O_RDONLY | O_DIRECT | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool isBlockDevice = false;
+    uint64_t size = 0;
+    uint64_t blocks = deviceSize(fd, isBlockDevice, size) ? size / RANDOM_BLOCK_SIZE : 0;
+    bool ok = blocks > 0 && benchmarkSequential(fd, size, probe.sequentialMBps);
+    if (ok) {
+        ok = benchmarkRandomUring(fd, blocks, probe.randomIops) || benchmarkRandomThreads(fd, blocks, probe.randomIops);
+    }
+    close(fd);
+    probe.benchmarked = ok;
+    return ok;
+}
+
+void queueStorageProbes(const std::vector<std::string>& paths, std::function<void()> onResult) {
+    std::lock_guard<std::mutex> lock(probeMutex);
+    probeCallback = std::move(onResult);
+    for (const auto& path : paths) {
+        if (!probes.count(path) && std::find(pendingProbes.begin(), pendingProbes.end(), path) == pendingProbes.end()) {
+            pendingProbes.push_back(path);
+        }
+    }
+    if (!probeThread.joinable()) {
+        stopRequested = false;
+        probeThread = std::thread(probeLoop);
+    }
+    probeWake.notify_one();
+}
+
+// Venter på en eventuell pågående lesetest (maks et par sekunder), resten av køen droppes
+void stopStorageProbes() {
+    {
+        std::lock_guard<std::mutex> lock(probeMutex);
+        stopRequested = true;
+        pendingProbes.clear();
+        probeCallback = nullptr;
+    }
+    probeWake.notify_one();
+    if (probeThread.joinable()) {
+        probeThread.join();
+    }
+}
+
+bool getStorageProbe(const std::string& path, StorageProbe& probe) {
+    std::lock_guard<std::mutex> lock(probeMutex);
+    auto it = probes.find(path);
+    if (it == probes.end()) {
+        return false;
+    }
+    probe = it->second;
+    return true;
+}
+
+std::string formatStorageProbe(const StorageProbe& probe) {
+    std::ostringstream out;
+    out << "rotational=" << probe.rotational << "\n"
+        << "logical_sector_size=" << probe.logicalSectorSize << "\n"
+        << "physical_sector_size=" << probe.physicalSectorSize << "\n"
+        << "discard_granularity=" << probe.discardGranularity << "\n"
+        << "discard_max_bytes=" << probe.discardMaxBytes << "\n"
+        << "write_zeroes_max_bytes=" << probe.writeZeroesMaxBytes << "\n";
+    if (probe.benchmarked) {
+        out << "sequential_mbps=" << probe.sequentialMBps << "\n"
+            << "random_iops=" << probe.randomIops << "\n";
+    }
+    return out.str();
+}
+
+// Kun lesetallene tas fra utdataene; sysfs-attributtene har vi allerede selv
+void parseStorageProbe(const std::string& text, StorageProbe& probe) {
+    std::istringstream in(text);
+    std::string line;
+    bool haveSequential = false;
+    bool haveRandom = false;
+    while (std::getline(in, line)) {
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            continue;
+        }
+        std::string key = line.substr(0, equals);
+        double value = std::strtod(line.c_str() + equals + 1, nullptr);
+        if (key == "sequential_mbps") {
+            probe.sequentialMBps = value;
+            haveSequential = true;
+        } else if (key == "random_iops") {
+            probe.randomIops = value;
+            haveRandom = true;
+        }
+    }
+    probe.benchmarked = haveSequential && haveRandom;
+}
+
+std::string describeStorageProbe(const StorageProbe& probe) {
+    std::string sectors = std::to_string(probe.logicalSectorSize) + "/" + std::to_string(probe.physicalSectorSize) + " B sectors";
+    std::string discard = probe.supportsDiscard ? "TRIM" : "no TRIM";
+    if (!probe.benchmarked) {
+        return std::string(probe.rotational ? "HDD" : "SSD") + ", " + sectors + ", " + discard + " (read test skipped)";
+    }
+    char iops[32];
+    if (probe.randomIops >= 1000) {
+        snprintf(iops, sizeof(iops), "%.0fk", probe.randomIops / 1000);
+    } else {
+        snprintf(iops, sizeof(iops), "%.0f", probe.randomIops);
+    }
+    char text[160];
+    snprintf(text, sizeof(text), "%.0f MB/s sequential, %s IOPS random 4K, %s, %s",
+             probe.sequentialMBps, iops, sectors.c_str(), discard.c_str());
+    return text;
+}
+
+std::string summarizeStorageProbe(const StorageProbe& probe) {
+    std::string discard = probe.supportsDiscard ? "TRIM" : "no TRIM";
+    if (!probe.benchmarked) {
+        return std::string(probe.rotational ? "HDD" : "SSD") + ", " + discard + " (not tested)";
+    }
+    char text[96];
+    if (probe.randomIops >= 1000) {
+        snprintf(text, sizeof(text), "%.0f MB/s, %.0fk IOPS 4K, %s", probe.sequentialMBps, probe.randomIops / 1000, discard.c_str());
+    } else {
+        snprintf(text, sizeof(text), "%.0f MB/s, %.0f IOPS 4K, %s", probe.sequentialMBps, probe.randomIops, discard.c_str());
+    }
+    return text;
+}
+
+// zstd:1 komprimerer i størrelsesorden 300-500 MB/s per kjerne, zstd:3 rundt halvparten.
+// Er disken raskere enn CPU-ene klarer å komprimere, koster høyere nivå skrivehastighet;
+// på trege disker sparer komprimeringen mer tid enn den koster.
+int chooseZstdLevel(const StorageProbe& probe, unsigned int cpuCount) {
+    cpuCount = std::max(1u, cpuCount);
+    if (!probe.benchmarked) {
+        return probe.rotational ? 3 : 1;
+    }
+    double level3Throughput = cpuCount * 150.0;
+    double level1Throughput = cpuCount * 350.0;
+    if (probe.sequentialMBps < level3Throughput / 2) {
+        return 3;
+    }
+    if (probe.sequentialMBps < level1Throughput / 2) {
+        return 2;
+    }
+    return 1;
+}
+
+std::string tunedBtrfsOptions(const StorageProbe& probe, unsigned int cpuCount) {
+    std::string options = "compress=zstd:" + std::to_string(chooseZstdLevel(probe, cpuCount));
+    if (!probe.rotational) {
+        if (probe.supportsDiscard) {
+            options += ",discard=async";
+        }
+        options += ",ssd";
+    }
+    return options;
+}
+
+std::string tunedBtrfsOptionsFor(const std::string& path) {
+    StorageProbe probe;
+    if (!getStorageProbe(path, probe)) {
+        probe = readStorageAttributes(path);
+    }
+    return tunedBtrfsOptions(probe, std::thread::hardware_concurrency());
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Undersøker kandidatdiskene: attributter fra sysfs (rotasjon, sektorstørrelser, discard)
+// og en kort, avgrenset lesetest med O_DIRECT (sekvensiell og tilfeldig 4K). Resultatene
+// vises på "Select Drive" og velger monteringsvalg og zstd-nivå for installasjonen.
+
+struct StorageProbe {
+    std::string path;
+    bool rotational;
+    bool supportsDiscard;
+    uint64_t discardGranularity;
+    uint64_t discardMaxBytes;
+    uint64_t writeZeroesMaxBytes; // > 0 når BLKZEROOUT avlastes til disken
+    int logicalSectorSize;
+    int physicalSectorSize;
+    bool benchmarked;
+    double sequentialMBps;
+    double randomIops;
+};
+
+// Kun sysfs, ingen I/O mot selve disken
+StorageProbe readStorageAttributes(const std::string& path, const std::string& sysRoot = "/sys");
+
+// Avgrenset lesetest; krever lesetilgang til enheten (root)
+bool benchmarkStorageReads(const std::string& path, StorageProbe& probe);
+
+// Undersøker diskene én og én i en bakgrunnstråd. Uten root kjøres lesetesten via
+// "sudo -n nixum_install --helper probe <disk>". onResult kalles fra bakgrunnstråden.
+void queueStorageProbes(const std::vector<std::string>& paths, std::function<void()> onResult);
+void stopStorageProbes();
+bool getStorageProbe(const std::string& path, StorageProbe& probe);
+
+// Skriver resultatet som nøkkel=verdi-linjer (brukt av hjelpekommandoen) og leser det tilbake
+std::string formatStorageProbe(const StorageProbe& probe);
+void parseStorageProbe(const std::string& text, StorageProbe& probe);
+
+// Kort sammendrag for UI-et, f.eks. "2100 MB/s sequential, 250k IOPS random 4K"
+std::string describeStorageProbe(const StorageProbe& probe);
+// Enda kortere, til én linje under hver disk på "Select Drive", f.eks. "2100 MB/s, 250k IOPS 4K, TRIM"
+std::string summarizeStorageProbe(const StorageProbe& probe);
+
+// Monteringsvalg for btrfs ut fra disken og antall CPU-er, f.eks. "compress=zstd:1,discard=async,ssd"
+int chooseZstdLevel(const StorageProbe& probe, unsigned int cpuCount);
+std::string tunedBtrfsOptions(const StorageProbe& probe, unsigned int cpuCount);
+
+// Bruker bufret resultat hvis disken er undersøkt, ellers kun sysfs
+std::string tunedBtrfsOptionsFor(const std::string& path);
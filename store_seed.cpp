@@ -0,0 +1,520 @@
+#include "store_seed.h"
+#include "preset_fetch.h"
+#include "util.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char* NIX_FLAGS = "--extra-experimental-features 'nix-command flakes'";
+
+std::string quotedList(const std::vector<std::string>& values) {
+    std::string joined;
+    for (const auto& value : values) {
+        joined += " " + shellQuote(value);
+    }
+    return joined;
+}
+
+std::string baseName(const std::string& path) {
+    return path.substr(path.rfind('/') + 1);
+}
+
+struct CopyTotals {
+    std::atomic<uint64_t> bytes{ 0 };
+    std::atomic<uint64_t> reflinked{ 0 };
+};
+
+// Reflink når kilde og mål deler filsystem (btrfs, xfs), ellers copy_file_range i kjernen
+bool copyContents(int in, int out, uint64_t size, CopyTotals& totals) {
+    if (size > 0 && ioctl(out, FICLONE, in) == 0) {
+        totals.bytes += size;
+        totals.reflinked += size;
+        return true;
+    }
+    uint64_t done = 0;
+    while (done < size) {
+        ssize_t count = copy_file_range(in, nullptr, out, nullptr, size - done, 0);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+            break; // Eldre kjerner og enkelte filsystemer; kopier i brukerrommet
+        }
+        if (count <= 0) {
+            return false;
+        }
+        done += count;
+    }
+    std::array<char, 1 << 16> buffer;
+    while (done < size) {
+        ssize_t count = pread(in, buffer.data(), std::min<uint64_t>(buffer.size(), size - done), done);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0 || pwrite(out, buffer.data(), count, done) != count) {
+            return false;
+        }
+        done += count;
+    }
+    totals.bytes += size;
+    return true;
+}
+
+bool copyEntry(const std::string& source, const std::string& target, CopyTotals& totals, std::string& error) {
+    struct stat st;
+    if (lstat(source.c_str(), &st) != 0) {
+        error = "lstat " + source + ": " + strerror(errno);
+        return false;
+    }
+    bool ok = true;
+    if (S_ISLNK(st.st_mode)) {
+        std::vector<char> link(st.st_size + 1);
+        ssize_t length = readlink(source.c_str(), link.data(), link.size());
+        ok = length >= 0 && symlink(std::string(link.data(), length).c_str(), target.c_str()) == 0;
+    } else if (S_ISDIR(st.st_mode)) {
+        ok = mkdir(target.c_str(), 0755) == 0;
+        DIR* dir = ok ? opendir(source.c_str()) : nullptr;
+        ok = dir != nullptr;
+        while (ok) {
+            dirent* entry = readdir(dir);
+            if (entry == nullptr) {
+                break;
+            }
+            std::string name = entry->d_name;
+            if (name != "." && name != "..") {
+                ok = copyEntry(source + "/" + name, target + "/" + name, totals, error);
+            }
+        }
+        if (dir != nullptr) {
+            closedir(dir);
+        }
+        // Skrivebeskyttet først når innholdet er på plass, som i storen
+        ok = ok && chmod(target.c_str(), st.st_mode & 0555) == 0;
+    } else if (S_ISREG(st.st_mode)) {
+        int in = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+        int out = in >= 0 ? open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 0555) : -1;
+        ok = out >= 0 && copyContents(in, out, st.st_size, totals);
+        for (int fd : { in, out }) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    } else {
+        error = "Unsupported file type in the store: " + source;
+        return false;
+    }
+    if (!ok) {
+        if (error.empty()) {
+            error = "Copy " + source + ": " + strerror(errno);
+        }
+        return false;
+    }
+    // Nix setter mtime til 1 på alt i storen
+    timespec times[2] = { { 1, 0 }, { 1, 0 } };
+    utimensat(AT_FDCWD, target.c_str(), times, AT_SYMLINK_NOFOLLOW);
+    return true;
+}
+
+// Stiene blant paths som er gyldige i live-systemets store. Uten nix-store (eller når kallet
+// feiler) regnes ingen som gyldige.
+std::set<std::string> validLocalPaths(const std::vector<std::string>& paths) {
+    std::vector<std::string> present;
+    for (const auto& path : paths) {
+        if (access(path.c_str(), F_OK) == 0) {
+            present.push_back(path);
+        }
+    }
+    std::set<std::string> valid;
+    std::vector<std::string> invalid;
+    if (!present.empty() && captureLines("nix-store --check-validity --print-invalid" + quotedList(present), invalid)) {
+        std::set<std::string> invalidSet(invalid.begin(), invalid.end());
+        for (const auto& path : present) {
+            if (!invalidSet.count(path)) {
+                valid.insert(path);
+            }
+        }
+    }
+    return valid;
+}
+
+// Følger referansene fra stier som finnes gjennom den lokale storen og binærcachen
+void planPathClosure(const std::vector<std::string>& roots, const StoreSeedOptions& options, StoreSeedPlan& plan,
+                     const StoreSeedLog& log) {
+    std::set<std::string> seen(roots.begin(), roots.end());
+    std::set<std::string> local;
+    std::vector<std::string> frontier = roots;
+    while (!frontier.empty()) {
+        // Lukningen til de gyldige stiene er lokal i sin helhet og hentes med én nix-store-kjøring
+        std::vector<std::string> candidates;
+        for (const auto& path : frontier) {
+            if (!local.count(path)) {
+                candidates.push_back(path);
+            }
+        }
+        std::set<std::string> validSet = validLocalPaths(candidates);
+        std::vector<std::string> valid(validSet.begin(), validSet.end());
+        std::vector<std::string> closure;
+        if (!valid.empty() && !captureLines("nix-store --query --requisites" + quotedList(valid), closure)) {
+            log("nix-store --query --requisites failed; not seeding from the live store");
+            closure.clear();
+        }
+        for (const auto& path : closure) {
+            if (local.insert(path).second) {
+                seen.insert(path);
+                plan.local.push_back(path);
+            }
+        }
+
+        std::vector<std::string> next;
+        for (const auto& path : frontier) {
+            if (local.count(path)) {
+                continue;
+            }
+            NarInfo info;
+            if (!options.binaryCacheDir.empty() && readNarInfo(options.binaryCacheDir, path, info, options.storeDir)) {
+                plan.cached.push_back(path);
+                for (const auto& reference : info.references) {
+                    if (seen.insert(reference).second) {
+                        next.push_back(reference);
+                    }
+                }
+            } else {
+                plan.missing.push_back(path);
+            }
+        }
+        frontier = std::move(next);
+    }
+}
+
+} // namespace
+
+StoreSeedOptions defaultStoreSeedOptions(const std::string& targetRoot) {
+    StoreSeedOptions options;
+    options.targetRoot = targetRoot;
+    if (const char* cache = getenv("NIXUM_BINARY_CACHE")) {
+        options.binaryCacheDir = cache;
+        if (options.binaryCacheDir.compare(0, 7, "file://") == 0) {
+            options.binaryCacheDir = options.binaryCacheDir.substr(7);
+        }
+    }
+    options.threads = std::max(2u, std::min(std::thread::hardware_concurrency(), 16u));
+    return options;
+}
+
+bool readNarInfo(const std::string& cacheDir, const std::string& storePath, NarInfo& info, const std::string& storeDir) {
+    // Filnavnet er hash-delen av stien, de 32 tegnene før første '-'
+    std::string name = baseName(storePath);
+    std::ifstream in(cacheDir + "/" + name.substr(0, name.find('-')) + ".narinfo");
+    if (!in) {
+        return false;
+    }
+    info = NarInfo();
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t colon = line.find(": ");
+        if (colon == std::string::npos) {
+            continue;
+        }
+        std::string key = line.substr(0, colon);
+        std::string value = line.substr(colon + 2);
+        if (key == "StorePath") {
+            info.storePath = value;
+        } else if (key == "URL") {
+            info.url = value;
+        } else if (key == "FileSize") {
+            info.fileSize = strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "NarSize") {
+            info.narSize = strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "References") {
+            std::istringstream references(value);
+            std::string reference;
+            while (references >> reference) {
+                info.references.push_back(storeDir + "/" + reference);
+            }
+        }
+    }
+    return info.storePath == storePath && !info.url.empty();
+}
+
+bool parseDerivationGraph(const std::string& json, DerivationGraph& graph, const std::string& storeDir) {
+    auto fullPath = [&storeDir](const std::string& path) { return path.compare(0, 1, "/") == 0 ? path : storeDir + "/" + path; };
+    JsonReader reader = { json, 0 };
+    return reader.readObject([&](const std::string& drvPath) {
+        StoreDerivation& derivation = graph[fullPath(drvPath)];
+        return reader.readObject([&](const std::string& key) {
+            if (key == "outputs") {
+                return reader.readObject([&](const std::string& name) {
+                    std::string& path = derivation.outputs[name];
+                    return reader.readObject([&](const std::string& field) {
+                        if (field != "path") {
+                            return reader.skipValue();
+                        }
+                        bool ok = reader.readString(path);
+                        path = fullPath(path);
+                        return ok;
+                    });
+                });
+            }
+            if (key == "inputDrvs") {
+                // ["out"] i eldre Nix, { "outputs": ["out"], "dynamicOutputs": {} } i nyere
+                return reader.readObject([&](const std::string& input) {
+                    std::vector<std::string> names;
+                    bool ok = reader.readStringList(names) || reader.readObject([&](const std::string& field) {
+                        return field == "outputs" ? reader.readStringList(names) : reader.skipValue();
+                    });
+                    derivation.inputDerivations.push_back({ fullPath(input), names });
+                    return ok;
+                });
+            }
+            if (key == "inputSrcs") {
+                std::vector<std::string> sources;
+                bool ok = reader.readStringList(sources);
+                for (const auto& source : sources) {
+                    derivation.inputSources.push_back(fullPath(source));
+                }
+                return ok;
+            }
+            return reader.skipValue();
+        });
+    });
+}
+
+StoreSeedPlan planStoreSeed(const std::string& rootDerivation, const DerivationGraph& graph, const StoreSeedOptions& options,
+                            const StoreSeedLog& log) {
+    // Først byggegrafen, ett nivå av gangen: utdataene en derivasjon trengs for, finnes de lokalt
+    // eller i binærcachen, blir røtter for lukningen under. Ellers må derivasjonen bygges, og
+    // inndataene dens (derivasjoner og kildefiler) trengs.
+    StoreSeedPlan plan;
+    std::vector<std::string> roots;
+    std::set<std::string> visited;
+    std::vector<std::pair<std::string, std::vector<std::string>>> frontier;
+    auto root = graph.find(rootDerivation);
+    if (root == graph.end()) {
+        log("Derivation " + rootDerivation + " is not in the build graph");
+        return plan;
+    }
+    std::vector<std::string> rootOutputs;
+    for (const auto& [name, path] : root->second.outputs) {
+        rootOutputs.push_back(name);
+    }
+    frontier.push_back({ rootDerivation, rootOutputs });
+    while (!frontier.empty()) {
+        std::vector<std::string> outputs;
+        for (const auto& [drvPath, names] : frontier) {
+            const StoreDerivation& derivation = graph.at(drvPath);
+            for (const auto& name : names) {
+                auto output = derivation.outputs.find(name);
+                if (output != derivation.outputs.end() && !output->second.empty()) {
+                    outputs.push_back(output->second);
+                }
+            }
+        }
+        std::set<std::string> valid = validLocalPaths(outputs);
+
+        std::vector<std::pair<std::string, std::vector<std::string>>> next;
+        for (const auto& [drvPath, names] : frontier) {
+            const StoreDerivation& derivation = graph.at(drvPath);
+            bool mustBuild = false;
+            std::vector<std::string> available;
+            for (const auto& name : names) {
+                auto output = derivation.outputs.find(name);
+                std::string path = output == derivation.outputs.end() ? "" : output->second;
+                NarInfo info;
+                if (!path.empty() && (valid.count(path) ||
+                                      (!options.binaryCacheDir.empty() && readNarInfo(options.binaryCacheDir, path, info, options.storeDir)))) {
+                    available.push_back(path);
+                } else {
+                    mustBuild = true;
+                    if (!path.empty()) {
+                        plan.missing.push_back(path);
+                    }
+                }
+            }
+            roots.insert(roots.end(), available.begin(), available.end());
+            if (!mustBuild) {
+                continue;
+            }
+            roots.insert(roots.end(), derivation.inputSources.begin(), derivation.inputSources.end());
+            for (const auto& [input, inputNames] : derivation.inputDerivations) {
+                if (!graph.count(input)) {
+                    continue;
+                }
+                std::vector<std::string> unvisited;
+                for (const auto& name : inputNames) {
+                    if (visited.insert(input + "!" + name).second) {
+                        unvisited.push_back(name);
+                    }
+                }
+                if (!unvisited.empty()) {
+                    next.push_back({ input, unvisited });
+                }
+            }
+        }
+        frontier = std::move(next);
+    }
+
+    std::sort(roots.begin(), roots.end());
+    roots.erase(std::unique(roots.begin(), roots.end()), roots.end());
+    planPathClosure(roots, options, plan, log);
+    std::sort(plan.missing.begin(), plan.missing.end());
+    plan.missing.erase(std::unique(plan.missing.begin(), plan.missing.end()), plan.missing.end());
+    return plan;
+}
+
+bool copyStorePaths(const std::vector<std::string>& paths, const StoreSeedOptions& options, StoreSeedReport& report, const StoreSeedLog& log) {
+    std::string targetStore = options.targetRoot + options.storeDir;
+    std::error_code ec;
+    std::filesystem::create_directories(targetStore, ec);
+    if (ec) {
+        log("Cannot create " + targetStore + ": " + ec.message());
+        return false;
+    }
+
+    CopyTotals totals;
+    std::atomic<size_t> nextPath{ 0 };
+    std::atomic<size_t> copiedPaths{ 0 };
+    std::mutex errorMutex;
+    std::string firstError;
+    auto worker = [&]() {
+        while (true) {
+            size_t index = nextPath.fetch_add(1);
+            if (index >= paths.size()) {
+                return;
+            }
+            std::string name = baseName(paths[index]);
+            std::string target = targetStore + "/" + name;
+            if (access(target.c_str(), F_OK) == 0) {
+                continue;
+            }
+            // Kopieres under et midlertidig navn og flyttes på plass når den er komplett
+            std::string partial = targetStore + "/.seed-" + name;
+            std::error_code removeError;
+            std::filesystem::remove_all(partial, removeError);
+            std::string error;
+            if (!copyEntry(options.storeDir + "/" + name, partial, totals, error) || rename(partial.c_str(), target.c_str()) != 0) {
+                std::filesystem::remove_all(partial, removeError);
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (firstError.empty()) {
+                    firstError = error.empty() ? "rename " + partial + ": " + strerror(errno) : error;
+                }
+                continue;
+            }
+            copiedPaths++;
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < std::max(1u, options.threads); i++) {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    report.localPaths += copiedPaths.load();
+    report.localBytes += totals.bytes.load();
+    report.reflinkedBytes += totals.reflinked.load();
+    if (!firstError.empty()) {
+        log(firstError);
+        return false;
+    }
+    return true;
+}
+
+bool seedTargetStore(const std::string& rootDerivation, const DerivationGraph& graph, const StoreSeedOptions& options,
+                     StoreSeedReport& report, const StoreSeedLog& log) {
+    auto start = std::chrono::steady_clock::now();
+    StoreSeedPlan plan = planStoreSeed(rootDerivation, graph, options, log);
+    log(std::to_string(plan.local.size()) + " store paths on the live system, " + std::to_string(plan.cached.size()) +
+        " in the binary cache, " + std::to_string(plan.missing.size()) + " to build or download");
+
+    bool ok = true;
+    if (!plan.local.empty()) {
+        ok = copyStorePaths(plan.local, options, report, log);
+        // Registreringen (hash, referanser) tas fra live-systemets database
+        ok = ok && captureLines("nix-store --dump-db" + quotedList(plan.local) + " | nix-store --store " +
+                                shellQuote(options.targetRoot) + " --load-db", log, true);
+        if (!ok) {
+            log("Seeding from the live store failed; the build will fetch these paths instead");
+        }
+    }
+    if (!plan.cached.empty()) {
+        bool copied = captureLines(std::string("nix ") + NIX_FLAGS + " copy --no-check-sigs --from " + shellQuote("file://" + options.binaryCacheDir) +
+                                   " --to " + shellQuote("local?root=" + options.targetRoot) + quotedList(plan.cached), log, true);
+        if (copied) {
+            report.cachePaths = plan.cached.size();
+            for (const auto& path : plan.cached) {
+                NarInfo info;
+                if (readNarInfo(options.binaryCacheDir, path, info, options.storeDir)) {
+                    report.cacheBytes += info.fileSize;
+                }
+            }
+        } else {
+            log("Copy from " + options.binaryCacheDir + " failed; the build will fetch these paths instead");
+            ok = false;
+        }
+    }
+    report.networkPaths = plan.missing.size();
+
+    double seconds = secondsSince(start);
+    char summary[256];
+    snprintf(summary, sizeof(summary),
+             "Store seeded in %.1f s: %zu paths (%s, %s reflinked) copied locally, %zu paths (%s) from the binary cache, %zu left for the network",
+             seconds, report.localPaths, gibibytes(report.localBytes).c_str(), gibibytes(report.reflinkedBytes).c_str(), report.cachePaths,
+             gibibytes(report.cacheBytes).c_str(), report.networkPaths);
+    log(summary);
+    return ok;
+}
+
+bool seedStoreForPreset(const std::string& checkoutDir, const std::string& preset, const StoreSeedOptions& options, const StoreSeedLog& log) {
+    // Å evaluere drvPath skriver derivasjonene til live-systemets store; toplevel-utdataet finnes
+    // nesten aldri, så det er byggegrafen under som avgjør hva som kan hentes lokalt
+    std::vector<std::string> lines;
+    std::string attribute = presetFlakeReference(checkoutDir) + "#nixosConfigurations." + preset + ".config.system.build.toplevel.drvPath";
+    if (!captureLines(std::string("nix ") + NIX_FLAGS + " eval --raw " + shellQuote(attribute), lines) || lines.empty()) {
+        log("Could not evaluate " + attribute + "; skipping store seeding");
+        return false;
+    }
+    std::string rootDerivation = lines.back();
+    log("System derivation: " + rootDerivation);
+    if (!captureLines(std::string("nix ") + NIX_FLAGS + " derivation show -r " + shellQuote(rootDerivation), lines)) {
+        log("nix derivation show failed; skipping store seeding");
+        return false;
+    }
+    std::string json;
+    for (const auto& line : lines) {
+        json += line + "\n";
+    }
+    DerivationGraph graph;
+    if (!parseDerivationGraph(json, graph, options.storeDir)) {
+        log("Cannot parse the build graph of " + rootDerivation + "; skipping store seeding");
+        return false;
+    }
+    StoreSeedReport report;
+    return seedTargetStore(rootDerivation, graph, options, report, log);
+}
+
+std::string installSubstituters(const StoreSeedOptions& options) {
+    std::string substituters = "https://cache.nixos.org";
+    return options.binaryCacheDir.empty() ? substituters : "file://" + options.binaryCacheDir + " " + substituters;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Forhåndsfyller målets Nix-store før bygget, i stedet for å laste ned hele lukningen.
+// Byggegrafen til forhåndsinnstillingens system følges nedover fra toplevel-derivasjonen, slik
+// Nix selv gjør: utdata som allerede er gyldige i live-systemets /nix/store kopieres parallelt til
+// <mål>/nix/store (med reflinks når begge ligger på samme filsystem) og registreres i målets
+// database; utdata som finnes i en lokal binærcache (file://) hentes derfra. Bare derivasjoner
+// som må bygges følges videre til inndataene sine. Resten overlates til bygget og nettet.
+
+struct StoreSeedOptions {
+    std::string targetRoot;     // F.eks. /mnt
+    std::string binaryCacheDir; // Lokal binærcache, tom for ingen (NIXUM_BINARY_CACHE)
+    std::string storeDir = "/nix/store";
+    unsigned threads = 8;
+};
+
+struct StoreSeedPlan {
+    std::vector<std::string> local;   // Gyldige i live-systemets store
+    std::vector<std::string> cached;  // Finnes i binærcachen
+    std::vector<std::string> missing; // Må bygges eller hentes fra nettet
+};
+
+struct StoreSeedReport {
+    size_t localPaths = 0;
+    uint64_t localBytes = 0;
+    uint64_t reflinkedBytes = 0;
+    size_t cachePaths = 0;
+    uint64_t cacheBytes = 0; // Komprimert størrelse (FileSize) fra narinfo
+    size_t networkPaths = 0;
+};
+
+// Innholdet i <cache>/<hash>.narinfo som trengs her
+struct NarInfo {
+    std::string storePath;
+    std::string url;
+    uint64_t fileSize = 0;
+    uint64_t narSize = 0;
+    std::vector<std::string> references; // Fulle stier
+};
+
+// Én derivasjon fra "nix derivation show -r", med fulle stier
+struct StoreDerivation {
+    std::map<std::string, std::string> outputs; // Navn -> sti; tom sti når den ikke er kjent på forhånd
+    std::vector<std::pair<std::string, std::vector<std::string>>> inputDerivations; // Med utdataene som brukes
+    std::vector<std::string> inputSources;
+};
+using DerivationGraph = std::map<std::string, StoreDerivation>;
+
+using StoreSeedLog = std::function<void(const std::string&)>;
+
+StoreSeedOptions defaultStoreSeedOptions(const std::string& targetRoot);
+
+bool readNarInfo(const std::string& cacheDir, const std::string& storePath, NarInfo& info, const std::string& storeDir = "/nix/store");
+
+// Leser JSON-en fra "nix derivation show -r"; nøkler uten storeDir (nyere Nix) får den foran
+bool parseDerivationGraph(const std::string& json, DerivationGraph& graph, const std::string& storeDir = "/nix/store");
+
+// Går nedover fra rootDerivation og følger så referansene til det som finnes, gjennom den lokale
+// storen og binærcachen
+StoreSeedPlan planStoreSeed(const std::string& rootDerivation, const DerivationGraph& graph, const StoreSeedOptions& options,
+                            const StoreSeedLog& log);
+
+// Kopierer stiene fra storeDir til targetRoot/nix/store på options.threads tråder, reflink først.
+// Stier som allerede finnes i målet hoppes over.
+bool copyStorePaths(const std::vector<std::string>& paths, const StoreSeedOptions& options, StoreSeedReport& report, const StoreSeedLog& log);
+
+// Planlegger, kopierer, registrerer og henter fra binærcachen. Feil her er ikke fatale for
+// installasjonen: bygget henter det som mangler.
+bool seedTargetStore(const std::string& rootDerivation, const DerivationGraph& graph, const StoreSeedOptions& options,
+                     StoreSeedReport& report, const StoreSeedLog& log);
+
+// Evaluerer toplevel-derivasjonen til nixosConfigurations.<preset> i flaken og forhåndsfyller for den
+bool seedStoreForPreset(const std::string& checkoutDir, const std::string& preset, const StoreSeedOptions& options, const StoreSeedLog& log);
+
+// substituters-verdien for bygget: binærcachen først, deretter cache.nixos.org
+std::string installSubstituters(const StoreSeedOptions& options);
@@ -0,0 +1,112 @@
+#include "btrfs_layout.h"
+#include "test_support.h"
+
+#include <cstdio>
+
+#include <fcntl.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+void testParseMountOptions() {
+    ParsedOptions parsed = parseMountOptions("defaults,noatime,compress=zstd,,ro,rw,discard=async");
+    CHECK(parsed.flags == MS_NOATIME);
+    CHECK(parsed.data == "compress=zstd,discard=async");
+
+    parsed = parseMountOptions("subvol=@nix,nodev,nosuid");
+    CHECK(parsed.flags == (MS_NODEV | MS_NOSUID));
+    CHECK(parsed.data == "subvol=@nix");
+}
+
+void testMountWaves() {
+    std::vector<LayoutEntry> layout = nixumFilesystemLayout();
+    CHECK(layout.size() == 6);
+    CHECK(layout[1].options == "defaults,noatime,compress=zstd,discard=async,ssd");
+    CHECK(nixumFilesystemLayout("")[1].options == "defaults,noatime");
+
+    // @ har ikke monteringspunkt; / først, så alt direkte under den samtidig
+    std::vector<std::vector<size_t>> waves = mountWaves(layout);
+    CHECK(waves.size() == 2);
+    CHECK(waves.size() == 2 && waves[0] == std::vector<size_t>({ 1 }));
+    CHECK(waves.size() == 2 && waves[1] == std::vector<size_t>({ 2, 3, 4, 5 }));
+
+    // /var/log må vente på /var, men /varnish er ikke under /var
+    std::vector<LayoutEntry> nested = {
+        { MountSource::Root, "btrfs", "@log", "/var/log", "" },
+        { MountSource::Root, "btrfs", "@var", "/var", "" },
+        { MountSource::Root, "btrfs", "@varnish", "/varnish", "" },
+        { MountSource::Root, "btrfs", "@root", "/", "" },
+    };
+    waves = mountWaves(nested);
+    CHECK(waves.size() == 3);
+    CHECK(waves.size() == 3 && waves[0] == std::vector<size_t>({ 3 }));
+    CHECK(waves.size() == 3 && waves[1] == std::vector<size_t>({ 1, 2 }));
+    CHECK(waves.size() == 3 && waves[2] == std::vector<size_t>({ 0 }));
+}
+
+std::string makeImage(const TempDir& dir, const std::string& name, off_t sizeBytes) {
+    std::string path = (dir.path / name).string();
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    CHECK(fd >= 0 && ftruncate(fd, sizeBytes) == 0);
+    close(fd);
+    return path;
+}
+
+// Hele oppsettet mot image-filer på loop-enheter: subvolumene finnes og hver montering er sin egen
+bool testImageFiles() {
+    if (geteuid() != 0 || !runQuiet("command -v mkfs.btrfs") || !runQuiet("command -v mkfs.vfat")) {
+        return false;
+    }
+    TempDir dir;
+    std::string rootImage = makeImage(dir, "root.img", 256 << 20);
+    std::string bootImage = makeImage(dir, "boot.img", 64 << 20);
+    if (!runQuiet("mkfs.btrfs -q -f " + rootImage) || !runQuiet("mkfs.vfat " + bootImage)) {
+        return false;
+    }
+    std::string rootDevice = attachLoop(rootImage);
+    std::string bootDevice = attachLoop(bootImage);
+    if (rootDevice.empty() || bootDevice.empty()) {
+        runQuiet("losetup -d " + rootDevice);
+        return false;
+    }
+
+    std::vector<LayoutEntry> layout = nixumFilesystemLayout();
+    std::string target = (dir.path / "target").string();
+    std::vector<std::string> logLines;
+    LayoutLog log = [&logLines](const std::string& line) { logLines.push_back(line); };
+    bool applied = applyFilesystemLayout(layout, rootDevice, bootDevice, target, log);
+    CHECK(applied);
+    if (applied) {
+        struct stat rootStat;
+        CHECK(stat(target.c_str(), &rootStat) == 0);
+        CHECK(rootStat.st_ino == 256); // Roten av et btrfs-subvolum
+        for (const char* mountpoint : { "/home", "/nix", "/var/log", "/boot" }) {
+            struct stat st;
+            CHECK(stat((target + mountpoint).c_str(), &st) == 0);
+            CHECK(st.st_dev != rootStat.st_dev);
+        }
+        // Subvolumene ligger ved siden av hverandre i toppnivået, ikke inni @root
+        struct stat nested;
+        CHECK(stat((target + "/@home").c_str(), &nested) != 0);
+    }
+    CHECK(unmountFilesystemLayout(layout, target, log));
+    struct stat afterUnmount;
+    CHECK(stat((target + "/home").c_str(), &afterUnmount) != 0 || afterUnmount.st_ino != 256);
+
+    runQuiet("losetup -d " + rootDevice);
+    runQuiet("losetup -d " + bootDevice);
+    return true;
+}
+
+} // namespace
+
+int main() {
+    testParseMountOptions();
+    testMountWaves();
+    if (!testImageFiles()) {
+        fprintf(stderr, "btrfs_layout_test: image test skipped (needs root, loop devices, mkfs.btrfs and mkfs.vfat)\n");
+    }
+    return testResult("btrfs_layout_test");
+}
@@ -0,0 +1,107 @@
+#include "disk_inventory.h"
+#include "test_support.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+// En disk slik sysfs viser den: size i 512-byte sektorer, device/ bare for ekte maskinvare
+void addFakeDisk(const std::filesystem::path& sysRoot, const std::string& name, uint64_t sectors, const std::string& model,
+                 bool rotational, bool removable = false, bool readOnly = false) {
+    std::filesystem::path dir = sysRoot / "block" / name;
+    writeTestFile(dir / "size", std::to_string(sectors) + "\n");
+    writeTestFile(dir / "ro", readOnly ? "1\n" : "0\n");
+    writeTestFile(dir / "removable", removable ? "1\n" : "0\n");
+    writeTestFile(dir / "queue" / "rotational", rotational ? "1\n" : "0\n");
+    writeTestFile(dir / "queue" / "logical_block_size", "512\n");
+    writeTestFile(dir / "queue" / "physical_block_size", "4096\n");
+    writeTestFile(dir / "device" / "model", model + "   \n");
+}
+
+void testScan() {
+    TempDir sys;
+    addFakeDisk(sys.path, "sdb", 976773168, "WDC WD5000", true);
+    addFakeDisk(sys.path, "nvme0n1", 1000215216, "Samsung SSD 970", false);
+    addFakeDisk(sys.path, "sdc", 30031872, "", false, true);
+    writeTestFile(sys.path / "block" / "sdc" / "device" / "name", "SD32G\n");
+    addFakeDisk(sys.path, "sdd", 0, "Empty card reader", false, true);
+    addFakeDisk(sys.path, "sde", 2048, "Write protected", false, false, true);
+    addFakeDisk(sys.path, "loop0", 2048, "", false);
+    addFakeDisk(sys.path, "mmcblk0boot0", 8192, "", false);
+    // Uten device/ er det en virtuell enhet
+    writeTestFile(sys.path / "block" / "vda" / "size", "2048\n");
+
+    std::vector<BlockDevice> devices = scanBlockDevices(sys.path.string());
+    CHECK(devices.size() == 3);
+    if (devices.size() != 3) {
+        return;
+    }
+    CHECK(devices[0].name == "nvme0n1");
+    CHECK(devices[0].path == "/dev/nvme0n1");
+    CHECK(devices[0].model == "Samsung SSD 970");
+    CHECK(devices[0].sizeBytes == 1000215216ull * 512);
+    CHECK(!devices[0].rotational);
+    CHECK(devices[0].logicalSectorSize == 512);
+    CHECK(devices[0].physicalSectorSize == 4096);
+    CHECK(devices[1].name == "sdb");
+    CHECK(devices[1].rotational);
+    CHECK(devices[2].name == "sdc");
+    CHECK(devices[2].model == "SD32G");
+    CHECK(devices[2].removable);
+
+    CHECK(describeBlockDevice(devices[1]) == "/dev/sdb - Size: 465.8G - WDC WD5000 (HDD)");
+    CHECK(describeBlockDevice(devices[2]) == "/dev/sdc - Size: 14.3G - SD32G (SSD) [removable]");
+}
+
+void testMissingRoot() {
+    CHECK(scanBlockDevices("/nonexistent/sys").empty());
+}
+
+void testFormatDiskSize() {
+    CHECK(formatDiskSize(0) == "0B");
+    CHECK(formatDiskSize(512) == "512B");
+    CHECK(formatDiskSize(1024ull * 1024 * 1024) == "1G");
+    CHECK(formatDiskSize(1536ull * 1024 * 1024) == "1.5G");
+    CHECK(formatDiskSize(2ull * 1024 * 1024 * 1024 * 1024) == "2T");
+}
+
+// Et falskt sysfs-tre følges med inotify; en ny disk skal gi onChange og dukke opp i listen
+void testHotplug() {
+    TempDir sys;
+    addFakeDisk(sys.path, "sda", 2048, "First", false);
+    std::atomic<int> changes{ 0 };
+    CHECK(startDiskInventory(sys.path.string(), [&changes] { changes++; }));
+
+    auto waitFor = [&changes](int count) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (changes.load() < count && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return changes.load() >= count;
+    };
+    CHECK(waitFor(1));
+    CHECK(getDiskInventory().size() == 1);
+
+    // Bygges ferdig utenfor block/ og flyttes inn, så skanningen aldri ser en halvskrevet disk
+    TempDir staging;
+    addFakeDisk(staging.path, "sdb", 4096, "Second", true);
+    std::filesystem::rename(staging.path / "block" / "sdb", sys.path / "block" / "sdb");
+    CHECK(waitFor(2));
+    std::vector<BlockDevice> devices = getDiskInventory();
+    CHECK(devices.size() == 2);
+    CHECK(devices.size() == 2 && devices[1].name == "sdb");
+
+    stopDiskInventory();
+}
+
+} // namespace
+
+int main() {
+    testScan();
+    testMissingRoot();
+    testFormatDiskSize();
+    testHotplug();
+    return testResult("disk_inventory_test");
+}
@@ -0,0 +1,74 @@
+#include "field_validation.h"
+#include "test_support.h"
+
+namespace {
+
+// Ekte nøkler fra ssh-keygen, uten kommentar
+const char* const ED25519_KEY = "ssh-ed25519 AAAAC3NzaC1lZDI1NTE5AAAAIAOampS1wkfiP4dRnm3wrKSIjuiMqTBOmNQdJ3EBrBH8";
+const char* const VALID_KEYS[] = {
+    ED25519_KEY,
+    "ecdsa-sha2-nistp256 AAAAE2VjZHNhLXNoYTItbmlzdHAyNTYAAAAIbmlzdHAyNTYAAABBBPQ+EIQYxpf7DiSX+uUap5sFKWAMp+1EFJbEXtq425KuN7XK03zhSz"
+    "PnNTugJZMrcrmtiL2laGch3hw7kHXYn2c=",
+    "ecdsa-sha2-nistp384 AAAAE2VjZHNhLXNoYTItbmlzdHAzODQAAAAIbmlzdHAzODQAAABhBIZkIbBWKrvLS2wQwi1VH4WQeyx85GS7ijbnwHoZLNlv7tc0TZchsL"
+    "ojceUQMJ3d8DoABequuC5uMAq7fUQNtoGqQFmaN01Wy2ML6RsTH0/1f7QqSzeDDMvK+f93YTzxTQ==",
+    "ecdsa-sha2-nistp521 AAAAE2VjZHNhLXNoYTItbmlzdHA1MjEAAAAIbmlzdHA1MjEAAACFBAEb99IuU4QrAEKnucKnPRRTVz4FQkGdeOBpkEsvUO74Tw+Us39oxT"
+    "Tnh8UfMIcOkYLILVPGJibLCBp/va8NvnoFEgHI0n2Co6CmLqk6izvkR8jYSvGOuXKwLwiqJmKGk8ZrpsWaZgawuoYoUGb8wTC/Vnj5kwn82VIpEChSd0RTsBTtfw==",
+    "ssh-rsa AAAAB3NzaC1yc2EAAAADAQABAAAAgQCumXFxyQuC7fS9fZOAk3ZJFmPnUo2CU1g7hSMGWcYOh5U07gxld9jzpHt73UkuYi5BW4RuNDn2BrXxJBitOWz5XyJkPC"
+    "ykiyFVYSCT9nc7BxWo3PjbnflwR647iRCKVN8IgzEsxgVFnijqOwe00rxYryduZLPB3SGEa1w/Q5a1xw=="
+};
+
+Validity validity(FieldKind kind, const std::string& value) {
+    return validateField(kind, value).validity;
+}
+
+// Tegn for tegn som i UI-et skal gi samme svar som hele verdien på én gang
+Validity typed(FieldKind kind, const std::string& value) {
+    FieldValidator validator;
+    resetValidator(validator, kind, "");
+    for (char c : value) {
+        validatorAppend(validator, std::string(1, c));
+    }
+    return validatorResult(validator).validity;
+}
+
+void testSshKeys() {
+    for (const char* key : VALID_KEYS) {
+        CHECK(validity(FieldKind::SshPublicKey, key) == Validity::Valid);
+        CHECK(typed(FieldKind::SshPublicKey, key) == Validity::Valid);
+        CHECK(validity(FieldKind::SshPublicKey, std::string(key) + " ola's laptop") == Validity::Valid);
+    }
+
+    // Bare typeprefikset i base64, eller nøkkeldata kuttet ved en blokkgrense, er ikke en nøkkel
+    std::string key = ED25519_KEY;
+    CHECK(validity(FieldKind::SshPublicKey, "ssh-ed25519 AAAAC3NzaC1lZDI1NTE5AAAA") == Validity::Incomplete);
+    CHECK(validity(FieldKind::SshPublicKey, key.substr(0, key.size() - 4)) == Validity::Incomplete);
+    CHECK(validity(FieldKind::SshPublicKey, key.substr(0, key.size() - 4) + " comment") == Validity::Invalid);
+    CHECK(validity(FieldKind::SshPublicKey, key + "AAAA") == Validity::Invalid);
+    CHECK(validity(FieldKind::SshPublicKey, key.substr(0, key.size() - 1) + "=") == Validity::Invalid);
+
+    CHECK(validity(FieldKind::SshPublicKey, key + " line\nbreak") == Validity::Invalid);
+    CHECK(validity(FieldKind::SshPublicKey, key + " tab\there") == Validity::Invalid);
+    CHECK(validity(FieldKind::SshPublicKey, key + " bell\x07") == Validity::Invalid);
+    CHECK(validity(FieldKind::SshPublicKey, key + " \xc3\xa6\xc3\xb8\xc3\xa5") == Validity::Valid);
+}
+
+void testHostnames() {
+    CHECK(validity(FieldKind::Hostname, "nixum-01.lan") == Validity::Valid);
+    CHECK(validity(FieldKind::Hostname, "Nixum") == Validity::Invalid);
+    CHECK(validity(FieldKind::Hostname, "a-") == Validity::Incomplete);
+    CHECK(validity(FieldKind::Hostname, "a.") == Validity::Incomplete);
+
+    ValidationResult leading = validateField(FieldKind::Hostname, "-a");
+    ValidationResult trailing = validateField(FieldKind::Hostname, "a-.b");
+    CHECK(leading.validity == Validity::Invalid && trailing.validity == Validity::Invalid);
+    CHECK(std::string(leading.message) != trailing.message);
+    CHECK(std::string(trailing.message).find("end") != std::string::npos);
+}
+
+} // namespace
+
+int main() {
+    testSshKeys();
+    testHostnames();
+    return testResult("field_validation_test");
+}
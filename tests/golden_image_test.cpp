@@ -0,0 +1,158 @@
+#include "golden_image.h"
+#include "test_support.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+const uint64_t MIB = 1024 * 1024;
+
+std::vector<unsigned char> readWhole(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void writeAt(int fd, const std::vector<unsigned char>& data, uint64_t offset) {
+    CHECK(pwrite(fd, data.data(), data.size(), offset) == static_cast<ssize_t>(data.size()));
+}
+
+std::vector<unsigned char> randomBytes(std::mt19937& random, size_t length) {
+    std::vector<unsigned char> data(length);
+    for (auto& byte : data) {
+        byte = static_cast<unsigned char>(random());
+    }
+    return data;
+}
+
+// En "partisjon" med data, nuller skrevet som data, hull og en kort siste bit som ikke er justert
+std::string makePartition(const TempDir& dir, const std::string& name, uint64_t sizeBytes, std::mt19937& random) {
+    std::string path = (dir.path / name).string();
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    CHECK(fd >= 0 && ftruncate(fd, sizeBytes) == 0);
+    writeAt(fd, randomBytes(random, 4096), 0);
+    writeAt(fd, std::vector<unsigned char>(GOLDEN_IMAGE_CHUNK_SIZE, 0), GOLDEN_IMAGE_CHUNK_SIZE);
+    writeAt(fd, randomBytes(random, GOLDEN_IMAGE_CHUNK_SIZE), 3 * GOLDEN_IMAGE_CHUNK_SIZE);
+    writeAt(fd, randomBytes(random, 1000), sizeBytes - 1000);
+    close(fd);
+    return path;
+}
+
+// Målet fylles med søppel først, så områdene imaget ikke har lagret faktisk må nulles
+std::string makeTarget(const TempDir& dir, const std::string& name, uint64_t sizeBytes, bool garbage) {
+    std::string path = (dir.path / name).string();
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    CHECK(fd >= 0 && ftruncate(fd, sizeBytes) == 0);
+    if (garbage) {
+        writeAt(fd, std::vector<unsigned char>(sizeBytes, 0xa5), 0);
+    }
+    close(fd);
+    return path;
+}
+
+struct RoundTrip {
+    TempDir dir;
+    std::mt19937 random{ 42 };
+    std::string boot;
+    std::string root;
+    std::string imageDir;
+    std::vector<std::string> logLines;
+    ImageLog log = [this](const std::string& line) { logLines.push_back(line); };
+
+    RoundTrip() {
+        boot = makePartition(dir, "boot.img", 16 * MIB + 1000, random);
+        root = makePartition(dir, "root.img", 20 * MIB, random);
+        imageDir = (dir.path / "image").string();
+    }
+};
+
+void testCaptureAndReplay() {
+    RoundTrip trip;
+    CHECK(captureGoldenImage({ { "NIXBOOT", trip.boot }, { "NIXROOT", trip.root } }, trip.imageDir, trip.log));
+
+    // Nullbiten og hullet lagres ikke: bit 0, bit 3 og den siste biten i hver partisjon
+    ImageManifest manifest;
+    std::string error;
+    CHECK(readImageManifest(trip.imageDir, manifest, error));
+    CHECK(manifest.partitions.size() == 2);
+    CHECK(manifest.partitions.size() == 2 && manifest.partitions[0].second == 16 * MIB + 1000);
+    CHECK(manifest.chunks.size() == 6);
+    CHECK(manifest.chunks.size() == 6 && manifest.chunks[2].length == 1000);
+
+    std::string bootTarget = makeTarget(trip.dir, "boot-target.img", 16 * MIB + 1000, true);
+    std::string rootTarget = makeTarget(trip.dir, "root-target.img", 24 * MIB, true);
+    CHECK(replayGoldenImage(trip.imageDir, { { "NIXBOOT", bootTarget }, { "NIXROOT", rootTarget } }, false, trip.log));
+    CHECK(readWhole(bootTarget) == readWhole(trip.boot));
+    std::vector<unsigned char> replayedRoot = readWhole(rootTarget);
+    replayedRoot.resize(20 * MIB); // Resten av en større partisjon røres ikke
+    CHECK(replayedRoot == readWhole(trip.root));
+
+    // Et nullet mål trenger bare bitene med data; en tom image-fil vokser til full størrelse
+    std::string zeroedBoot = makeTarget(trip.dir, "boot-zeroed.img", 0, false);
+    std::string zeroedRoot = makeTarget(trip.dir, "root-zeroed.img", 0, false);
+    CHECK(replayGoldenImage(trip.imageDir, { { "NIXBOOT", zeroedBoot }, { "NIXROOT", zeroedRoot } }, true, trip.log));
+    CHECK(readWhole(zeroedBoot) == readWhole(trip.boot));
+    CHECK(readWhole(zeroedRoot) == readWhole(trip.root));
+}
+
+void testCorruptImage() {
+    RoundTrip trip;
+    CHECK(captureGoldenImage({ { "NIXBOOT", trip.boot }, { "NIXROOT", trip.root } }, trip.imageDir, trip.log));
+    std::string data = trip.imageDir + "/NIXROOT.zst";
+    int fd = open(data.c_str(), O_RDWR);
+    unsigned char byte = 0;
+    CHECK(fd >= 0 && pread(fd, &byte, 1, 100) == 1);
+    byte ^= 0xff;
+    CHECK(pwrite(fd, &byte, 1, 100) == 1);
+    close(fd);
+
+    std::string bootTarget = makeTarget(trip.dir, "boot-target.img", 16 * MIB + 1000, false);
+    std::string rootTarget = makeTarget(trip.dir, "root-target.img", 20 * MIB, false);
+    CHECK(!replayGoldenImage(trip.imageDir, { { "NIXBOOT", bootTarget }, { "NIXROOT", rootTarget } }, false, trip.log));
+
+    // Uten manifest er imaget ufullstendig
+    CHECK(std::filesystem::remove(trip.imageDir + "/manifest"));
+    CHECK(!replayGoldenImage(trip.imageDir, { { "NIXBOOT", bootTarget }, { "NIXROOT", rootTarget } }, false, trip.log));
+}
+
+// Samme rundtur mot loop-enheter, der gapene nulles med BLKZEROOUT og bitene skrives med O_DIRECT
+bool testLoopDevices() {
+    if (geteuid() != 0 || !runQuiet("command -v losetup")) {
+        return false;
+    }
+    RoundTrip trip;
+    CHECK(captureGoldenImage({ { "NIXBOOT", trip.boot }, { "NIXROOT", trip.root } }, trip.imageDir, trip.log));
+    std::string bootTarget = makeTarget(trip.dir, "boot-target.img", 17 * MIB, true);
+    std::string rootTarget = makeTarget(trip.dir, "root-target.img", 20 * MIB, true);
+    std::string bootDevice = attachLoop(bootTarget);
+    std::string rootDevice = attachLoop(rootTarget);
+    if (bootDevice.empty() || rootDevice.empty()) {
+        runQuiet("losetup -d " + bootDevice);
+        return false;
+    }
+    CHECK(replayGoldenImage(trip.imageDir, { { "NIXBOOT", bootDevice }, { "NIXROOT", rootDevice } }, false, trip.log));
+    runQuiet("losetup -d " + bootDevice);
+    runQuiet("losetup -d " + rootDevice);
+
+    std::vector<unsigned char> replayedBoot = readWhole(bootTarget);
+    replayedBoot.resize(16 * MIB + 1000);
+    CHECK(replayedBoot == readWhole(trip.boot));
+    CHECK(readWhole(rootTarget) == readWhole(trip.root));
+    return true;
+}
+
+} // namespace
+
+int main() {
+    testCaptureAndReplay();
+    testCorruptImage();
+    if (!testLoopDevices()) {
+        fprintf(stderr, "golden_image_test: loop device test skipped (needs root and losetup)\n");
+    }
+    return testResult("golden_image_test");
+}
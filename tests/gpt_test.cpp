@@ -0,0 +1,148 @@
+#include "gpt.h"
+#include "test_support.h"
+
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+const uint64_t MIB = 1024 * 1024;
+
+uint32_t crc32(const uint8_t* data, size_t size) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; ++k) {
+            crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+        }
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+uint32_t le32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t le64(const uint8_t* p) {
+    return le32(p) | (static_cast<uint64_t>(le32(p + 4)) << 32);
+}
+
+std::string entryName(const uint8_t* entry) {
+    std::string name;
+    for (int c = 0; c < 36 && entry[56 + 2 * c] != 0; ++c) {
+        name += static_cast<char>(entry[56 + 2 * c]);
+    }
+    return name;
+}
+
+std::string imagePath(const TempDir& dir, uint64_t sizeBytes) {
+    std::string path = (dir.path / "disk.img").string();
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    CHECK(fd >= 0 && ftruncate(fd, static_cast<off_t>(sizeBytes)) == 0);
+    close(fd);
+    return path;
+}
+
+std::vector<uint8_t> readImage(const std::string& path, uint64_t offset, uint64_t size) {
+    std::vector<uint8_t> data(size);
+    int fd = open(path.c_str(), O_RDONLY);
+    CHECK(fd >= 0 && pread(fd, data.data(), size, static_cast<off_t>(offset)) == static_cast<ssize_t>(size));
+    close(fd);
+    return data;
+}
+
+// Primær og backup header med riktige CRC-er og en tabell som peker på hverandre, som sgdisk -v sjekker
+void checkGpt(const std::string& path, uint64_t sizeBytes) {
+    const uint64_t ss = 512;
+    uint64_t lastLba = sizeBytes / ss - 1;
+    std::vector<uint8_t> head = readImage(path, 0, 34 * ss);
+    std::vector<uint8_t> tail = readImage(path, (lastLba - 32) * ss, 33 * ss);
+
+    CHECK(head[510] == 0x55 && head[511] == 0xAA);
+    CHECK(head[446 + 4] == 0xEE);
+
+    const uint8_t* primary = head.data() + ss;
+    const uint8_t* backup = tail.data() + 32 * ss;
+    const uint8_t* entries = head.data() + 2 * ss;
+    const uint8_t* backupEntries = tail.data();
+    for (const uint8_t* header : { primary, backup }) {
+        CHECK(memcmp(header, "EFI PART", 8) == 0);
+        uint8_t copy[92];
+        memcpy(copy, header, 92);
+        memset(copy + 16, 0, 4);
+        CHECK(le32(header + 16) == crc32(copy, 92));
+        CHECK(le32(header + 88) == crc32(entries, GPT_ENTRY_COUNT * GPT_ENTRY_SIZE));
+        CHECK(le64(header + 40) == 34);
+        CHECK(le64(header + 48) == lastLba - 33);
+    }
+    CHECK(le64(primary + 24) == 1 && le64(primary + 32) == lastLba && le64(primary + 72) == 2);
+    CHECK(le64(backup + 24) == lastLba && le64(backup + 32) == 1 && le64(backup + 72) == lastLba - 32);
+    CHECK(memcmp(primary + 56, backup + 56, 16) == 0);
+    CHECK(memcmp(entries, backupEntries, GPT_ENTRY_COUNT * GPT_ENTRY_SIZE) == 0);
+
+    CHECK(entryName(entries) == "NIXBOOT");
+    CHECK(le64(entries + 32) == MIB / ss && le64(entries + 40) == 513 * MIB / ss - 1);
+    CHECK(entryName(entries + GPT_ENTRY_SIZE) == "NIXROOT");
+    CHECK(le64(entries + GPT_ENTRY_SIZE + 32) == 513 * MIB / ss);
+    CHECK(le64(entries + GPT_ENTRY_SIZE + 40) == lastLba - 33);
+    CHECK(entryName(entries + 2 * GPT_ENTRY_SIZE).empty());
+}
+
+void testImageFile() {
+    TempDir dir;
+    uint64_t sizeBytes = 2048 * MIB;
+    std::string path = imagePath(dir, sizeBytes);
+    // Gamle data i justeringsgapet skal bort
+    int fd = open(path.c_str(), O_RDWR);
+    CHECK(fd >= 0 && pwrite(fd, "stale", 5, 100 * 1024) == 5);
+    close(fd);
+
+    CHECK(partitionNixumDisk(path, [](const std::string&) {}));
+    checkGpt(path, sizeBytes);
+    CHECK(readImage(path, 100 * 1024, 5) == std::vector<uint8_t>(5, 0));
+}
+
+// Størrelsen er ikke et multiplum av 4 KiB, så slutten kan ikke skrives med O_DIRECT
+void testUnalignedTail() {
+    TempDir dir;
+    uint64_t sizeBytes = 2048 * MIB + 3 * 512;
+    std::string path = imagePath(dir, sizeBytes);
+    CHECK(partitionNixumDisk(path, [](const std::string&) {}));
+    checkGpt(path, sizeBytes);
+}
+
+void testLayout() {
+    GptLayout layout;
+    std::string error;
+    CHECK(!buildNixumLayout(512 * MIB, 512, layout, error));
+    CHECK(error == "disk is smaller than 1 GiB");
+    CHECK(!buildNixumLayout(2048 * MIB, 1000, layout, error));
+
+    CHECK(buildNixumLayout(4096 * MIB, 4096, layout, error));
+    CHECK(layout.totalSectors == 4096 * MIB / 4096);
+    CHECK(layout.partitions.size() == 2);
+    CHECK(layout.partitions[0].firstLba == 256);
+    CHECK(layout.partitions[1].firstLba == 513 * 256);
+    // 4096-byte sektorer: tabellen tar 4 sektorer
+    CHECK(layout.partitions[1].lastLba == layout.totalSectors - 2 - 4);
+    CHECK(memcmp(layout.partitions[0].uniqueGuid, layout.partitions[1].uniqueGuid, 16) != 0);
+}
+
+void testPartitionDevicePath() {
+    CHECK(partitionDevicePath("/dev/sda", 1) == "/dev/sda1");
+    CHECK(partitionDevicePath("/dev/nvme0n1", 2) == "/dev/nvme0n1p2");
+    CHECK(partitionDevicePath("/dev/mmcblk0", 1) == "/dev/mmcblk0p1");
+}
+
+} // namespace
+
+int main() {
+    testImageFile();
+    testUnalignedTail();
+    testLayout();
+    testPartitionDevicePath();
+    return testResult("gpt_test");
+}
@@ -0,0 +1,58 @@
+#include "install_steps.h"
+#include "test_support.h"
+#include "util.h"
+
+#include <sys/stat.h>
+
+namespace {
+
+std::string readWhole(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Et falskt "nixum_install" som skriver argumentene etter --helper til en fil, adskilt med NUL.
+// Katalogen har selv et ' i navnet, så også programstien må siteres riktig.
+std::filesystem::path writeRecordingHelper(const TempDir& dir) {
+    std::filesystem::path helper = dir.path / "it's here" / "nixum_install";
+    writeTestFile(helper,
+                  "#!/bin/sh\n"
+                  "[ \"$1\" = --helper ] || exit 1\n"
+                  "shift\n"
+                  "printf '%s\\0' \"$@\" > \"$(dirname \"$0\")/args\"\n");
+    chmod(helper.c_str(), 0755);
+    return helper;
+}
+
+// Hjelpekommandoene kjøres med bash -c, som runStepCommand gjør
+void testHelperArgumentsArriveUnchanged() {
+    TempDir dir;
+    std::filesystem::path helper = writeRecordingHelper(dir);
+    std::filesystem::path marker = dir.path / "pwned";
+    std::vector<std::string> args = {
+        "personalize",
+        "/mnt",
+        "ola's laptop",
+        "ola",
+        "ssh-ed25519 AAAA x'; touch " + marker.string() + " #",
+        "$(touch " + marker.string() + ") `touch " + marker.string() + "` $HOME \\ \"quoted\"",
+        "first line\nsecond line\n",
+        ""
+    };
+    std::string command = helperCommandLine(helper.string(), args);
+    CHECK(system(("bash -c " + shellQuote(command)).c_str()) == 0);
+
+    std::string expected;
+    for (const auto& arg : args) {
+        expected += arg + '\0';
+    }
+    CHECK(readWhole(helper.parent_path() / "args") == expected);
+    CHECK(!std::filesystem::exists(marker));
+}
+
+} // namespace
+
+int main() {
+    testHelperArgumentsArriveUnchanged();
+    return testResult("install_steps_test");
+}
@@ -0,0 +1,88 @@
+#include "preset_fetch.h"
+#include "test_support.h"
+#include "util.h"
+
+namespace {
+
+const char* GIT = "git -c user.name=nixum -c user.email=nixum@localhost -c init.defaultBranch=main ";
+
+// En bar repo med to forhåndsinnstillinger, som remoten hentingen går mot over file://
+std::string makeRemote(const TempDir& dir) {
+    std::filesystem::path work = dir.path / "work";
+    std::filesystem::path bare = dir.path / "nixum_config.git";
+    writeTestFile(work / "flake.nix",
+                  "{\n"
+                  "  outputs = { self }: {\n"
+                  "    hosts = builtins.attrNames (builtins.readDir ./hosts);\n"
+                  "    desktop = import ./hosts/desktop;\n"
+                  "    server = import ./hosts/server;\n"
+                  "  };\n"
+                  "}\n");
+    writeTestFile(work / "hosts" / "desktop" / "default.nix", "{ role = \"desktop\"; }\n");
+    writeTestFile(work / "hosts" / "server" / "default.nix", "{ role = \"server\"; }\n");
+    std::string git = GIT + std::string("-C ") + shellQuote(work.string()) + " ";
+    CHECK(runQuiet(GIT + std::string("init -q --bare ") + shellQuote(bare.string())));
+    CHECK(runQuiet(git + "init -q"));
+    CHECK(runQuiet(git + "add -A"));
+    CHECK(runQuiet(git + "commit -q -m 'Two presets'"));
+    CHECK(runQuiet(git + "push -q " + shellQuote(bare.string()) + " HEAD:main"));
+    return "file://" + bare.string();
+}
+
+PresetFetchOptions testOptions(const TempDir& dir, const std::string& remoteUrl) {
+    PresetFetchOptions options = defaultPresetFetchOptions("desktop");
+    options.remoteUrl = remoteUrl;
+    options.cacheDir = (dir.path / "cache").string();
+    options.mediaCacheDir = (dir.path / "media").string();
+    options.checkoutDir = (dir.path / "nixum_config").string();
+    return options;
+}
+
+void testFetchFromBareRepository() {
+    TempDir dir;
+    std::string remoteUrl = makeRemote(dir);
+    PresetFetchOptions options = testOptions(dir, remoteUrl);
+    CHECK(fetchPreset(0, options) == 0);
+
+    std::string commit = captureLine("git -C " + shellQuote(options.checkoutDir) + " rev-parse HEAD");
+    CHECK(commit == captureLine("git -C " + shellQuote((dir.path / "nixum_config.git").string()) + " rev-parse main"));
+    CHECK(std::filesystem::canonical(options.checkoutDir) == std::filesystem::canonical(dir.path / "cache" / commit));
+
+    // Hele tupp-commiten er hentet, også den andre forhåndsinnstillingen, og ingenting mangler
+    CHECK(std::filesystem::exists(std::filesystem::path(options.checkoutDir) / "hosts" / "server" / "default.nix"));
+    CHECK(captureLine("git -C " + shellQuote(options.checkoutDir) + " rev-list --objects --missing=print HEAD | grep '^?'").empty());
+    CHECK(runQuiet("git -C " + shellQuote(options.checkoutDir) + " diff --quiet HEAD"));
+
+    // Uten remoten brukes oppføringen i cachen
+    options.remoteUrl = "file://" + (dir.path / "missing.git").string();
+    CHECK(fetchPreset(0, options) == 0);
+    CHECK(std::filesystem::canonical(options.checkoutDir) == std::filesystem::canonical(dir.path / "cache" / commit));
+
+    // En forhåndsinnstilling som ikke finnes i commiten
+    options.preset = "htpc";
+    CHECK(fetchPreset(0, options) != 0);
+}
+
+// Checkouten brukes som flake av seed-store og build-system; Nix skal kunne kopiere hele commiten
+bool testFlakeArchive() {
+    if (!runQuiet("command -v nix")) {
+        return false;
+    }
+    TempDir dir;
+    PresetFetchOptions options = testOptions(dir, makeRemote(dir));
+    CHECK(fetchPreset(0, options) == 0);
+    std::string nix = "nix --extra-experimental-features 'nix-command flakes' ";
+    CHECK(runQuiet(nix + "flake archive --json " + shellQuote(presetFlakeReference(options.checkoutDir))));
+    CHECK(captureLine(nix + "eval --raw " + shellQuote(presetFlakeReference(options.checkoutDir) + "#server.role")) == "server");
+    return true;
+}
+
+} // namespace
+
+int main() {
+    testFetchFromBareRepository();
+    if (!testFlakeArchive()) {
+        fprintf(stderr, "preset_fetch_test: flake archive test skipped (needs nix)\n");
+    }
+    return testResult("preset_fetch_test");
+}
@@ -0,0 +1,154 @@
+#include "store_seed.h"
+#include "test_support.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include <unistd.h>
+
+namespace {
+
+// Stinavn med en hash-del på 32 tegn, som readNarInfo slår opp på
+std::string storePath(char hash, const std::string& name) {
+    return "/nix/store/" + std::string(32, hash) + "-" + name;
+}
+
+std::string baseName(const std::string& path) {
+    return path.substr(path.rfind('/') + 1);
+}
+
+void writeNarInfo(const TempDir& cache, const std::string& path, const std::vector<std::string>& references) {
+    std::string name = baseName(path);
+    std::string referenceNames;
+    for (const auto& reference : references) {
+        referenceNames += (referenceNames.empty() ? "" : " ") + baseName(reference);
+    }
+    writeTestFile(cache.path / (name.substr(0, 32) + ".narinfo"),
+                  "StorePath: " + path + "\n"
+                  "URL: nar/" + name.substr(0, 32) + ".nar.zst\n"
+                  "Compression: zstd\n"
+                  "FileSize: 1000\n"
+                  "NarSize: 4000\n"
+                  "References: " + referenceNames + "\n");
+}
+
+std::vector<std::string> sorted(std::vector<std::string> paths) {
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+void testParseDerivationGraph() {
+    // Eldre Nix: fulle stier og inputDrvs som liste. Nyere: stinavn og inputDrvs som objekt.
+    std::string json =
+        "{\"/nix/store/" + std::string(32, 'a') + "-top.drv\": {\"args\": [\"-e\", \"x\"], \"env\": {\"text\": \"quote \\\" and {brace}\"},"
+        " \"inputDrvs\": {\"/nix/store/" + std::string(32, 'b') + "-lib.drv\": [\"out\", \"dev\"]},"
+        " \"inputSrcs\": [\"/nix/store/" + std::string(32, 'c') + "-builder.sh\"],"
+        " \"outputs\": {\"out\": {\"path\": \"/nix/store/" + std::string(32, 'd') + "-top\"}}, \"system\": \"x86_64-linux\"},"
+        " \"" + std::string(32, 'b') + "-lib.drv\": {\"inputDrvs\": {\"" + std::string(32, 'e') + "-cc.drv\": {\"dynamicOutputs\": {}, \"outputs\": [\"out\"]}},"
+        " \"inputSrcs\": [], \"outputs\": {\"dev\": {\"path\": \"" + std::string(32, 'f') + "-lib-dev\"}, \"out\": {\"path\": \"" +
+        std::string(32, 'g') + "-lib\"}, \"doc\": {\"hashAlgo\": \"sha256\", \"method\": \"nar\"}}}}";
+    DerivationGraph graph;
+    CHECK(parseDerivationGraph(json, graph));
+    CHECK(graph.size() == 2);
+
+    const StoreDerivation& top = graph[storePath('a', "top.drv")];
+    CHECK(top.outputs.size() == 1 && top.outputs.at("out") == storePath('d', "top"));
+    CHECK(top.inputDerivations.size() == 1);
+    CHECK(top.inputDerivations.size() == 1 && top.inputDerivations[0].first == storePath('b', "lib.drv"));
+    CHECK(top.inputDerivations.size() == 1 && top.inputDerivations[0].second == std::vector<std::string>({ "out", "dev" }));
+    CHECK(top.inputSources == std::vector<std::string>({ storePath('c', "builder.sh") }));
+
+    const StoreDerivation& lib = graph[storePath('b', "lib.drv")];
+    CHECK(lib.outputs.size() == 3 && lib.outputs.at("dev") == storePath('f', "lib-dev"));
+    CHECK(lib.outputs.size() == 3 && lib.outputs.at("doc").empty()); // Flytende utdata er ikke kjent på forhånd
+    CHECK(lib.inputDerivations.size() == 1 && lib.inputDerivations[0].first == storePath('e', "cc.drv"));
+    CHECK(lib.inputDerivations.size() == 1 && lib.inputDerivations[0].second == std::vector<std::string>({ "out" }));
+
+    DerivationGraph broken;
+    CHECK(!parseDerivationGraph("{\"/nix/store/x.drv\": {\"outputs\": ", broken));
+}
+
+// toplevel og c må bygges; a og d finnes i cachen, b via referansen fra a. x er bare inndata til a
+// og trengs ikke, og heller ikke d.dev, som ingen bruker.
+void testPlanFromBinaryCache() {
+    TempDir cache;
+    std::string top = storePath('1', "toplevel"), a = storePath('2', "a"), b = storePath('3', "b"), c = storePath('4', "c"),
+                d = storePath('5', "d"), dDev = storePath('6', "d-dev"), x = storePath('7', "x");
+    writeNarInfo(cache, a, { a, b });
+    writeNarInfo(cache, b, {});
+    writeNarInfo(cache, d, {});
+    writeNarInfo(cache, x, {});
+
+    DerivationGraph graph;
+    graph[storePath('a', "toplevel.drv")] = { { { "out", top } }, { { storePath('b', "a.drv"), { "out" } }, { storePath('c', "c.drv"), { "out" } } }, {} };
+    graph[storePath('b', "a.drv")] = { { { "out", a } }, { { storePath('d', "x.drv"), { "out" } } }, {} };
+    graph[storePath('c', "c.drv")] = { { { "out", c } }, { { storePath('e', "d.drv"), { "out" } } }, {} };
+    graph[storePath('d', "x.drv")] = { { { "out", x } }, {}, {} };
+    graph[storePath('e', "d.drv")] = { { { "out", d }, { "dev", dDev } }, {}, {} };
+
+    StoreSeedOptions options = defaultStoreSeedOptions("/nonexistent");
+    options.binaryCacheDir = cache.path.string();
+    std::vector<std::string> logLines;
+    StoreSeedLog log = [&logLines](const std::string& line) { logLines.push_back(line); };
+    StoreSeedPlan plan = planStoreSeed(storePath('a', "toplevel.drv"), graph, options, log);
+    CHECK(plan.local.empty());
+    CHECK(sorted(plan.cached) == sorted({ a, b, d }));
+    CHECK(sorted(plan.missing) == sorted({ top, c }));
+
+    // Uten cache må alt bygges, helt ned til bladene
+    options.binaryCacheDir.clear();
+    plan = planStoreSeed(storePath('a', "toplevel.drv"), graph, options, log);
+    CHECK(plan.cached.empty());
+    CHECK(sorted(plan.missing) == sorted({ top, a, c, d, x }));
+
+    CHECK(planStoreSeed(storePath('f', "unknown.drv"), graph, options, log).missing.empty());
+}
+
+// Med en ekte Nix-store: én sti kopieres fra live-systemet og registreres med --load-db, en annen
+// finnes bare i en file://-cache og hentes derfra. Begge skal være gyldige i målets database.
+bool testSeedWithNix() {
+    if (geteuid() != 0 || !runQuiet("command -v nix-store") || !runQuiet("command -v nix")) {
+        return false;
+    }
+    TempDir dir;
+    writeTestFile(dir.path / "local-file", "seeded from the live store\n");
+    writeTestFile(dir.path / "cached-file", "seeded from the binary cache\n");
+    std::string localPath = captureLine("nix-store --add " + (dir.path / "local-file").string());
+    std::string cachedPath = captureLine("nix-store --add " + (dir.path / "cached-file").string());
+    std::string cacheDir = (dir.path / "cache").string();
+    if (localPath.empty() || cachedPath.empty() ||
+        !runQuiet("nix --extra-experimental-features nix-command copy --to file://" + cacheDir + " " + cachedPath) ||
+        !runQuiet("nix-store --delete " + cachedPath)) {
+        return false;
+    }
+
+    DerivationGraph graph;
+    std::string root = storePath('a', "seed-test.drv");
+    graph[root] = { { { "out", localPath }, { "cached", cachedPath } }, {}, {} };
+    StoreSeedOptions options = defaultStoreSeedOptions((dir.path / "target").string());
+    options.binaryCacheDir = cacheDir;
+    std::vector<std::string> logLines;
+    StoreSeedLog log = [&logLines](const std::string& line) { logLines.push_back(line); };
+
+    StoreSeedReport report;
+    CHECK(seedTargetStore(root, graph, options, report, log));
+    CHECK(report.localPaths == 1);
+    CHECK(report.cachePaths == 1);
+    CHECK(report.networkPaths == 0);
+    std::string target = options.targetRoot;
+    CHECK(access((target + localPath).c_str(), F_OK) == 0);
+    CHECK(access((target + cachedPath).c_str(), F_OK) == 0);
+    CHECK(runQuiet("nix-store --store " + target + " --check-validity " + localPath + " " + cachedPath));
+    return true;
+}
+
+} // namespace
+
+int main() {
+    testParseDerivationGraph();
+    testPlanFromBinaryCache();
+    if (!testSeedWithNix()) {
+        fprintf(stderr, "store_seed_test: Nix store test skipped (needs root, nix and nix-store)\n");
+    }
+    return testResult("store_seed_test");
+}
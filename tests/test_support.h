@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+// Det lille testene trenger: CHECK teller feil i stedet for å avbryte, så én kjøring viser alle,
+// en midlertidig katalog for falske sysfs-trær og imagefiler som ryddes når testen er ferdig, og
+// kommandoene testene som trenger root eller eksterne verktøy kjører.
+
+inline int testFailures = 0;
+
+#define CHECK(condition)                                                                      \
+    do {                                                                                      \
+        if (!(condition)) {                                                                   \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition);     \
+            testFailures++;                                                                   \
+        }                                                                                     \
+    } while (0)
+
+struct TempDir {
+    std::filesystem::path path;
+
+    TempDir() {
+        char pattern[] = "/tmp/nixum-test-XXXXXX";
+        if (mkdtemp(pattern) == nullptr) {
+            perror("mkdtemp");
+            exit(1);
+        }
+        path = pattern;
+    }
+    ~TempDir() {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    }
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+};
+
+// Lager foreldrekatalogene ved behov
+inline void writeTestFile(const std::filesystem::path& path, const std::string& contents) {
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream file(path, std::ios::binary);
+    file << contents;
+}
+
+// For kommandoer der bare statusen teller, f.eks. "command -v losetup"
+inline bool runQuiet(const std::string& command) {
+    return system((command + " >/dev/null 2>&1").c_str()) == 0;
+}
+
+// Første linje av stdout uten linjeskift, tom hvis kommandoen ikke skrev noe
+inline std::string captureLine(const std::string& command) {
+    std::string output;
+    FILE* pipe = popen(command.c_str(), "r");
+    if (pipe == nullptr) {
+        return output;
+    }
+    char line[512];
+    if (fgets(line, sizeof(line), pipe) != nullptr) {
+        output = line;
+        output.erase(output.find_last_not_of("\n") + 1);
+    }
+    pclose(pipe);
+    return output;
+}
+
+// Kobler en imagefil til en ledig loop-enhet og gir enheten, f.eks. /dev/loop3 (krever root)
+inline std::string attachLoop(const std::string& image) {
+    return captureLine("losetup --find --show " + image);
+}
+
+inline int testResult(const char* name) {
+    if (testFailures > 0) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, testFailures);
+        return 1;
+    }
+    fprintf(stderr, "%s: ok\n", name);
+    return 0;
+}
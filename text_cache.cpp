@@ -0,0 +1,136 @@
+#include "text_cache.h"
+
+#include <iostream>
+#include <list>
+#include <unordered_map>
+
+namespace {
+
+struct TextCacheKey {
+    std::string text;
+    TTF_Font* font;
+    Uint32 color;
+    int style;
+    int wrapLength;
+
+    bool operator==(const TextCacheKey& other) const {
+        return font == other.font && color == other.color && style == other.style &&
+               wrapLength == other.wrapLength && text == other.text;
+    }
+};
+
+struct TextCacheKeyHash {
+    size_t operator()(const TextCacheKey& key) const {
+        size_t h = std::hash<std::string>()(key.text);
+        h ^= std::hash<const void*>()(key.font) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        h ^= std::hash<Uint64>()((static_cast<Uint64>(key.color) << 32) ^
+                                 (static_cast<Uint64>(key.style) << 24) ^
+                                 static_cast<Uint32>(key.wrapLength)) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        return h;
+    }
+};
+
+struct TextCacheEntry {
+    TextCacheKey key;
+    SDL_Texture* texture;
+    int width, height;
+};
+
+// Mest brukte oppføring ligger først i listen
+std::list<TextCacheEntry> lruList;
+std::unordered_map<TextCacheKey, std::list<TextCacheEntry>::iterator, TextCacheKeyHash> lruIndex;
+TextCacheStats stats = { 0, 0, 0 };
+
+Uint32 packColor(SDL_Color color) {
+    return (static_cast<Uint32>(color.r) << 24) | (static_cast<Uint32>(color.g) << 16) |
+           (static_cast<Uint32>(color.b) << 8) | color.a;
+}
+
+void evictOldest() {
+    const TextCacheEntry& oldest = lruList.back();
+    SDL_DestroyTexture(oldest.texture);
+    lruIndex.erase(oldest.key);
+    lruList.pop_back();
+    stats.evictions++;
+}
+
+} // namespace
+
+SDL_Texture* getTextTexture(SDL_Renderer* renderer, TTF_Font* font, const std::string& text, SDL_Color color, bool bold, int wrapLength, int* width, int* height) {
+    int style = bold ? TTF_STYLE_BOLD : TTF_STYLE_NORMAL;
+    TextCacheKey key = { text, font, packColor(color), style, wrapLength > 0 ? wrapLength : 0 };
+
+    auto found = lruIndex.find(key);
+    if (found != lruIndex.end()) {
+        stats.hits++;
+        lruList.splice(lruList.begin(), lruList, found->second);
+        *width = found->second->width;
+        *height = found->second->height;
+        return found->second->texture;
+    }
+    stats.misses++;
+
+    TTF_SetFontStyle(font, style);
+    SDL_Surface* surface;
+    if (wrapLength > 0) {
+        surface = TTF_RenderText_Blended_Wrapped(font, text.c_str(), color, wrapLength);
+    } else {
+        surface = TTF_RenderText_Blended(font, text.c_str(), color);
+    }
+
+    if (surface == nullptr || surface->w == 0) {
+        std::cerr << "TTF_RenderText_Blended_Wrapped Error: " << TTF_GetError() << std::endl;
+        if (surface != nullptr) {
+            SDL_FreeSurface(surface);
+        }
+        return nullptr;
+    }
+    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
+    int w = surface->w;
+    int h = surface->h;
+    SDL_FreeSurface(surface);
+    if (texture == nullptr) {
+        std::cerr << "SDL_CreateTextureFromSurface Error: " << SDL_GetError() << std::endl;
+        return nullptr;
+    }
+
+    if (lruList.size() >= TEXT_CACHE_CAPACITY) {
+        evictOldest();
+    }
+    lruList.push_front({ key, texture, w, h });
+    lruIndex[key] = lruList.begin();
+
+    *width = w;
+    *height = h;
+    return texture;
+}
+
+void invalidateTextCache(TTF_Font* font, const std::string& text, SDL_Color color, bool bold, int wrapLength) {
+    TextCacheKey key = { text, font, packColor(color), bold ? TTF_STYLE_BOLD : TTF_STYLE_NORMAL, wrapLength > 0 ? wrapLength : 0 };
+    auto found = lruIndex.find(key);
+    if (found == lruIndex.end()) {
+        return;
+    }
+    SDL_DestroyTexture(found->second->texture);
+    lruList.erase(found->second);
+    lruIndex.erase(found);
+}
+
+void clearTextCache() {
+    for (auto& entry : lruList) {
+        SDL_DestroyTexture(entry.texture);
+    }
+    lruList.clear();
+    lruIndex.clear();
+}
+
+const TextCacheStats& getTextCacheStats() {
+    return stats;
+}
+
+void printTextCacheStats() {
+    Uint64 lookups = stats.hits + stats.misses;
+    double hitRate = lookups > 0 ? 100.0 * static_cast<double>(stats.hits) / static_cast<double>(lookups) : 0.0;
+    std::cerr << "Text cache: " << stats.hits << " hits, " << stats.misses << " misses ("
+              << hitRate << "% hit rate), " << stats.evictions << " evictions" << std::endl;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <string>
+
+// Ferdigrendrede teksttexturer, nøklet på (tekst, stil, farge, bryting).
+// Uendret tekst blir en enkel SDL_RenderCopy i stedet for ny rasterisering hver frame.
+const size_t TEXT_CACHE_CAPACITY = 256;
+
+struct TextCacheStats {
+    Uint64 hits;
+    Uint64 misses;
+    Uint64 evictions;
+};
+
+// Returnerer en texture for teksten, rasteriserer den ved første bruk.
+// Texturen eies av cachen og må ikke frigjøres av kalleren.
+SDL_Texture* getTextTexture(SDL_Renderer* renderer, TTF_Font* font, const std::string& text, SDL_Color color, bool bold, int wrapLength, int* width, int* height);
+
+// Fjerner oppføringen med nøyaktig denne nøkkelen (f.eks. når TextField::value endres). Samme tekst
+// tegnet av andre widgeter, med annen font, farge eller bryting, blir liggende.
+void invalidateTextCache(TTF_Font* font, const std::string& text, SDL_Color color, bool bold, int wrapLength);
+void clearTextCache();
+
+const TextCacheStats& getTextCacheStats();
+void printTextCacheStats();
@@ -0,0 +1,239 @@
+#include "text_layout.h"
+
+#include <algorithm>
+#include <iostream>
+#include <list>
+#include <unordered_map>
+
+namespace {
+
+struct TextLayoutKey {
+    std::string text;
+    TTF_Font* font;
+    int style;
+    int wrapLength;
+
+    bool operator==(const TextLayoutKey& other) const {
+        return font == other.font && style == other.style && wrapLength == other.wrapLength && text == other.text;
+    }
+};
+
+struct TextLayoutKeyHash {
+    size_t operator()(const TextLayoutKey& key) const {
+        size_t h = std::hash<std::string>()(key.text);
+        h ^= std::hash<const void*>()(key.font) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        h ^= std::hash<Uint64>()((static_cast<Uint64>(key.style) << 32) ^ static_cast<Uint32>(key.wrapLength)) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        return h;
+    }
+};
+
+struct TextLayoutEntry {
+    TextLayoutKey key;
+    TextLayout layout;
+};
+
+// Glyfbredder per font og stil, slått opp én gang per tegn
+struct AdvanceTable {
+    TTF_Font* font;
+    int style;
+    std::unordered_map<Uint32, int> advances;
+};
+
+// Mest brukte oppføring ligger først i listen
+std::list<TextLayoutEntry> lruList;
+std::unordered_map<TextLayoutKey, std::list<TextLayoutEntry>::iterator, TextLayoutKeyHash> lruIndex;
+std::vector<AdvanceTable> advanceTables;
+TextLayoutStats stats = { 0, 0, 0 };
+
+AdvanceTable& advanceTable(TTF_Font* font, int style) {
+    for (auto& table : advanceTables) {
+        if (table.font == font && table.style == style) {
+            return table;
+        }
+    }
+    advanceTables.push_back({ font, style, {} });
+    return advanceTables.back();
+}
+
+// Tegn fonten mangler (og tegn utenfor BMP) tar ingen plass, som i glyfatlaset
+int glyphAdvance(AdvanceTable& table, Uint32 cp) {
+    auto found = table.advances.find(cp);
+    if (found != table.advances.end()) {
+        return found->second;
+    }
+    int advance = 0;
+    int minx, maxx, miny, maxy;
+    if (cp > 0xFFFF || !TTF_GlyphIsProvided(table.font, static_cast<Uint16>(cp)) ||
+        TTF_GlyphMetrics(table.font, static_cast<Uint16>(cp), &minx, &maxx, &miny, &maxy, &advance) != 0) {
+        advance = 0;
+    }
+    table.advances[cp] = advance;
+    return advance;
+}
+
+void buildLayout(TTF_Font* font, const std::string& text, int style, int wrapLength, TextLayout& layout) {
+    TTF_SetFontStyle(font, style);
+    AdvanceTable& table = advanceTable(font, style);
+
+    // Første pass: dekod tegnene og slå opp breddene
+    for (size_t pos = 0; pos < text.size();) {
+        size_t start = pos;
+        Uint32 cp = nextUtf8Codepoint(text, pos);
+        int advance = cp == '\n' ? 0 : glyphAdvance(table, cp);
+        layout.chars.push_back({ cp, start, 0, advance, 0, cp != '\n' });
+    }
+    TTF_SetFontStyle(font, TTF_STYLE_NORMAL);
+
+    // Andre pass: bryt på ordgrenser når ordet ikke får plass på linjen
+    layout.lineSkip = TTF_FontLineSkip(font);
+    layout.byteLength = text.size();
+    int penX = 0;
+    int line = 0;
+    bool atWordStart = true;
+    layout.lines.push_back({ 0, 0, 0, 0 });
+    auto newLine = [&](size_t firstChar) {
+        layout.lines.back().endChar = firstChar;
+        layout.lines.back().width = penX;
+        penX = 0;
+        line++;
+        layout.lines.push_back({ firstChar, firstChar, line * layout.lineSkip, 0 });
+    };
+    for (size_t i = 0; i < layout.chars.size(); i++) {
+        LaidOutChar& c = layout.chars[i];
+        if (c.codepoint == '\n') {
+            c.x = penX;
+            c.line = line;
+            newLine(i + 1);
+            atWordStart = true;
+            continue;
+        }
+        if (wrapLength > 0 && atWordStart && c.codepoint != ' ' && penX > 0) {
+            int wordWidth = 0;
+            for (size_t j = i; j < layout.chars.size() && layout.chars[j].codepoint != ' ' && layout.chars[j].codepoint != '\n'; j++) {
+                wordWidth += layout.chars[j].advance;
+            }
+            if (penX + wordWidth > wrapLength) {
+                newLine(i);
+            }
+        }
+        atWordStart = c.codepoint == ' ';
+        c.x = penX;
+        c.line = line;
+        // Mellomrom i starten av en linje etter den første tegnes ikke og tar ingen plass
+        if (c.codepoint == ' ' && penX == 0 && line > 0) {
+            c.drawn = false;
+            continue;
+        }
+        penX += c.advance;
+    }
+    layout.lines.back().endChar = layout.chars.size();
+    layout.lines.back().width = penX;
+
+    layout.width = 0;
+    for (const auto& laidOut : layout.lines) {
+        layout.width = std::max(layout.width, laidOut.width);
+    }
+    layout.height = layout.lines.back().y + TTF_FontHeight(font);
+}
+
+} // namespace
+
+// Dekoder ett UTF-8-tegn og flytter pos forbi det. Ugyldige bytes gir U+FFFD.
+Uint32 nextUtf8Codepoint(const std::string& text, size_t& pos) {
+    unsigned char c = static_cast<unsigned char>(text[pos++]);
+    if (c < 0x80) {
+        return c;
+    }
+    int extra = (c >= 0xF0) ? 3 : (c >= 0xE0) ? 2 : (c >= 0xC0) ? 1 : -1;
+    if (extra < 0) {
+        return 0xFFFD;
+    }
+    Uint32 cp = c & (0x3F >> extra);
+    for (int i = 0; i < extra; ++i) {
+        if (pos >= text.size() || (static_cast<unsigned char>(text[pos]) & 0xC0) != 0x80) {
+            return 0xFFFD;
+        }
+        cp = (cp << 6) | (static_cast<unsigned char>(text[pos++]) & 0x3F);
+    }
+    return cp;
+}
+
+const TextLayout& getTextLayout(TTF_Font* font, const std::string& text, bool bold, int wrapLength) {
+    TextLayoutKey key = { text, font, bold ? TTF_STYLE_BOLD : TTF_STYLE_NORMAL, wrapLength > 0 ? wrapLength : 0 };
+    auto found = lruIndex.find(key);
+    if (found != lruIndex.end()) {
+        stats.hits++;
+        lruList.splice(lruList.begin(), lruList, found->second);
+        return found->second->layout;
+    }
+    stats.misses++;
+
+    if (lruList.size() >= TEXT_LAYOUT_CACHE_CAPACITY) {
+        lruIndex.erase(lruList.back().key);
+        lruList.pop_back();
+        stats.evictions++;
+    }
+    lruList.push_front({ key, TextLayout() });
+    buildLayout(font, text, key.style, key.wrapLength, lruList.front().layout);
+    lruIndex[key] = lruList.begin();
+    return lruList.front().layout;
+}
+
+void caretPosition(const TextLayout& layout, size_t byteOffset, int* x, int* y) {
+    auto it = std::lower_bound(layout.chars.begin(), layout.chars.end(), byteOffset,
+                               [](const LaidOutChar& c, size_t offset) { return c.byteOffset < offset; });
+    int caretX = 0;
+    int line = 0;
+    if (it != layout.chars.end()) {
+        caretX = it->x;
+        line = it->line;
+    } else if (!layout.chars.empty()) {
+        const LaidOutChar& last = layout.chars.back();
+        line = static_cast<int>(layout.lines.size()) - 1;
+        caretX = last.codepoint == '\n' ? 0 : layout.lines.back().width;
+    }
+    if (x != nullptr) {
+        *x = caretX;
+    }
+    if (y != nullptr) {
+        *y = layout.lines[line].y;
+    }
+}
+
+size_t byteOffsetAtPoint(const TextLayout& layout, int x, int y) {
+    int line = layout.lineSkip > 0 ? y / layout.lineSkip : 0;
+    line = std::max(0, std::min(line, static_cast<int>(layout.lines.size()) - 1));
+    const LaidOutLine& laidOut = layout.lines[line];
+    for (size_t i = laidOut.firstChar; i < laidOut.endChar; i++) {
+        const LaidOutChar& c = layout.chars[i];
+        if (c.codepoint == '\n' || x < c.x + c.advance / 2) {
+            return c.byteOffset;
+        }
+    }
+    return laidOut.endChar < layout.chars.size() ? layout.chars[laidOut.endChar].byteOffset : layout.byteLength;
+}
+
+void visibleLines(const TextLayout& layout, int top, int bottom, size_t* first, size_t* end) {
+    long long lineSkip = std::max(1, layout.lineSkip);
+    long long firstLine = top <= 0 ? 0 : top / lineSkip;
+    long long endLine = bottom <= 0 ? 0 : (bottom + lineSkip - 1) / lineSkip;
+    *first = static_cast<size_t>(std::min<long long>(firstLine, layout.lines.size()));
+    *end = static_cast<size_t>(std::min<long long>(std::max(firstLine, endLine), layout.lines.size()));
+}
+
+void clearTextLayoutCache() {
+    lruList.clear();
+    lruIndex.clear();
+    advanceTables.clear();
+}
+
+const TextLayoutStats& getTextLayoutStats() {
+    return stats;
+}
+
+void printTextLayoutStats() {
+    Uint64 lookups = stats.hits + stats.misses;
+    double hitRate = lookups > 0 ? 100.0 * static_cast<double>(stats.hits) / static_cast<double>(lookups) : 0.0;
+    std::cerr << "Text layout cache: " << stats.hits << " hits, " << stats.misses << " misses ("
+              << hitRate << "% hit rate), " << stats.evictions << " evictions" << std::endl;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <string>
+#include <vector>
+
+// Linjebryting og tegnposisjoner for (tekst, font, stil, bryting), regnet ut én gang fra
+// glyfmetrikken (TTF_GlyphMetrics) og bufret. Ingenting rasteriseres for å måle.
+// Bryter på mellomrom slik TTF_RenderText_Blended_Wrapped gjør.
+const size_t TEXT_LAYOUT_CACHE_CAPACITY = 512;
+
+struct LaidOutChar {
+    Uint32 codepoint;
+    size_t byteOffset; // Hvor tegnet starter i teksten
+    int x;             // Relativt til starten av linjen
+    int advance;
+    int line;
+    bool drawn;        // false for linjeskift og mellomrom i starten av en brutt linje
+};
+
+struct LaidOutLine {
+    size_t firstChar; // [firstChar, endChar) i chars
+    size_t endChar;
+    int y;
+    int width;
+};
+
+struct TextLayout {
+    std::vector<LaidOutChar> chars;
+    std::vector<LaidOutLine> lines; // Minst én linje, også for tom tekst
+    int width;
+    int height;
+    int lineSkip;
+    size_t byteLength;
+};
+
+struct TextLayoutStats {
+    Uint64 hits;
+    Uint64 misses;
+    Uint64 evictions;
+};
+
+// Dekoder ett UTF-8-tegn og flytter pos forbi det. Ugyldige bytes gir U+FFFD.
+Uint32 nextUtf8Codepoint(const std::string& text, size_t& pos);
+
+// Bufret layout. Referansen er gyldig til neste kall som kan legge til i bufferet.
+const TextLayout& getTextLayout(TTF_Font* font, const std::string& text, bool bold, int wrapLength);
+
+// Markørposisjon foran tegnet som starter på byteOffset; text.size() gir slutten av teksten
+void caretPosition(const TextLayout& layout, size_t byteOffset, int* x, int* y);
+
+// Byteoffset for markøren nærmest punktet (relativt til tekstens øvre venstre hjørne)
+size_t byteOffsetAtPoint(const TextLayout& layout, int x, int y);
+
+// Linjene [first, end) som berører det loddrette området [top, bottom) relativt til teksten
+void visibleLines(const TextLayout& layout, int top, int bottom, size_t* first, size_t* end);
+
+void clearTextLayoutCache();
+const TextLayoutStats& getTextLayoutStats();
+void printTextLayoutStats();
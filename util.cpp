@@ -0,0 +1,277 @@
+#include "util.h"
+
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+std::string mebibytes(uint64_t bytes) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.1f MiB", bytes / (1024.0 * 1024.0));
+    return text;
+}
+
+std::string gibibytes(uint64_t bytes) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.1f GiB", bytes / (1024.0 * 1024.0 * 1024.0));
+    return text;
+}
+
+bool deviceSize(int fd, bool& isBlockDevice, uint64_t& size) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return false;
+    }
+    isBlockDevice = S_ISBLK(st.st_mode);
+    if (isBlockDevice) {
+        return ioctl(fd, BLKGETSIZE64, &size) == 0;
+    }
+    size = st.st_size;
+    return true;
+}
+
+std::string shellQuote(const std::string& value) {
+    std::string quoted = "'";
+    for (char c : value) {
+        if (c == '\'') {
+            quoted += "'\\''";
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "'";
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool captureLines(const std::string& command, const std::function<void(const std::string&)>& onLine, bool includeStderr) {
+    std::string wrapped = "{ " + command + "\n} </dev/null" + (includeStderr ? " 2>&1" : "");
+    FILE* pipe = popen(wrapped.c_str(), "r");
+    if (pipe == nullptr) {
+        return false;
+    }
+    // Lange linjer, f.eks. JSON fra Nix, kommer i flere biter
+    std::array<char, 8192> buffer;
+    std::string line;
+    while (fgets(buffer.data(), buffer.size(), pipe) != nullptr) {
+        line += buffer.data();
+        if (line.back() == '\n') {
+            line.pop_back();
+            if (!line.empty()) {
+                onLine(line);
+            }
+            line.clear();
+        }
+    }
+    if (!line.empty()) {
+        onLine(line);
+    }
+    return pclose(pipe) == 0;
+}
+
+bool captureLines(const std::string& command, std::vector<std::string>& lines) {
+    lines.clear();
+    return captureLines(command, [&lines](const std::string& line) { lines.push_back(line); });
+}
+
+namespace {
+
+void appendUtf8(std::string& out, unsigned code) {
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800) {
+        out += static_cast<char>(0xc0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3f));
+    } else if (code < 0x10000) {
+        out += static_cast<char>(0xe0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (code & 0x3f));
+    } else {
+        out += static_cast<char>(0xf0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (code & 0x3f));
+    }
+}
+
+} // namespace
+
+void JsonReader::skipSpace() {
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r' || text[pos] == '\n')) {
+        pos++;
+    }
+}
+
+bool JsonReader::consume(char c) {
+    skipSpace();
+    if (pos < text.size() && text[pos] == c) {
+        pos++;
+        return true;
+    }
+    return false;
+}
+
+bool JsonReader::readString(std::string& out) {
+    if (!consume('"')) {
+        return false;
+    }
+    out.clear();
+    auto readHex = [this](unsigned& code) {
+        if (pos + 4 > text.size()) {
+            return false;
+        }
+        char* end = nullptr;
+        std::string digits = text.substr(pos, 4);
+        code = strtoul(digits.c_str(), &end, 16);
+        pos += 4;
+        return end == digits.c_str() + 4;
+    };
+    while (pos < text.size()) {
+        char c = text[pos++];
+        if (c == '"') {
+            return true;
+        }
+        if (c != '\\') {
+            out += c;
+            continue;
+        }
+        if (pos >= text.size()) {
+            return false;
+        }
+        char escaped = text[pos++];
+        switch (escaped) {
+            case 'n': out += '\n'; break;
+            case 't': out += '\t'; break;
+            case 'r': out += '\r'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'u': {
+                unsigned code = 0;
+                if (!readHex(code)) {
+                    return false;
+                }
+                // Tegn utenfor BMP kommer som surrogatpar; et par uten andre halvdel blir U+FFFD
+                if (code >= 0xd800 && code <= 0xdbff && text.compare(pos, 2, "\\u") == 0) {
+                    unsigned low = 0;
+                    pos += 2;
+                    if (!readHex(low)) {
+                        return false;
+                    }
+                    code = low >= 0xdc00 && low <= 0xdfff ? 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00) : 0xfffd;
+                } else if (code >= 0xd800 && code <= 0xdfff) {
+                    code = 0xfffd;
+                }
+                appendUtf8(out, code);
+                break;
+            }
+            default: out += escaped; break;
+        }
+    }
+    return false;
+}
+
+bool JsonReader::readScalar(std::string& out) {
+    skipSpace();
+    size_t start = pos;
+    while (pos < text.size() && text[pos] != ',' && text[pos] != ']' && text[pos] != '}' && text[pos] != ' ' && text[pos] != '\t' &&
+           text[pos] != '\r' && text[pos] != '\n') {
+        pos++;
+    }
+    out = text.substr(start, pos - start);
+    return pos > start;
+}
+
+bool JsonReader::readValue(std::string& out) {
+    skipSpace();
+    if (pos < text.size() && text[pos] == '"') {
+        return readString(out);
+    }
+    if (pos < text.size() && (text[pos] == '[' || text[pos] == '{')) {
+        out.clear();
+        return skipValue();
+    }
+    return readScalar(out);
+}
+
+bool JsonReader::skipValue() {
+    skipSpace();
+    if (pos >= text.size()) {
+        return false;
+    }
+    std::string ignored;
+    if (text[pos] == '"') {
+        return readString(ignored);
+    }
+    if (text[pos] == '{') {
+        return readObject([this](const std::string&) { return skipValue(); });
+    }
+    if (text[pos] == '[') {
+        pos++;
+        if (consume(']')) {
+            return true;
+        }
+        do {
+            if (!skipValue()) {
+                return false;
+            }
+        } while (consume(','));
+        return consume(']');
+    }
+    return readScalar(ignored);
+}
+
+bool JsonReader::readObject(const std::function<bool(const std::string&)>& onEntry) {
+    if (!consume('{')) {
+        return false;
+    }
+    if (consume('}')) {
+        return true;
+    }
+    do {
+        std::string key;
+        if (!readString(key) || !consume(':') || !onEntry(key)) {
+            return false;
+        }
+    } while (consume(','));
+    return consume('}');
+}
+
+bool JsonReader::readStringList(std::vector<std::string>& out) {
+    if (!consume('[')) {
+        return false;
+    }
+    if (consume(']')) {
+        return true;
+    }
+    do {
+        std::string value;
+        if (!readString(value)) {
+            return false;
+        }
+        out.push_back(value);
+    } while (consume(','));
+    return consume(']');
+}
+
+bool JsonReader::readList(std::vector<std::string>& out) {
+    if (!consume('[')) {
+        return false;
+    }
+    out.clear();
+    if (consume(']')) {
+        return true;
+    }
+    do {
+        std::string value;
+        if (!readValue(value)) {
+            return false;
+        }
+        out.push_back(value);
+    } while (consume(','));
+    return consume(']');
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Små hjelpefunksjoner som flere av installasjonsmodulene bruker
+
+// Størrelser for loggen, f.eks. "31.0 MiB" og "465.8 GiB"
+std::string mebibytes(uint64_t bytes);
+std::string gibibytes(uint64_t bytes);
+
+// Enkle anførselstegn rundt verdien for sh, også når den inneholder ' eller linjeskift
+std::string shellQuote(const std::string& value);
+
+// Størrelsen til en åpen blokkenhet (BLKGETSIZE64) eller vanlig fil (fstat)
+bool deviceSize(int fd, bool& isBlockDevice, uint64_t& size);
+
+// Tid brukt siden start, til logging og benchmarkene
+double secondsSince(std::chrono::steady_clock::time_point start);
+
+// Kjører en sh-kommando uten stdin og gir hver ikke-tomme linje av stdout til onLine mens den kommer,
+// med stderr også når includeStderr er satt (for hele kommandoen, også i en rørledning).
+// Returnerer true når kommandoen avsluttet med status 0.
+bool captureLines(const std::string& command, const std::function<void(const std::string&)>& onLine, bool includeStderr = false);
+// Samler linjene i stedet
+bool captureLines(const std::string& command, std::vector<std::string>& lines);
+
+// Liten JSON-leser for det Nix skriver ut (derivasjoner, internal-json-loggen, flake archive).
+// Strenger dekodes helt, også \u; tall, true, false og null leses som tekst. Verdier som ikke
+// trengs hoppes over med skipValue.
+struct JsonReader {
+    const std::string& text;
+    size_t pos;
+
+    void skipSpace();
+    bool consume(char c);
+    bool readString(std::string& out);
+    bool readScalar(std::string& out);
+    // En streng eller skalar; objekter og lister hoppes over og gir tom tekst
+    bool readValue(std::string& out);
+    bool skipValue();
+    // Kaller onEntry for hver nøkkel i et objekt; onEntry leser verdien selv
+    bool readObject(const std::function<bool(const std::string&)>& onEntry);
+    bool readStringList(std::vector<std::string>& out);
+    // Som readStringList, men med readValue for hvert element
+    bool readList(std::vector<std::string>& out);
+};
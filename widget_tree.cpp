@@ -0,0 +1,131 @@
+#include "widget_tree.h"
+
+#include <algorithm>
+
+namespace {
+
+// Ruter på 32x32 piksler: et tekstfelt havner i noen få ruter, en diskrad i én rad av ruter
+const int GRID_CELL_SIZE = 32;
+
+// Plasserer barna under hverandre fra (x, y) og returnerer høyden på innholdet
+int layoutChildren(WidgetTree& tree, int container, int x, int y, int width) {
+    int cursor = y;
+    bool first = true;
+    for (int child : tree.children[container]) {
+        if (!tree.visible[child]) {
+            tree.rects[child] = { x, cursor, 0, 0 };
+            continue;
+        }
+        if (!first) {
+            cursor += tree.spacings[container];
+        }
+        first = false;
+        int childWidth = tree.widths[child] > 0 ? std::min(tree.widths[child], width) : width;
+        int childHeight = tree.heights[child];
+        if (tree.kinds[child] == WidgetKind::Container) {
+            childHeight = layoutChildren(tree, child, x, cursor, childWidth);
+        }
+        tree.rects[child] = { x, cursor, childWidth, childHeight };
+        cursor += childHeight;
+    }
+    return cursor - y;
+}
+
+void insertIntoGrid(WidgetTree& tree, int widget, bool parentVisible) {
+    bool shown = parentVisible && tree.visible[widget];
+    if (shown && tree.kinds[widget] != WidgetKind::Container) {
+        const SDL_Rect& root = tree.rects[0];
+        const SDL_Rect& rect = tree.rects[widget];
+        int firstColumn = std::max(0, (rect.x - root.x) / GRID_CELL_SIZE);
+        int lastColumn = std::min(tree.gridColumns - 1, (rect.x + rect.w - 1 - root.x) / GRID_CELL_SIZE);
+        int firstRow = std::max(0, (rect.y - root.y) / GRID_CELL_SIZE);
+        int lastRow = std::min(tree.gridRows - 1, (rect.y + rect.h - 1 - root.y) / GRID_CELL_SIZE);
+        for (int row = firstRow; row <= lastRow; row++) {
+            for (int column = firstColumn; column <= lastColumn; column++) {
+                tree.cells[row * tree.gridColumns + column].push_back(widget);
+            }
+        }
+    }
+    for (int child : tree.children[widget]) {
+        insertIntoGrid(tree, child, shown);
+    }
+}
+
+} // namespace
+
+void initWidgetTree(WidgetTree& tree, int x, int y, int width, int spacing) {
+    tree = WidgetTree();
+    addWidget(tree, -1, WidgetKind::Container, -1, width, 0, spacing);
+    tree.rects[0] = { x, y, width, 0 };
+}
+
+int addWidget(WidgetTree& tree, int parent, WidgetKind kind, int payload, int width, int height, int spacing) {
+    int id = static_cast<int>(tree.kinds.size());
+    tree.kinds.push_back(kind);
+    tree.parents.push_back(parent);
+    tree.payloads.push_back(payload);
+    tree.widths.push_back(width);
+    tree.heights.push_back(height);
+    tree.spacings.push_back(spacing);
+    tree.visible.push_back(true);
+    tree.children.emplace_back();
+    tree.rects.push_back({ 0, 0, 0, 0 });
+    if (parent >= 0) {
+        tree.children[parent].push_back(id);
+    }
+    tree.dirty = true;
+    return id;
+}
+
+void setWidgetVisible(WidgetTree& tree, int widget, bool visible) {
+    if (widget < 0 || tree.visible[widget] == visible) {
+        return;
+    }
+    tree.visible[widget] = visible;
+    tree.dirty = true;
+}
+
+bool layoutWidgetTree(WidgetTree& tree) {
+    if (!tree.dirty || tree.kinds.empty()) {
+        return false;
+    }
+    SDL_Rect& root = tree.rects[0];
+    root.h = layoutChildren(tree, 0, root.x, root.y, root.w);
+
+    tree.gridColumns = std::max(1, (root.w + GRID_CELL_SIZE - 1) / GRID_CELL_SIZE);
+    tree.gridRows = std::max(1, (root.h + GRID_CELL_SIZE - 1) / GRID_CELL_SIZE);
+    tree.cells.assign(static_cast<size_t>(tree.gridColumns) * tree.gridRows, std::vector<int>());
+    insertIntoGrid(tree, 0, true);
+    tree.dirty = false;
+    return true;
+}
+
+int hitTestWidget(WidgetTree& tree, int x, int y) {
+    layoutWidgetTree(tree);
+    if (tree.kinds.empty()) {
+        return -1;
+    }
+    const SDL_Rect& root = tree.rects[0];
+    if (x < root.x || y < root.y || x >= root.x + root.w || y >= root.y + root.h) {
+        return -1;
+    }
+    int column = (x - root.x) / GRID_CELL_SIZE;
+    int row = (y - root.y) / GRID_CELL_SIZE;
+    const std::vector<int>& candidates = tree.cells[row * tree.gridColumns + column];
+    // Sist lagt inn ligger øverst
+    for (auto it = candidates.rbegin(); it != candidates.rend(); ++it) {
+        const SDL_Rect& rect = tree.rects[*it];
+        if (x >= rect.x && x < rect.x + rect.w && y >= rect.y && y < rect.y + rect.h) {
+            return *it;
+        }
+    }
+    return -1;
+}
+
+const SDL_Rect& widgetRect(const WidgetTree& tree, int widget) {
+    static const SDL_Rect EMPTY = { 0, 0, 0, 0 };
+    if (widget < 0 || static_cast<size_t>(widget) >= tree.rects.size()) {
+        return EMPTY;
+    }
+    return tree.rects[widget];
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+
+#include <vector>
+
+// Et lite beholdt widgettre per side: side (roten) → beholder → felt, avkrysningsboks eller rad.
+// Beholdere stabler barna loddrett. Layout kjøres bare når treet er endret (synlighet, nye
+// rader), og rektanglene ligger samlet i én vektor indeksert med widget-id. Treff-testing går
+// via et rutenett over innholdet, så et klikk sjekker bare widgetene i én rute.
+
+enum class WidgetKind {
+    Container,
+    TextField,
+    Dropdown,
+    Checkbox,
+    Row
+};
+
+struct WidgetTree {
+    // Per widget, indeksert med id; 0 er roten
+    std::vector<WidgetKind> kinds;
+    std::vector<int> parents;
+    std::vector<int> payloads; // Indeks i sidens egne data, f.eks. textFields eller disklisten
+    std::vector<int> widths;   // 0 fyller beholderen
+    std::vector<int> heights;  // Ignoreres for beholdere, som blir så høye som innholdet
+    std::vector<int> spacings; // Avstand mellom barna til en beholder
+    std::vector<bool> visible;
+    std::vector<std::vector<int>> children;
+
+    // Resultatet av layout, i innholdskoordinater (før rulling)
+    std::vector<SDL_Rect> rects;
+    std::vector<std::vector<int>> cells;
+    int gridColumns = 0;
+    int gridRows = 0;
+
+    bool dirty = true;
+};
+
+// Tømmer treet og lager roten med øvre venstre hjørne og bredde
+void initWidgetTree(WidgetTree& tree, int x, int y, int width, int spacing);
+
+// Returnerer id-en til den nye widgeten
+int addWidget(WidgetTree& tree, int parent, WidgetKind kind, int payload, int width, int height, int spacing = 0);
+
+void setWidgetVisible(WidgetTree& tree, int widget, bool visible);
+
+// Beregner rektangler og rutenett hvis treet er endret. Returnerer true hvis layout ble kjørt.
+bool layoutWidgetTree(WidgetTree& tree);
+
+// Øverste synlige blad-widget som inneholder punktet (innholdskoordinater), ellers -1.
+// Kjører layout først hvis treet er endret siden sist.
+int hitTestWidget(WidgetTree& tree, int x, int y);
+
+// Et tomt rektangel for en id som ikke finnes (f.eks. fra før treet ble bygget på nytt)
+const SDL_Rect& widgetRect(const WidgetTree& tree, int widget);